@@ -24,7 +24,9 @@ protected:
 				//Xin: training data Yin:labels K:store kernel matrix  
 				 //IO:select the data points you want to train on
 				//B:output  originalPosition
-	LaspMatrix<T> Xin, Yin, K, I0, prevI0, B, originalPositions, smallB, beta, K2,basisIndex,Kji;
+	LaspMatrix<T> Xin, Yin, K, B, originalPositions, smallB, beta, K2,basisIndex,Kji;
+				//active: indices of the points with nonzero hinge loss
+	vector<int> active;
 	int n, d, nOrig, numBasis,numAdditionalTr,itersize;
 	T bias,lambda;
 			double epsilon=0.0001; //stop criterion
@@ -61,12 +63,11 @@ protected:
 				//}
 				//B.printMatrix("exactB");
 				//#pragma omp parallel for
-				prevI0 = LaspMatrix<T>(n,n,0.0);
+				active.resize(n);
 				for (int i = 0; i < n; i++) {
 					originalPositions(i) = i;
-					prevI0(i,i) = 1.0;
+					active[i] = i;
 				}
-				I0.copy(prevI0);
 				return 0;
 			}
 
@@ -83,6 +84,7 @@ protected:
 			T lossPrimal();
 			LaspMatrix<T> gradientPrimal();
 			LaspMatrix<T> hessianPrimal();
+			LaspMatrix<T> activeGradient(LaspMatrix<T> KBt, LaspMatrix<T> KjiBt);
 
 			//gardening section (pruning support vectors with weight zero for efficiency)
 			int pruneData();
@@ -176,8 +178,7 @@ protected:
 				T term2 = 0;
 				T temp,temp2;
 				
-				//prevI0.copy(I0);
-				this->I0 = LaspMatrix<T>(numBasis+numAdditionalTr,numBasis+numAdditionalTr,0.0);
+				this->active.clear();
 				//#pragma omp parallel for
 				for (int i = 0; i < n; ++i){
 					
@@ -189,7 +190,7 @@ protected:
 						std::cin.ignore();
 					}
 					if (temp2 != 0){
-						//this->I0(i,i) = 1.0;
+						this->active.push_back(i);
 						term2 += temp2 * temp2;
 					//         //term2 += (1-temp) * (1-temp);
 					// 	if (prevI0(i,i) == 0) {
@@ -229,8 +230,7 @@ protected:
 				T temp,temp2;
 
 				
-				//prevI0.copy(I0);
-				this->I0 = LaspMatrix<T>(numBasis,numBasis,0.0);
+				this->active.clear();
 				//#pragma omp parallel for
 				for (int i = 0; i < n; ++i){
 			        //temp=B*Kji*y
@@ -243,7 +243,7 @@ protected:
 						std::cin.ignore();
 					}
 					if (temp2 != 0){
-						//this->I0(i,i) = 1.0;
+						this->active.push_back(i);
 						term2 += temp2 * temp2;
 					        //term2 += (1-temp) * (1-temp);
 						// if (prevI0(i,i) == 0) {
@@ -279,22 +279,46 @@ protected:
 	      	  LaspMatrix<T> KjiBt=t(this->Kji)*t(this->smallB);   //n*1
 	      	  LaspMatrix<T> KBt = this->K2*t(this->smallB);
 
-	      	  LaspMatrix<T> gradient = KBt + (2 * C * this->Kji * (KjiBt - t(this->Yin)));
-	      	  return t(gradient);
+	      	  return t(activeGradient(KBt, KjiBt));
 	      	}
 	      	else{
 		      LaspMatrix<T> KBt = this->K2*t(this->B);  //numBasis*1
 		      LaspMatrix<T> KjiBt=t(this->Kji)*t(this->B); //n*1
-		      //we don't need I0 here?
-		      LaspMatrix<T> gradient = KBt + (2 * C * this->Kji * (KjiBt - t(this->Yin))); //numBasis*1
-		      return t(gradient);
+		      return t(activeGradient(KBt, KjiBt)); //numBasis*1
 		  }
 		}
 
+	template <class T>
+		LaspMatrix<T> SVM_approx<T>::activeGradient(LaspMatrix<T> KBt, LaspMatrix<T> KjiBt){
+			T C = this->options().C;
+			int m = this->active.size();
+			if (m == 0) {
+				return KBt;
+			}
+
+			//Only the points with nonzero loss contribute
+			LaspMatrix<T> Ka;
+			this->Kji.gather(Ka, this->active);
+
+			LaspMatrix<T> residual(1, m);
+			for (int i = 0; i < m; ++i) {
+				residual(0,i) = KjiBt(0,this->active[i]) - this->Yin(this->active[i],0);
+			}
+
+			return KBt + (2 * C * Ka * residual);
+		}
+
 	template <class T>
 		LaspMatrix<T> SVM_approx<T>::hessianPrimal(){
 			T C = this->options().C;
-			LaspMatrix<T> hessian = this->K2 + (2*C*this->K2*this->I0*this->K2);
+			if (this->active.empty()) {
+				return copy(this->K2);
+			}
+
+			//Kji restricted to the active points stands in for K*I0*K
+			LaspMatrix<T> Ka;
+			this->Kji.gather(Ka, this->active);
+			LaspMatrix<T> hessian = this->K2 + (2*C*Ka*t(Ka));
             //this->B.printMatrix("exactB");
 			return hessian;
 		}
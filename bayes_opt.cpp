@@ -32,6 +32,7 @@
 #include "svm.h"
 #include "pegasos.h"
 #include "fileIO.h"
+#include "multiclass.h"
 #include <limits>
 #include <algorithm>
 #include <set>
@@ -56,59 +57,36 @@ namespace lasp {
 			
 			time_t baseTime = time(0);
 			
-			//Multiclass loop
-			for(int i = 0; i < trainingData.orderSeen.size(); ++i) {
-				for(int j = i+1; j < trainingData.orderSeen.size(); ++j) {
-					int firstClass = trainingData.orderSeen[i];
-					int secondClass = trainingData.orderSeen[j];
-					
-					if(options.verb > 2) {
-						cout << "Training " << firstClass << " v. " << secondClass << " classifier" << endl;
-					}
-					
-					svm_problem curProblem = lasp::get_onevsone_subproblem(trainingData,
-																		   firstClass,
-																		   secondClass,
-																		   options);
-					
-					//Set the options for solving according to our chosen candidate
-					curProblem.options.C = static_cast<double>(params(0));
-					
-					switch (options.kernel) {
-						case RBF:
-							curProblem.options.gamma = static_cast<double>(params(1));
-							break;
-						case SIGMOID:
-							curProblem.options.gamma = static_cast<double>(params(1));
-							curProblem.options.coef = static_cast<double>(params(2));
-							break;
-						case POLYNOMIAL:
-							curProblem.options.gamma = static_cast<double>(params(1));
-							curProblem.options.coef = static_cast<double>(params(2));
-							curProblem.options.degree = static_cast<double>(params(3));
-							break;
-						default:
-							break;
-					}
-					
-					if (options.pegasos && options.kernel == LINEAR && options.costSensitive){
-						curProblem.options.set_size = static_cast<int>(params(1));
-						curProblem.options.maxiter = static_cast<int>(params(2));
-					}
-					
-					//Actually train the svm with the current hyperparameters
-					
-					
-					if (options.pegasos) {
-						pegasos_svm_host<T>(curProblem);
-					} else {
-						lasp_svm_host<T>(curProblem);
-					}
-										
-					solvedProblems.push_back(curProblem);
-				}
+			//Set the options for solving according to our chosen candidate
+			opt curOptions = options;
+			curOptions.C = static_cast<double>(params(0));
+			
+			switch (options.kernel) {
+				case RBF:
+					curOptions.gamma = static_cast<double>(params(1));
+					break;
+				case SIGMOID:
+					curOptions.gamma = static_cast<double>(params(1));
+					curOptions.coef = static_cast<double>(params(2));
+					break;
+				case POLYNOMIAL:
+					curOptions.gamma = static_cast<double>(params(1));
+					curOptions.coef = static_cast<double>(params(2));
+					curOptions.degree = static_cast<double>(params(3));
+					break;
+				default:
+					break;
 			}
 			
+			if (options.pegasos && options.kernel == LINEAR && options.costSensitive){
+				curOptions.set_size = static_cast<int>(params(1));
+				curOptions.maxiter = static_cast<int>(params(2));
+			}
+			
+			//Actually train the svms with the current hyperparameters,
+			//pairs are trained concurrently
+			train_onevsone<T>(trainingData, curOptions, solvedProblems);
+			
 			T newTime = (T)difftime(time(0), baseTime);
 			
 			//Get the model and classify the holdout data to get the accuracy
@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "wusvm.h"
+#include "svm.h"
+#include "fileIO.h"
+#include <algorithm>
+#include <chrono>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//Latency of the online prediction API. Classifies every point of a test
+//file one at a time (dense and sparse), then all of them in one batch,
+//and reports percentiles of the per call time. Then classifies the file
+//from 1, 2, 4... threads at once, each with its own context and data view
+//on the shared model, and reports how throughput scales.
+
+static double seconds_since(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* name, std::vector<double>& times, std::vector<int> const& labels, std::vector<int> const& truth){
+	std::sort(times.begin(), times.end());
+	double total = 0;
+	for (size_t i = 0; i < times.size(); ++i) {
+		total += times[i];
+	}
+	
+	int correct = 0;
+	for (size_t i = 0; i < labels.size(); ++i) {
+		correct += labels[i] == truth[i];
+	}
+	
+	size_t n = times.size();
+	std::cout << name << ": p50 " << times[n / 2] * 1e6 << "us, p99 " << times[std::min(n - 1, (n * 99) / 100)] * 1e6;
+	std::cout << "us, max " << times[n - 1] * 1e6 << "us, mean " << total / n * 1e6 << "us";
+	std::cout << ", accuracy " << (100.0 * correct) / labels.size() << "%" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		std::cout << "Usage: benchmark_predict model_file test_file [threads] [repeats] [callers]" << std::endl;
+		return 1;
+	}
+	
+	int threads = argc > 3 ? atoi(argv[3]) : 1;
+	int repeats = argc > 4 ? std::max(1, atoi(argv[4])) : 3;
+	int callers = 1;
+#ifdef _OPENMP
+	callers = argc > 5 ? std::max(1, atoi(argv[5])) : omp_get_max_threads();
+#endif
+	
+	wusvm_model model;
+	if (load_model(&model, argv[1]) != NO_ERROR) {
+		std::cerr << "Could not load " << argv[1] << std::endl;
+		return 1;
+	}
+	
+	lasp::svm_sparse_data data;
+	if (lasp::load_sparse_data(argv[2], data) != lasp::CORRECT) {
+		return 1;
+	}
+	
+	//The test points, sparse with zero based indices and dense
+	int features = data.numFeatures;
+	std::vector<size_t> ptr(1, 0);
+	std::vector<int> indices, truth;
+	std::vector<double> values;
+	
+	typedef std::map<int, std::vector<std::vector<lasp::svm_node> > >::iterator SparseIterator;
+	for (SparseIterator iter = data.allData.begin(); iter != data.allData.end(); ++iter) {
+		for (size_t i = 0; i < iter->second.size(); ++i) {
+			std::vector<lasp::svm_node>& point = iter->second[i];
+			for (size_t j = 0; j < point.size(); ++j) {
+				if (point[j].index > 0) {
+					indices.push_back(point[j].index - 1);
+					values.push_back(point[j].value);
+				}
+			}
+			ptr.push_back(indices.size());
+			truth.push_back(iter->first);
+		}
+	}
+	
+	int points = truth.size();
+	if (points == 0) {
+		std::cerr << argv[2] << " has no points" << std::endl;
+		return 1;
+	}
+	
+	std::vector<double> dense((size_t)points * features, 0.0);
+	for (int i = 0; i < points; ++i) {
+		for (size_t e = ptr[i]; e < ptr[i + 1]; ++e) {
+			dense[(size_t)i * features + indices[e]] = values[e];
+		}
+	}
+	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	wusvm_predictor predictor;
+	if (create_predictor(&predictor, model, threads) != NO_ERROR) {
+		std::cerr << "Could not create a predictor" << std::endl;
+		return 1;
+	}
+	std::cout << "Predictor ready in " << seconds_since(start) * 1e3 << "ms, " << points << " points" << std::endl;
+	
+	std::vector<int> labels(points), sparseLabels(points), batchLabels(points);
+	std::vector<double> times, sparseTimes;
+	
+	//First pass warms up caches and BLAS
+	for (int r = 0; r <= repeats; ++r) {
+		for (int i = 0; i < points; ++i) {
+			start = std::chrono::steady_clock::now();
+			predict_one(predictor, &dense[(size_t)i * features], features, &labels[i]);
+			double elapsed = seconds_since(start);
+			
+			start = std::chrono::steady_clock::now();
+			predict_one_sparse(predictor, &indices[0] + ptr[i], &values[0] + ptr[i], ptr[i + 1] - ptr[i], &sparseLabels[i]);
+			double sparseElapsed = seconds_since(start);
+			
+			if (r > 0) {
+				times.push_back(elapsed);
+				sparseTimes.push_back(sparseElapsed);
+			}
+		}
+	}
+	
+	report("predict_one", times, labels, truth);
+	report("predict_one_sparse", sparseTimes, sparseLabels, truth);
+	
+	start = std::chrono::steady_clock::now();
+	predict_batch(predictor, &dense[0], features, points, &batchLabels[0]);
+	double batchTime = seconds_since(start);
+	
+	int agree = 0;
+	for (int i = 0; i < points; ++i) {
+		agree += batchLabels[i] == labels[i] && sparseLabels[i] == labels[i];
+	}
+	
+	std::cout << "predict_batch: " << batchTime * 1e3 << "ms, " << points / batchTime << " points/s" << std::endl;
+	std::cout << agree << " of " << points << " labels agree across the three calls" << std::endl;
+	
+	wusvm_options options;
+	create_options(&options);
+	
+	double singleRate = 0;
+	for (int n = 1; n <= callers; n *= 2) {
+		int disagree = 0;
+		double elapsed = 0;
+		
+#pragma omp parallel num_threads(n) reduction(+:disagree)
+		{
+			wusvm_context context;
+			wusvm_data view;
+			create_context(&context, 1, 0);
+			create_data_view(&view, &dense[0], 0, features, points);
+			
+			//Warm up the context's scratch memory before timing
+			classify_data_in_context(context, view, model, options);
+			
+#pragma omp barrier
+#pragma omp single
+			start = std::chrono::steady_clock::now();
+			
+			for (int r = 0; r < repeats; ++r) {
+				classify_data_in_context(context, view, model, options);
+			}
+			
+#pragma omp barrier
+#pragma omp single
+			elapsed = seconds_since(start);
+			
+			std::vector<int> viewLabels(points);
+			get_labels_from_data(view, &viewLabels[0]);
+			for (int i = 0; i < points; ++i) {
+				disagree += viewLabels[i] != batchLabels[i];
+			}
+			
+			free_data(view);
+			free_context(context);
+		}
+		
+		double rate = (double)n * repeats * points / elapsed;
+		if (n == 1) {
+			singleRate = rate;
+		}
+		
+		std::cout << "classify_data_in_context, " << n << " callers: " << rate << " points/s, efficiency ";
+		std::cout << 100.0 * rate / (n * singleRate) << "%, " << disagree << " labels differ from predict_batch" << std::endl;
+	}
+	
+	free_options(options);
+	free_predictor(predictor);
+	free_model(model);
+	return 0;
+}
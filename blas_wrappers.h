@@ -56,6 +56,27 @@ namespace lasp{
 	int host_sgemm(bool transa, bool transb, int m, int n, int k, float alpha, float* a, int lda, float * b, int ldb, float beta, float* c, int ldc);
 	int device_sgemm(DeviceParams params, bool transa, bool transb, int m, int n, int k, float alpha, float* a, int lda, float * b, int ldb, float beta, float* c, int ldc);
 
+	//Symmetric rank k update, only the upper or lower triangle of c is written
+	int host_dsyrk(bool upper, bool trans, int n, int k, double alpha, double* a, int lda, double beta, double* c, int ldc);
+	int host_ssyrk(bool upper, bool trans, int n, int k, float alpha, float* a, int lda, float beta, float* c, int ldc);
+	
+	//Overloads for templated callers
+	inline int host_gemm(bool transa, bool transb, int m, int n, int k, double alpha, double* a, int lda, double * b, int ldb, double beta, double* c, int ldc){
+		return host_dgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+	}
+	
+	inline int host_gemm(bool transa, bool transb, int m, int n, int k, float alpha, float* a, int lda, float * b, int ldb, float beta, float* c, int ldc){
+		return host_sgemm(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+	}
+	
+	inline int host_syrk(bool upper, bool trans, int n, int k, double alpha, double* a, int lda, double beta, double* c, int ldc){
+		return host_dsyrk(upper, trans, n, k, alpha, a, lda, beta, c, ldc);
+	}
+	
+	inline int host_syrk(bool upper, bool trans, int n, int k, float alpha, float* a, int lda, float beta, float* c, int ldc){
+		return host_ssyrk(upper, trans, n, k, alpha, a, lda, beta, c, ldc);
+	}
+
 	int host_dger(int m, int n, double alpha, double* x, int incx, double* y, int incy, double* a, int lda);
 	int device_dger(DeviceParams params, int m, int n, double alpha, double* x, int incx, double* y, int incy, double* a, int lda);
 
@@ -74,6 +95,10 @@ namespace lasp{
 	
 	int host_dpotrs(bool upper, int n, int nrhs, double* a, int lda, double* b, int ldb);
 	int host_spotrs(bool upper, int n, int nrhs, float* a, int lda, float* b, int ldb);
+	
+	//Triangular solve, B = alpha * op(A)^-1 B (left) or B op(A)^-1 (right)
+	int host_dtrsm(bool right, bool upper, bool transa, int m, int n, double alpha, double* a, int lda, double* b, int ldb);
+	int host_strsm(bool right, bool upper, bool transa, int m, int n, float alpha, float* a, int lda, float* b, int ldb);
 
 	int device_colSqSum(DeviceParams params, float* A, size_t n, size_t features, float* result, float scalar, size_t mRows, size_t out_mRows);
 	int device_colSqSum(DeviceParams params, double* A, size_t n, size_t features, double* result, double scalar, size_t mRows, size_t out_mRows);
@@ -63,7 +63,9 @@ int main(int argc, char** argv)
 		{"no_cache", no_argument, 0, 'K'},
 		{"dag", no_argument, 0, 'D'},
 		{"help", no_argument, 0, 'h'},
-		{"maxgpus", required_argument, 0, 'y'}
+		{"maxgpus", required_argument, 0, 'y'},
+		{"mem-budget", required_argument, 0, 'M'},
+		{0, 0, 0, 0}
 	};
 	
 	//Variables we need for parsing arguments
@@ -72,7 +74,7 @@ int main(int argc, char** argv)
 	int c;
 	char* end;
 	
-	while((c = getopt_long(optCount, optArgs, "Dy:v:s:huqlKT:", long_options, 0)) != -1)
+	while((c = getopt_long(optCount, optArgs, "Dy:v:s:huqlKT:M:", long_options, 0)) != -1)
 		switch(c)
 	{
 		case 'v':
@@ -87,6 +89,12 @@ int main(int argc, char** argv)
 				lasp::exit_classify();
 			options.set_size = intVal;
 			break;
+		case 'M':
+			intVal = strtol(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || intVal < 0)
+				lasp::exit_classify();
+			options.memBudget = (size_t)intVal << 20;
+			break;
 		case 'T':
 			intVal = strtol(optarg, &end, 10);
 			if(end == optarg || *end != '\0' || intVal <= 0)
@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fileIO_binary.h"
+#include <cstring>
+
+//Converts LIBSVM formatted text files into binary datasets that can be
+//memory mapped by the training and classification tools
+int main(int argc, char** argv)
+{
+	bool sparse = true;
+	int argi = 1;
+	
+	if (argi < argc && strcmp(argv[argi], "-d") == 0) {
+		sparse = false;
+		++argi;
+	}
+	
+	if (argc - argi != 2) {
+		cout << "Usage: convert_data [-d] input_file output_file" << endl;
+		cout << "  -d : store features densely (default is sparse)" << endl;
+		return 1;
+	}
+	
+	int error = lasp::convert_LIBSVM_to_binary(argv[argi], argv[argi + 1], sparse);
+	if (error != lasp::CORRECT) {
+		return error;
+	}
+	
+	lasp::binary_data data;
+	error = lasp::load_binary_data(argv[argi + 1], data);
+	if (error != lasp::CORRECT) {
+		return error;
+	}
+	
+	cout << "Wrote " << data.n << " points with " << data.d << " features";
+	if (data.sparse) {
+		cout << " (" << data.csr.nnz << " non-zeros)";
+	}
+	cout << " to " << argv[argi + 1] << endl;
+	
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fileIO.h"
+#include "fileIO_binary.h"
+#include <cstring>
+
+//Converts models between the text (LIBSVM style) and binary formats.
+//Either format is read, the input format is detected from the file.
+int main(int argc, char** argv)
+{
+	bool text = false;
+	int argi = 1;
+	
+	if (argi < argc && strcmp(argv[argi], "-t") == 0) {
+		text = true;
+		++argi;
+	}
+	
+	if (argc - argi != 2) {
+		cout << "Usage: convert_model [-t] input_model output_model" << endl;
+		cout << "  -t : write a text model (default is binary)" << endl;
+		return 1;
+	}
+	
+	lasp::svm_model model;
+	int error = lasp::load_model(argv[argi], model);
+	if (error != lasp::CORRECT) {
+		return error;
+	}
+	
+	error = text ? lasp::write_model(model, argv[argi + 1]) : lasp::write_binary_model(model, argv[argi + 1]);
+	if (error != lasp::CORRECT) {
+		cerr << "Could not write " << argv[argi + 1] << endl;
+		return error;
+	}
+	
+	cout << "Wrote " << model.numSupportVectors() << " support vectors of " << model.orderSeen.size() << " classes";
+	cout << " to " << argv[argi + 1] << endl;
+	
+	return 0;
+}
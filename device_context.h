@@ -161,15 +161,28 @@ namespace lasp {
 			return unified;
 		}
 		
+		//The first calls may come from several threads at once
 		static DeviceContext* instance() {
 			if(instance_ == 0){
-				instance_ = new DeviceContext();
+#pragma omp critical(lasp_device_context)
+				{
+					if(instance_ == 0){
+						//Publish the pointer only once the context is built
+						DeviceContext* context = new DeviceContext();
+#pragma omp flush
+						instance_ = context;
+					}
+				}
 			}
 			return instance_;
 		}
 		
+		//Matrices may be created from several threads at once
 		void* getNextKey(){
-			return static_cast<void*>(nextKey++);
+			char* key;
+#pragma omp critical(lasp_next_key)
+			key = nextKey++;
+			return static_cast<void*>(key);
 		}
 		
 		template<class T>
@@ -24,7 +24,9 @@ namespace lasp {
 				//Xin: training data Yin:labels K:store kernel matrix  
 				 //IO:select the data points you want to train on
 				//B:output  originalPosition
-			LaspMatrix<T> Xin, Yin, K, I0, prevI0, B, originalPositions;
+			LaspMatrix<T> Xin, Yin, K, B, originalPositions;
+				//active: indices of the points with nonzero hinge loss
+			vector<int> active;
 			int n, d, nOrig;
 			T bias,lambda;
 
@@ -53,12 +55,11 @@ namespace lasp {
 				//}
 				//B.printMatrix("exactB");
 				//#pragma omp parallel for
-				prevI0 = LaspMatrix<T>(n,n,0.0);
+				active.resize(n);
 				for (int i = 0; i < n; i++) {
 					originalPositions(i) = i;
-					prevI0(i,i) = 1.0;
+					active[i] = i;
 				}
-				I0.copy(prevI0);
 				return 0;
 			}
 
@@ -160,7 +161,7 @@ namespace lasp {
 			//cout << "the apples have been couted my liege" << endl;
 
 
-			int newN = ((LaspMatrix<T>)sum(I0))(0,0);
+			int newN = active.size();
 			cout << newN << endl;
 			if (newN == n) {
 			  return 0;
@@ -176,13 +177,7 @@ namespace lasp {
             
             
             
-			vector<int> nonZeroBetas;
-			for (int i = 0; i < n; i++) {
-			  if (I0(i,i) == 1) {
-			    nonZeroBetas.push_back(i);
-			  }
-			}
-			this->I0 = LaspMatrix<T>(newN,newN,0.0);
+			vector<int> nonZeroBetas(active);
 			//OMP BEATCH
 			//#pragma omp parallel for
 			for (int col = 0; col < newN; ++col){
@@ -190,7 +185,7 @@ namespace lasp {
 			  newOrigPosits(col,0) = this->originalPositions(nonZeroBetas[col],0);
 			  newY(col,0) = this->Yin(nonZeroBetas[col],0);
 			  newB(col,0) = this->B(nonZeroBetas[col],0);
-			  this->I0(col,col) = 1;
+			  this->active[col] = col;
 			  //for (int row = 0; row < d; ++row){
 			  //  newX(col,row) = this->Xin(nonZeroBetas[col],row);//ask gabe it we can straight copy a row in one fell swoop
 			  //}
@@ -214,7 +209,6 @@ namespace lasp {
 			this->Yin = newY;
 			this->K = newK;
 			this->n = newN;
-			prevI0.copy(I0);
 	    
 			return 0; //replace with SUCCESS enum
 		} 
@@ -235,8 +229,7 @@ namespace lasp {
 			T term2 = 0;
 			T temp,temp2;
 			
-			//prevI0.copy(I0);
-			this->I0 = LaspMatrix<T>(n,n,0.0);
+			this->active.clear();
 			//#pragma omp parallel for
 			for (int i = 0; i < n; ++i){
 				temp = KBt(0,i)*this->Yin(i,0);
@@ -246,15 +239,9 @@ namespace lasp {
 					std::cin.ignore();
 				}
 				if (temp2 != 0){
-					this->I0(i,i) = 1.0;
+					this->active.push_back(i);
 					term2 += temp2 * temp2;
 				        //term2 += (1-temp) * (1-temp);
-                    			if (prevI0(i,i) == 0) {
-						//std::cin.ignore();
-                   			 }
-				}
-                		if (this->prevI0(i,i) != this->I0(i,i)) {
-					//cout << "HOLY SHIT" << endl;
 				}
 			}
 			if (term1 < 0) {
@@ -273,14 +260,35 @@ namespace lasp {
 	LaspMatrix<T> SVM_exact<T>::gradientPrimal(){
 	      T C = this->options().C;
 	      LaspMatrix<T> KBt = this->K*t(this->B);
-	      LaspMatrix<T> gradient = KBt + (2 * C * this->K * this->I0 * (KBt - t(this->Yin)));
+	      int m = this->active.size();
+	      if (m == 0) {
+	        return t(KBt);
+	      }
+
+	      //Only the active points contribute, so work on their kernel columns
+	      LaspMatrix<T> Ka;
+	      this->K.gather(Ka, this->active);
+
+	      LaspMatrix<T> residual(1, m);
+	      for (int i = 0; i < m; ++i) {
+	        residual(0,i) = KBt(0,this->active[i]) - this->Yin(this->active[i],0);
+	      }
+
+	      LaspMatrix<T> gradient = KBt + (2 * C * Ka * residual);
 	      return t(gradient);
 	}
 
 	template <class T>
 		LaspMatrix<T> SVM_exact<T>::hessianPrimal(){
 	        T C = this->options().C;
-			LaspMatrix<T> hessian = this->K + (2*C*this->K*this->I0*this->K);
+			if (this->active.empty()) {
+				return copy(this->K);
+			}
+
+			//K*I0*K with I0 the active indicator is Ka*Ka' for the gathered columns
+			LaspMatrix<T> Ka;
+			this->K.gather(Ka, this->active);
+			LaspMatrix<T> hessian = this->K + (2*C*Ka*t(Ka));
             //this->B.printMatrix("exactB");
 			return hessian;
 		}
@@ -460,20 +468,9 @@ namespace lasp {
 			
 			//"fly you FOOLS!!" - Gabriel Hope, 2014
 			cout << "COMPUTING KERNEL" << endl;
-			this->K = LaspMatrix<T>(n,n,0.0);
-			// @chip, why don't we just use a matrix multiply?
-			#pragma omp parallel for
-			for (int i = 0; i < this->n; i++) {
-				for (int j = i; j < this->n; j++) {
-					T sum = 0;
-					for (int k = 0; k < this->d; k++) {
-						sum += x(i,k) * x(j,k);
-					}
-					this->K(i,j) = sum;
-					this->K(j,i) = sum;
-				}
-			}
-			//this->K = t(x) * x;
+			LaspMatrix<T> xNorm;
+			this->K = LaspMatrix<T>();
+			this->K.getSymKernel(kernelOptions, x, xNorm, gpu);
 			cout << "KERNEL COMPUTED" << endl;
             //K.printMatrix("K");
 
@@ -583,18 +580,20 @@ namespace lasp {
 			cout << "diff: " << diff << endl;
 			
 			int d = this->d;
-			LaspMatrix<T> w = LaspMatrix<T>(1,d,0.0);
-			//cout << this->Xin.rows() << endl;
-			//cout << this->Xin.cols() << endl;
-			//cout << this->B.rows() << endl;
-			//cout << this->B.cols() << endl;
-			//LaspmMatrix<T> temp2 = LaspMatrix<T>(this->B.size,d,0.0);
-			//#pragma omp parallel for
-			for (int i = 0; i < this->B.size(); i++) {
-			  //cout << i << endl;
-			  w = w + this->B(i,0) * csel(this->Xin,i); //wrong indices when pruning
+			if (kernelOptions.kernel == LINEAR) {
+				LaspMatrix<T> w = LaspMatrix<T>(1,d,0.0);
+				//cout << this->Xin.rows() << endl;
+				//cout << this->Xin.cols() << endl;
+				//cout << this->B.rows() << endl;
+				//cout << this->B.cols() << endl;
+				//LaspmMatrix<T> temp2 = LaspMatrix<T>(this->B.size,d,0.0);
+				//#pragma omp parallel for
+				for (int i = 0; i < this->B.size(); i++) {
+				  //cout << i << endl;
+				  w = w + this->B(i,0) * csel(this->Xin,i); //wrong indices when pruning
+				}
+				w.printMatrix("w");
 			}
-			w.printMatrix("w");
 
 			//grad.printMatrix("grad");
 			//gradientPrimal().printMatrix("grad");
@@ -615,14 +614,21 @@ namespace lasp {
 
 	template <class T>
 		int SVM_exact<T>::predict(LaspMatrix<T> X, LaspMatrix<int>& output){
-            output = LaspMatrix<int>(Xin.cols(),1,0);
-           // #pragma omp parallel for
+            output = LaspMatrix<int>(X.cols(),1,0);
+
+            //Training points that survived pruning, against every test point
+            vector<int> positions(B.size());
+            for (int j = 0; j < B.size(); j++) {
+                positions[j] = static_cast<int>(originalPositions(j));
+            }
+
+            LaspMatrix<T> xS, xSNorm, XNorm, Kx, scores;
+            Xin.gather(xS, positions);
+            Kx.getKernel(options().kernel_options(), xS, xSNorm, X, XNorm, false, false, false);
+            B.multiply(Kx, scores);
+
             for (int i = 0; i < X.cols(); i++) {
-                T score = 0;
-                for (int j = 0; j < B.size(); j++) {
-                    LaspMatrix<T> temp = ( t(csel(Xin,j)) * csel(X,i) );
-                    score += B(j) * temp(0,0);
-                }
+                T score = scores(i,0);
                 output(i,0) = ((0 < score) - (score < 0));
             }
             return 0;
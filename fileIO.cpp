@@ -27,6 +27,7 @@
 
 #include "fileIO.h"
 #include "svm.h"
+#include "fileIO_binary.h"
 #include <limits>
 
 int lasp_atoi(const char* input){
@@ -64,94 +65,55 @@ double lasp_atof(const char* input){
 int lasp::load_sparse_data(const char* filename,
 						   lasp::svm_sparse_data& myData)
 {
-    int pointCount = 0;
-	ifstream fin;
-	fin.open(filename);
-	if(fin) {
-		bool zeroIndexed = false;
-		int maxIndex = -1;
-		char curLine[LINE_SIZE];// (Yu)LINE_SIZE is defined in svm.h and the value is 100000
+	//Binary datasets are mapped rather than parsed
+	if (is_binary_data(filename)) {
+		binary_data binData;
+		int error = load_binary_data(filename, binData);
+		if (error != CORRECT) {
+			return error;
+		}
 		
-		while(fin.getline(curLine, LINE_SIZE)) {
-			vector<svm_node> currentNodes;
-			char* tokens = strtok(curLine, " ");
-            
-            // (Yu) this piece of code is used to store the label of each data into orderSeen
-            // (Yu) if the data includes labels, seen becomes to true.
-			int classification = lasp_atoi(tokens);
-			bool seen = false;
-			for(int i = 0; i < myData.orderSeen.size(); ++i) {
-                
-                //(Yu) by default, orderSeen is a vector with all 0s
-				if(classification == myData.orderSeen[i]) {
-					seen = true;
-					break;
-                    
-				}
-			}
-			
-			myData.pointOrder.push_back(classification);
-			if (!seen) myData.orderSeen.push_back(classification);
-			tokens = strtok(NULL, " "); //move forward one token
-			while(tokens) {
-				//parsing stuff, kind of messy, but gets job done.
-				string oneToken;
-				oneToken.assign(tokens);
-				size_t found = oneToken.find(":");
-				string index = oneToken.substr(0,found);
-				if (lasp_atoi(index.c_str()) == 0){
-					zeroIndexed = true;
-				}
-				string value = oneToken.substr(found+1, oneToken.length());
-				
-				svm_node newNode;
-				newNode.index = lasp_atoi(index.c_str());
-				newNode.value = lasp_atof(value.c_str());
-				if(newNode.index > maxIndex) maxIndex = newNode.index;
-				currentNodes.push_back(newNode);
-				tokens = strtok(NULL, " ");
-			}
-			myData.allData[classification].push_back(currentNodes);
-			pointCount ++;
+		if (binData.sparse) {
+			return csr_to_sparse_data(binData.csr, myData);
 		}
-		myData.numPoints = pointCount;
 		
-		//I hate this piece of code, but I don't want to try to figure out a better way to deal with zero-indexed files (Gabe)
-		if(zeroIndexed){
-			maxIndex++;
-			for(map<int, vector<vector<svm_node> > >::iterator iter = myData.allData.begin(); iter != myData.allData.end(); ++iter){
-				for(vector<vector<svm_node> >::iterator iter2 = iter->second.begin(); iter2 != iter->second.end(); ++iter2){
-					for(vector<svm_node>::iterator iter3 = iter2->begin(); iter3 != iter2->end(); ++iter3){
-						iter3->index++;
-					}
-				}
+		//Dense files are walked as csr with every feature present
+		vector<int64_t> indptr(binData.n + 1);
+		vector<int32_t> indices((size_t)binData.n * binData.d);
+		for (int i = 0; i < binData.n; ++i) {
+			indptr[i] = (int64_t)i * binData.d;
+			for (int j = 0; j < binData.d; ++j) {
+				indices[(size_t)i * binData.d + j] = j;
 			}
 		}
+		indptr[binData.n] = (int64_t)binData.n * binData.d;
 		
-        
-		myData.numFeatures = maxIndex;
-		myData.multiClass = myData.allData.size() > 2;
-		fin.close();
-        
-        //(Yu)
-        // get the full data which is gonna be used to compute the means and standard deviations
-        lasp::svm_full_data fullData;
-        sparse_data_to_full(fullData, myData);
-        
-        //(Yu)
-        // get the means and standard deviation vectors
-        getMeans(fullData, myData);
-        getStandDeviations(fullData, myData);
-        
-		return 0;
+		csr_data csr = binData.csr;
+		csr.nnz = indices.size();
+		csr.indptr = indptr.data();
+		csr.indices = indices.data();
+		csr.values = binData.X.data();
+		return csr_to_sparse_data(csr, myData);
 	}
-	else {
+	
+	//Text files are parsed in parallel straight into csr arrays, the
+	//feature statistics come out of the same pass
+	csr_data csr;
+	feature_stats stats;
+	int error = load_LIBSVM_csr(filename, csr, &stats);
+	
+	if (error == UNOPENED_FILE_ERROR) {
 		cout << " The file \' "<< filename << "\' was not found." << endl;
 		cout << "You must specify an existing file to read your" << endl;
 		cout << "training data from." << endl;
 		return UNOPENED_FILE_ERROR;
 	}
-    
+	
+	if (error != CORRECT) {
+		return error;
+	}
+	
+	return csr_to_sparse_data(csr, myData, &stats);
 }
 
 void lasp::getMeans(svm_full_data& orginalFullData, svm_sparse_data& originalSparseData){
@@ -184,6 +146,14 @@ void lasp::getStandDeviations(svm_full_data& orginalFullData, svm_sparse_data& o
 int lasp::load_model(const char* filename,
 					 svm_model& myModel)
 {
+	if (is_binary_model(filename)) {
+		int error = load_binary_model(filename, myModel);
+		if (error == CORRECT) {
+			set_linear_weights(myModel);
+		}
+		return error;
+	}
+	
 	//We need to first parse the header file, which is kind
 	//of a pain, but I'll maintain a boolean doneWithHeader
 	//that is true if we are done parsing the header.
@@ -205,12 +175,17 @@ int lasp::load_model(const char* filename,
         bool doneWithMeans = false;
         
 		char curLine[LINE_SIZE];
-		//the current support vector we're parsing, indexed from 1.
-		int curNumSupportVector = 1;
 		//the number of classes specified in the header file.
 		int numClasses = -1;
-		//map from {class -> num support vectors in that class
-		map<int, int> supportVectorCounts;
+		//number of support vectors in each class, in orderSeen order
+		vector<int> supportVectorCounts;
+		
+		//The support vectors as compressed columns (0-based features)
+		//and their numClasses-1 betas each, handed to set_support_vectors
+		vector<size_t> svPtr(1, 0);
+		vector<int> svInd;
+		vector<float> svVal;
+		vector<double> svCoefs;
 		
 		//the vector of offsets specified by "rho"
 		//we need a temporary vector because we don't know the class
@@ -228,6 +203,12 @@ int lasp::load_model(const char* filename,
 		//While looping through, I will also track the maximum
 		//svm_node index to see how many features we have.
 		while(fin.getline(curLine, LINE_SIZE)) {
+			//Blank lines carry nothing, write_model leaves one after "Means"
+			//when the training data was not scaled
+			if(strspn(curLine, " \t\r") == strlen(curLine)) {
+				continue;
+			}
+			
 			//HERE is where we parse the header
 			if(!doneWithHeader) {
 				char* tokens = strtok(curLine, " ");
@@ -307,7 +288,7 @@ int lasp::load_model(const char* filename,
 					numSV = true;
 					for(int i = 0; i < numClasses; ++i) {
 						tokens = strtok(NULL, " ");
-						supportVectorCounts[myModel.orderSeen[i]] = lasp_atoi(tokens);
+						supportVectorCounts.push_back(lasp_atoi(tokens));
 					}
 				}
 				else if(strcmp(tokens, "#SGD") == 0) {
@@ -333,7 +314,6 @@ int lasp::load_model(const char* filename,
 					return INVALID_INPUT;
 				}
 				
-				vector<svm_node> currentNodes;
 				char* tokens = strtok(curLine, " ");
                 
                 //(Yu)
@@ -342,49 +322,27 @@ int lasp::load_model(const char* filename,
                 }
                 //(Yu) parsing tge support vectors
                 else{
-                    int curClass;
-                    //variable used to determine what class the current support vector is in.
-                    int runningSVSum = 0;
-                    for(int i = 0; i < numClasses; ++i) {
-                        runningSVSum += supportVectorCounts[myModel.orderSeen[i]];
-                        if(runningSVSum >= curNumSupportVector) {
-                            curClass = myModel.orderSeen[i];
-                            break;
-                        }
-                    }
-                    //now that we know what class we're in, we'll load the betas in
-                    //using a temporary storage vector (we'll input them to the map once
-                    //we've actually loaded the SV).
-                    vector<double> tempBetaVec;
+                    //the betas come first, one against each other class
                     for(int i = 0; i < numClasses-1; ++i) {
-                        tempBetaVec.push_back(lasp_atof(tokens));
+                        svCoefs.push_back(lasp_atof(tokens));
                         tokens = strtok(NULL, " ");
                     }
                     
+                    //then index:value pairs, straight into the columns
                     while(tokens) {
-                        //parsing stuff, kind of messy, but gets job done.
-                        string oneToken;
-                        oneToken.assign(tokens);
-                        size_t found = oneToken.find(":");
-                        string index = oneToken.substr(0,found);
-                        string value = oneToken.substr(found+1, oneToken.length());
-                        
-                        svm_node newNode;
-                        newNode.index = lasp_atoi(index.c_str());
-                        newNode.value = lasp_atof(value.c_str());
-                        if(newNode.index > maxIndex) { maxIndex = newNode.index; }
+                        char* colon = strchr(tokens, ':');
+                        if(colon == 0) {
+                            cout << tokens << " is not a valid support vector entry." << endl;
+                            return INVALID_INPUT;
+                        }
                         
-                        currentNodes.push_back(newNode);
+                        int index = lasp_atoi(tokens);
+                        if(index > maxIndex) { maxIndex = index; }
+                        svInd.push_back(index - 1);
+                        svVal.push_back(lasp_atof(colon + 1));
                         tokens = strtok(NULL, " ");
                     }
-                    int curBetaVecIndex = 0;
-                    for(int i = 0; i < numClasses; ++i) {
-                        int otherClass = myModel.orderSeen[i];
-                        if(curClass == otherClass) continue;
-                        myModel.modelData[curClass][currentNodes][otherClass] = tempBetaVec[curBetaVecIndex];
-                        curBetaVecIndex++;
-                    }
-                    curNumSupportVector++;
+                    svPtr.push_back(svInd.size());
                 }
 			}
             //(Yu)
@@ -431,22 +389,26 @@ int lasp::load_model(const char* filename,
                 
             }
 		}
+		fin.close();
+		
+		int totalSV = 0;
+		for(int i = 0; i < supportVectorCounts.size(); ++i) {
+			totalSV += supportVectorCounts[i];
+		}
+		
+		if(totalSV != svPtr.size() - 1) {
+			cout << "model file has " << svPtr.size() - 1 << " support vectors, nr_sv gives " << totalSV << endl;
+			return INVALID_INPUT;
+		}
+		
 		myModel.numFeatures = maxIndex;
-		int curIndex = 0;
-		for(int i = 0; i < numClasses; ++i) {
-			for(int j = i+1; j < numClasses; ++j) {
-				int c1, c2;
-				c1 = myModel.orderSeen[i]; c2 = myModel.orderSeen[j];
-				myModel.offsets[c1][c2] = tempOffsetVector[curIndex];
-				if(tempPlattA.size() != 0) {
-					pair<double, double> curPair;
-					curPair.first = tempPlattA[curIndex]; curPair.second = tempPlattB[curIndex];
-					myModel.plattScaleCoefs[c1][c2] = curPair;
-				}
-				curIndex++;
-			}
+		myModel.offsets = tempOffsetVector;
+		myModel.plattScaleCoefs.clear();
+		for(int i = 0; i < tempPlattA.size() && i < tempPlattB.size(); ++i) {
+			myModel.plattScaleCoefs.push_back(pair<double, double>(tempPlattA[i], tempPlattB[i]));
 		}
-		fin.close();
+		
+		set_support_vectors(myModel, supportVectorCounts, svPtr, svInd, svVal, svCoefs);
 		return 0;
 	}
 	else {
@@ -456,7 +418,7 @@ int lasp::load_model(const char* filename,
 }
 
 
-int lasp::write_model(svm_model myModel, const char* filename)
+int lasp::write_model(svm_model const& myModel, const char* filename)
 {
 	ofstream fout;
 	fout.open(filename);
@@ -475,7 +437,7 @@ int lasp::write_model(svm_model myModel, const char* filename)
 	}
 }
 
-void lasp::write_header(svm_model model,
+void lasp::write_header(svm_model const& model,
 						ofstream &fout)
 {
 	//First things first, write out if we used pegasos bias
@@ -514,30 +476,15 @@ void lasp::write_header(svm_model model,
         default:
 			fout << endl;
 	}
-	fout << "nr_class " << model.modelData.size() << endl;
-	
-	int totalSV = 0;
-	//this map maps from {class -> numSupportVectors}
-	map<int, int> svClassMapping;
-	
-	for(int i = 0; i < model.orderSeen.size(); ++i) {
-		totalSV += model.modelData[model.orderSeen[i]].size();
-		svClassMapping[model.orderSeen[i]] = model.modelData[model.orderSeen[i]].size();
-	}
-	
-	
-	fout << "total_sv "<< totalSV << endl;
+	fout << "nr_class " << model.orderSeen.size() << endl;
+	fout << "total_sv "<< model.numSupportVectors() << endl;
 	fout << "rho ";
-	for(int i = 0; i < model.orderSeen.size(); ++i) {
-		for(int j = i + 1; j < model.orderSeen.size(); ++j) {
-			int c1 = model.orderSeen[i]; int c2 = model.orderSeen[j];
-			if (model.offsets[c1][c2] != 0) {
-				fout << -model.offsets[c1][c2] << " ";
-			}
-			else {
-				fout << "0 ";
-			}
-			
+	for(int pair = 0; pair < model.offsets.size(); ++pair) {
+		if (model.offsets[pair] != 0) {
+			fout << -model.offsets[pair] << " ";
+		}
+		else {
+			fout << "0 ";
 		}
 	}
 	fout << endl;
@@ -549,28 +496,21 @@ void lasp::write_header(svm_model model,
 	fout << endl;
 	fout << "nr_sv ";
 	for(int i = 0; i < model.orderSeen.size(); ++i) {
-		int curClass = model.orderSeen[i];
-		fout << svClassMapping[curClass];
-		if(i != svClassMapping.size()-1) fout << " ";
+		fout << model.classStart[i+1] - model.classStart[i];
+		if(i != model.orderSeen.size()-1) fout << " ";
 	}
 	fout << endl;
 	
 	if(model.plattScale) {
 		fout << "probA";
-		for(int i = 0; i < model.orderSeen.size(); ++i) {
-			for(int j = i + 1; j < model.orderSeen.size(); ++j) {
-				int c1 = model.orderSeen[i]; int c2 = model.orderSeen[j];
-				fout << " " << model.plattScaleCoefs[c1][c2].first;
-			}
+		for(int pair = 0; pair < model.plattScaleCoefs.size(); ++pair) {
+			fout << " " << model.plattScaleCoefs[pair].first;
 		}
 		fout << endl;
 		
 		fout << "probB";
-		for(int i = 0; i < model.orderSeen.size(); ++i) {
-			for(int j = i + 1; j < model.orderSeen.size(); ++j) {
-				int c1 = model.orderSeen[i]; int c2 = model.orderSeen[j];
-				fout << " " << model.plattScaleCoefs[c1][c2].second;
-			}
+		for(int pair = 0; pair < model.plattScaleCoefs.size(); ++pair) {
+			fout << " " << model.plattScaleCoefs[pair].second;
 		}
 		fout << endl;
 	}
@@ -579,33 +519,50 @@ void lasp::write_header(svm_model model,
 	fout << "SV" << endl;
 }
 
-void lasp::write_support_vectors(svm_model myModel,
+void lasp::write_support_vectors(svm_model const& myModel,
 								 ofstream& fout)
 {
-	for(int i = 0; i < myModel.orderSeen.size(); ++i) {
-		int curClassification = myModel.orderSeen[i];
-		//first write the betas, in the order seen
-		typedef map<vector<svm_node>, map<int, double>, CompareSparseVectors>::iterator SVIter;
-		for(SVIter iter = myModel.modelData[curClassification].begin();
-			iter != myModel.modelData[curClassification].end();
-			++iter) {
-			//first write the betas
-			for(int j = 0; j < myModel.orderSeen.size(); ++j) {
-				int otherClassification = myModel.orderSeen[j];
-				if(curClassification == otherClassification) continue;
-				fout << iter->second[otherClassification] << " ";
+	int numClasses = myModel.orderSeen.size();
+	bool sparse = myModel.xSparse.cols() > 0;
+	const float* betas = myModel.betas.data();
+	size_t betaRows = myModel.betas.mRows();
+	for(int i = 0; i < numClasses; ++i) {
+		for(int sv = myModel.classStart[i]; sv < myModel.classStart[i+1]; ++sv) {
+			//first write the betas, in the order seen
+			for(int j = 0; j < numClasses; ++j) {
+				if(i == j) continue;
+				int pair = i < j ? class_pair_index(i, j, numClasses) : class_pair_index(j, i, numClasses);
+				fout << betas[sv * betaRows + pair] << " ";
+			}
+			//now write the actual SV, skipping zeros
+			bool first = true;
+			if(sparse) {
+				const size_t* ptr = myModel.xSparse.colPtr();
+				const int* ind = myModel.xSparse.rowInd();
+				const float* val = myModel.xSparse.values();
+				for(size_t e = ptr[sv]; e < ptr[sv+1]; ++e) {
+					if(val[e] == 0) continue;
+					if(!first) fout << " ";
+					fout << ind[e] + 1 << ":" << val[e];
+					first = false;
+				}
 			}
-			//now write the actual SV
-			for(int j = 0; j < iter->first.size(); ++j) {
-				fout << iter->first[j].index << ":" << iter->first[j].value;
-				if(j != iter->first.size()-1) fout << " ";
+			else {
+				const float* col = myModel.xS.data() + (size_t)sv * myModel.xS.mRows();
+				for(int f = 0; f < myModel.xS.rows(); ++f) {
+					float value = col[f];
+					if(value == 0) continue;
+					if(!first) fout << " ";
+					fout << f + 1 << ":" << value;
+					first = false;
+				}
 			}
 			fout << endl;
 		}
 	}
 }
 
-void lasp::writeMeans(svm_model myModel, ofstream& fout){
+void lasp::writeMeans(svm_model const& myModel, ofstream& fout){
     
     fout << "Means" << endl;
     for (int i = 0; i < myModel.means.size(); ++i) {
@@ -614,7 +571,7 @@ void lasp::writeMeans(svm_model myModel, ofstream& fout){
     fout<<endl;
 }
 
-void lasp::writeStandardDeviations(svm_model myModel, ofstream& fout){
+void lasp::writeStandardDeviations(svm_model const& myModel, ofstream& fout){
     
     fout << "Standard-deviations" << endl;
     for (int i = 0; i < myModel.standardDeviations.size(); ++i) {
@@ -665,7 +622,7 @@ void lasp::sparse_vector_to_full(vector<double>& output,
 	for(int i = 0; i < input.size(); ++i) {
 		//The -1 here is because the file indexing is one greater
 		//than the array indexing.
-		if(input[i].index > 0 && input[i].index < output.size()) output[input[i].index-1] = input[i].value;
+		if(input[i].index > 0 && input[i].index <= output.size()) output[input[i].index-1] = input[i].value;
 	}
 }
 
@@ -723,11 +680,13 @@ void lasp::full_data_to_sparse(svm_sparse_data& sparseData,
 		for (int i = 0; i < fullData.numFeatures; ++i) {
 			if (fullData.x[xi + i]) {
 				svm_node node;
-				node.index = i;
+				node.index = i + 1;
 				node.value = fullData.x[xi + i];
 				newPoint.push_back(node);
 			}
 		}
+		
+		sparseData.pointOrder.push_back(label);
 	}
 	
 	sparseData.numFeatures = fullData.numFeatures;
@@ -741,6 +700,45 @@ void lasp::full_data_to_sparse(svm_sparse_data& sparseData,
 	sparseData.multiClass = sparseData.orderSeen.size() > 2;
 }
 
+void lasp::view_to_sparse(svm_sparse_data& sparseData)
+{
+	svm_data_view& view = sparseData.view;
+	if (view.empty()) {
+		return;
+	}
+	
+	vector<svm_node> point;
+	for (int i = 0; i < sparseData.numPoints; ++i) {
+		point.clear();
+		
+		//svm_nodes are indexed from 1
+		if (view.indptr) {
+			for (size_t k = view.indptr[i]; k < view.indptr[i + 1]; ++k) {
+				svm_node node;
+				node.index = view.indices[k] + 1;
+				node.value = view.values[k];
+				point.push_back(node);
+			}
+		} else {
+			const double* x = view.x + (size_t)i * sparseData.numFeatures;
+			for (int f = 0; f < sparseData.numFeatures; ++f) {
+				if (x[f]) {
+					svm_node node;
+					node.index = f + 1;
+					node.value = x[f];
+					point.push_back(node);
+				}
+			}
+		}
+		
+		int label = view.y ? int(view.y[i]) : 1;
+		sparseData.allData[label].push_back(point);
+		sparseData.pointOrder.push_back(label);
+	}
+	
+	sparseData.view = svm_data_view();
+}
+
 void lasp::sparse_data_to_full(svm_full_data& fullData,
 							   svm_sparse_data& sparseData)
 {
@@ -773,6 +771,162 @@ void lasp::sparse_data_to_full(svm_full_data& fullData,
 	fullData.numPoints = fullClassifications.size();
 }
 
+void lasp::sparse_data_to_columns(svm_full_data& fullData,
+								  LaspSparseMatrix<float>& x,
+								  svm_sparse_data& sparseData)
+{
+	vector<double> fullClassifications;
+	x = LaspSparseMatrix<float>(0, sparseData.numFeatures);
+	x.reserve(sparseData.numPoints, 0);
+	
+	vector<int> ind;
+	vector<float> val;
+	typedef map<int, vector<vector<svm_node> > >::iterator SparseIterator;
+	for(SparseIterator iter = sparseData.allData.begin();
+		iter != sparseData.allData.end();
+		++iter) {
+		for(int i = 0; i < iter->second.size(); ++i) {
+			vector<svm_node>& curSparse = iter->second[i];
+			ind.clear();
+			val.clear();
+			for(int j = 0; j < curSparse.size(); ++j) {
+				if(curSparse[j].index > 0) {
+					ind.push_back(curSparse[j].index - 1);
+					val.push_back(curSparse[j].value);
+				}
+			}
+			x.appendCol(ind.data(), val.data(), ind.size());
+			fullClassifications.push_back(iter->first);
+		}
+	}
+	
+	fullData.x = 0;
+	double_vector_to_float_array(fullData.y, fullClassifications);
+	fullData.numFeatures = sparseData.numFeatures;
+	fullData.numPoints = fullClassifications.size();
+}
+
+double lasp::sparse_data_density(svm_sparse_data& sparseData)
+{
+	size_t nnz = 0, numPoints = 0;
+	typedef map<int, vector<vector<svm_node> > >::iterator SparseIterator;
+	for(SparseIterator iter = sparseData.allData.begin();
+		iter != sparseData.allData.end();
+		++iter) {
+		numPoints += iter->second.size();
+		for(int i = 0; i < iter->second.size(); ++i) {
+			nnz += iter->second[i].size();
+		}
+	}
+	
+	if(numPoints == 0 || sparseData.numFeatures == 0) {
+		return 1.0;
+	}
+	
+	return nnz / ((double)numPoints * sparseData.numFeatures);
+}
+
+void lasp::set_support_vectors(svm_model& myModel,
+							   vector<int> const& svCounts,
+							   vector<size_t> const& ptr,
+							   vector<int> const& ind,
+							   vector<float> const& val,
+							   vector<double> const& betas)
+{
+	int numClasses = myModel.orderSeen.size();
+	int numPairs = (numClasses * (numClasses - 1)) / 2;
+	int numFeatures = std::max(0, myModel.numFeatures);
+	
+	myModel.classStart.assign(1, 0);
+	for(int i = 0; i < svCounts.size(); ++i) {
+		myModel.classStart.push_back(myModel.classStart.back() + svCounts[i]);
+	}
+	
+	int numSV = myModel.numSupportVectors();
+	size_t nnz = ptr[numSV];
+	double density = numSV == 0 || numFeatures == 0 ? 1.0 : nnz / ((double)numSV * numFeatures);
+	
+	//Same rule as the training data, pegasos models need the dense bias row
+	myModel.xS = LaspMatrix<float>();
+	myModel.xSparse = LaspSparseMatrix<float>();
+	myModel.xSNorm = LaspMatrix<float>();
+	if(numSV > 0 && !myModel.pegasos && density <= SPARSE_DENSITY) {
+		myModel.xSparse = LaspSparseMatrix<float>(numSV, numFeatures, &ptr[0], ind.data(), val.data());
+		myModel.xSparse.colSqSum(myModel.xSNorm);
+	}
+	else if(numSV > 0) {
+		myModel.xS = LaspMatrix<float>(numSV, numFeatures, 0.0);
+		
+#pragma omp parallel for
+		for(int sv = 0; sv < numSV; ++sv) {
+			for(size_t e = ptr[sv]; e < ptr[sv+1]; ++e) {
+				if(ind[e] >= 0 && ind[e] < numFeatures) {
+					myModel.xS(sv, ind[e]) = val[e];
+				}
+			}
+		}
+		
+		myModel.xSNorm = LaspMatrix<float>(numSV, 1);
+		myModel.xS.colSqSum(myModel.xSNorm);
+	}
+	
+	//libsvm order: the betas of a support vector of class i are against
+	//each other class j, skipping i
+	myModel.betas = LaspMatrix<float>(std::max(1, numSV), std::max(1, numPairs), 0.0);
+	for(int i = 0; i < numClasses; ++i) {
+		for(int sv = myModel.classStart[i]; sv < myModel.classStart[i+1]; ++sv) {
+			for(int j = 0, slot = 0; j < numClasses; ++j) {
+				if(i == j) continue;
+				int pair = i < j ? class_pair_index(i, j, numClasses) : class_pair_index(j, i, numClasses);
+				myModel.betas(sv, pair) = betas[(size_t)sv * (numClasses - 1) + slot++];
+			}
+		}
+	}
+	
+	set_linear_weights(myModel);
+}
+
+void lasp::set_linear_weights(svm_model& myModel)
+{
+	myModel.weights = LaspMatrix<float>();
+	if(myModel.kernelType != LINEAR) {
+		return;
+	}
+	
+	//Pegasos support vectors end in the bias feature, its weight is the bias
+	int numFeatures = myModel.xSparse.cols() > 0 ? myModel.xSparse.rows() : myModel.xS.rows();
+	int numPairs = myModel.betas.rows();
+	int numSV = myModel.numSupportVectors();
+	myModel.weights = LaspMatrix<float>(std::max(1, numFeatures), numPairs, 0.0);
+	
+	if(numSV == 0 || numFeatures == 0) {
+		return;
+	}
+	
+	if(myModel.xSparse.cols() > 0) {
+		const size_t* ptr = myModel.xSparse.colPtr();
+		const int* ind = myModel.xSparse.rowInd();
+		const float* val = myModel.xSparse.values();
+		
+		//One pair per thread, so no two threads write the same weight
+#pragma omp parallel for
+		for(int pair = 0; pair < numPairs; ++pair) {
+			for(int sv = 0; sv < numSV; ++sv) {
+				float beta = myModel.betas(sv, pair);
+				if(beta == 0) continue;
+				for(size_t e = ptr[sv]; e < ptr[sv+1]; ++e) {
+					myModel.weights(ind[e], pair) += beta * val[e];
+				}
+			}
+		}
+	}
+	else {
+		//weights = betas * xS'
+		LaspMatrix<float> betas = myModel.betas(0, 0, numSV, numPairs);
+		betas.multiply(myModel.xS, myModel.weights, false, true);
+	}
+}
+
 lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> solvedProblems,
 													 vector<lasp::svm_sparse_data> holdoutData,
 													 vector<int> orderSeen)
@@ -790,9 +944,6 @@ lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> s
 	for(int i = 0; i < solvedProblems.size(); ++i) {
 		int c1 = solvedProblems[i].classifications[0];
 		int c2 = solvedProblems[i].classifications[1];
-		//Enforce that the model contains all classes
-		returnModel.modelData[c1];
-		returnModel.modelData[c2];
 		int c1ind = -1;
 		int c2ind = -1;
 		for(int j = 0; j < orderSeen.size(); ++j) {
@@ -824,6 +975,14 @@ lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> s
     returnModel.means = solvedProblems[0].means;
     returnModel.standardDeviations = solvedProblems[0].standardDeviations;
     
+	//A point can be a support vector in every problem of its class, so
+	//each class keeps one copy of each, with its betas against all of
+	//the other classes (numClasses-1 per vector, in the order seen).
+	int numClasses = orderSeen.size();
+	vector<map<vector<svm_node>, int, CompareSparseVectors> > svIndex(numClasses);
+	vector<vector<vector<svm_node> > > classSV(numClasses);
+	vector<vector<double> > classBetas(numClasses);
+	
 	//Here's the big data-copy loop.
 	for(int i = 0; i < orderSeen.size(); ++i) {
 		for(int j = i+1; j < orderSeen.size(); ++j) {
@@ -831,12 +990,7 @@ lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> s
 			c1 = orderSeen[i]; c2 = orderSeen[j];
 			
 			svm_problem currentProblem = comparisonMapping[c1][c2];
-			returnModel.offsets[c1][c2] = currentProblem.bs.back();
-			//Now, let's extract the support vectors from each class
-			vector<vector<svm_node> > classOneSV;
-			vector<vector<svm_node> > classTwoSV;
-			vector<double> classOneBetas;
-			vector<double> classTwoBetas;
+			returnModel.offsets.push_back(currentProblem.bs.back());
 			
 			for(int k = 0; k < currentProblem.S.size(); ++k) {
 				int curClassification = currentProblem.y[currentProblem.S[k]] == 1 ?
@@ -845,7 +999,21 @@ lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> s
 				
 				vector<svm_node> currentSupportVector;
 				//Note that svm_nodes are indexed from 1.
-				for(int x = 0; x < currentProblem.features; ++x) {
+				if(currentProblem.xSparse.cols() > 0) {
+					//Support vectors were kept sparse, one column per entry of S
+					const size_t* ptr = currentProblem.xSparse.colPtr();
+					const int* ind = currentProblem.xSparse.rowInd();
+					const double* val = currentProblem.xSparse.values();
+					for(size_t e = ptr[k]; e < ptr[k+1]; ++e) {
+						if(fabs(val[e]) > 1E-20) {
+							svm_node newNode;
+							newNode.index = ind[e] + 1;
+							newNode.value = val[e];
+							currentSupportVector.push_back(newNode);
+						}
+					}
+				}
+				else for(int x = 0; x < currentProblem.features; ++x) {
 					double value = currentProblem.xS[k*currentProblem.features+x];
 					if(fabs(value) > 1E-20) {
 						svm_node newNode;
@@ -857,29 +1025,24 @@ lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> s
 				}
 				
 				//we have reconstructed the sparse representation of a given support vector,
-				//now we just need to put it into the correct list of support vectors
-				if(curClassification == c1) {
-					classOneSV.push_back(currentSupportVector);
-					classOneBetas.push_back(currentProblem.betas.back()[k]);
+				//now we just need to find (or add) it among its class's support vectors
+				int own = curClassification == c1 ? i : j; //assume it's in class two.
+				int other = own == i ? j : i;
+				
+				int index;
+				map<vector<svm_node>, int, CompareSparseVectors>::iterator found = svIndex[own].find(currentSupportVector);
+				if(found == svIndex[own].end()) {
+					index = classSV[own].size();
+					svIndex[own][currentSupportVector] = index;
+					classSV[own].push_back(currentSupportVector);
+					classBetas[own].resize(classBetas[own].size() + numClasses - 1, 0.0);
 				}
-				else { //assume it's in class two.
-					classTwoSV.push_back(currentSupportVector);
-					classTwoBetas.push_back(currentProblem.betas.back()[k]);
+				else {
+					index = found->second;
 				}
 				
-			}
-			
-			//we now have two vectors containing the sparse representations for each class
-			//and two more vectors representing the corresponding beta values.
-			//Now, we need to put the data into the svm_model's modelData.
-			
-			typedef map<vector<svm_node>, map<int, double>, CompareSparseVectors>::iterator MyIter;
-			
-			for(int k = 0; k < classOneSV.size(); ++k) {
-				returnModel.modelData[c1][classOneSV[k]][c2] += classOneBetas[k];
-			}
-			for(int k = 0; k < classTwoSV.size(); ++k) {
-				returnModel.modelData[c2][classTwoSV[k]][c1] += classTwoBetas[k];
+				int slot = other < own ? other : other - 1;
+				classBetas[own][index * (numClasses - 1) + slot] += currentProblem.betas.back()[k];
 			}
 			
 			//TODO: This should probably be referenced counted or something
@@ -889,6 +1052,29 @@ lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> s
 		
 	}
 	
+	//Assume all problems were trained the same way
+	returnModel.pegasos = solvedProblems[0].options.pegasos && solvedProblems[0].options.usebias && solvedProblems[0].options.bias != 0;
+	
+	//Flatten the classes into the model's compiled layout
+	vector<int> svCounts;
+	vector<size_t> svPtr(1, 0);
+	vector<int> svInd;
+	vector<float> svVal;
+	vector<double> svBetas;
+	for(int i = 0; i < numClasses; ++i) {
+		svCounts.push_back(classSV[i].size());
+		svBetas.insert(svBetas.end(), classBetas[i].begin(), classBetas[i].end());
+		for(int k = 0; k < classSV[i].size(); ++k) {
+			for(int e = 0; e < classSV[i][k].size(); ++e) {
+				svInd.push_back(classSV[i][k][e].index - 1);
+				svVal.push_back(classSV[i][k][e].value);
+			}
+			svPtr.push_back(svInd.size());
+		}
+	}
+	
+	set_support_vectors(returnModel, svCounts, svPtr, svInd, svVal, svBetas);
+	
 	returnModel.plattScale = (holdoutData.size() != 0);
 	if(returnModel.plattScale) {
 		//now, we train the sigmoid parameters.
@@ -925,20 +1111,17 @@ lasp::svm_model lasp::get_model_from_solved_problems(vector<lasp::svm_problem> s
 			for(int j = i + 1; j < orderSeen.size(); ++j) {
 				svm_sparse_data curHoldout = holdoutMapping[orderSeen[i]][orderSeen[j]];
 				pair<double, double> curPair(1.0, 1.0); //= get_optimal_sigmoid_parameters(curHoldout, returnModel);
-				returnModel.plattScaleCoefs[orderSeen[i]][orderSeen[j]] = curPair;
+				returnModel.plattScaleCoefs.push_back(curPair);
 			}
 		}
 	}
 	
-	//Assume all problems were trained the same way
-	returnModel.pegasos = solvedProblems[0].options.pegasos && solvedProblems[0].options.usebias && solvedProblems[0].options.bias != 0;
-	
 	return returnModel;
 }
 
 
 
-lasp::svm_problem lasp::get_onevsone_subproblem(svm_sparse_data myData,
+lasp::svm_problem lasp::get_onevsone_subproblem(svm_sparse_data& myData,
 												svm_sparse_data& holdoutData,
 												int class1,
 												int class2,
@@ -966,13 +1149,18 @@ lasp::svm_problem lasp::get_onevsone_subproblem(svm_sparse_data myData,
 }
 
 
-lasp::svm_problem lasp::get_onevsone_subproblem(svm_sparse_data myData,
+lasp::svm_problem lasp::get_onevsone_subproblem(svm_sparse_data& myData,
 												int class1,
 												int class2,
 												opt options)
 {
 	svm_problem returnProblem;
 	
+	if (!myData.view.empty()) {
+		setup_svm_problem_view(returnProblem, myData, options, class1, class2);
+		return returnProblem;
+	}
+	
 	svm_sparse_data tempSparseData;
 	tempSparseData.numFeatures = myData.numFeatures;
 	tempSparseData.multiClass = myData.multiClass;
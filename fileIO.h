@@ -34,7 +34,7 @@
 namespace lasp
 {
     //Given the svm_model, writes a libsvm style output file
-    int write_model(svm_model, const char* filename);
+    int write_model(svm_model const& myModel, const char* filename);
     
     //Given a vector of solved svm_problems, and an integer
     //vector representing the order in which the classes were seen
@@ -43,14 +43,31 @@ namespace lasp
                                              vector<svm_sparse_data> holdouts,
                                              vector<int> orderSeen);
     
-    void write_header(svm_model model, ofstream& fout);
+    //Given a model with its classes, kernel, numFeatures and pegasos
+    //flag set, stores its support vectors: svCounts of each class in
+    //orderSeen order, as compressed columns ptr/ind/val with 0-based
+    //features, and numClasses-1 betas per vector in libsvm order.
+    void set_support_vectors(svm_model& myModel,
+                             vector<int> const& svCounts,
+                             vector<size_t> const& ptr,
+                             vector<int> const& ind,
+                             vector<float> const& val,
+                             vector<double> const& betas);
     
-    void write_support_vectors(svm_model myModel, ofstream& fout);
+    //Collapses the support vectors of a linear model into one weight
+    //vector per class pair (myModel.weights), so that prediction does
+    //not depend on the number of support vectors. Clears them for
+    //other kernels.
+    void set_linear_weights(svm_model& myModel);
+    
+    void write_header(svm_model const& model, ofstream& fout);
+    
+    void write_support_vectors(svm_model const& myModel, ofstream& fout);
     
     //(Yu)
-    void writeMeans(svm_model myModel, ofstream& fout);
+    void writeMeans(svm_model const& myModel, ofstream& fout);
     //(Yu)
-    void writeStandardDeviations(svm_model myModel, ofstream& fout);
+    void writeStandardDeviations(svm_model const& myModel, ofstream& fout);
     
     
     //given a path to a libsvm style data file and
@@ -69,7 +86,8 @@ namespace lasp
     //file at filename and outputs the support vectors
     //in sparse form in sparseOutput, and the number
     //of features in numFeaturesFound. Sets all
-    //model parameters except myModel.xS and myModel.numFeatures
+    //model parameters except myModel.xS and myModel.numFeatures.
+    //Binary model files are mapped instead, see load_binary_model.
     int load_model(const char* filename,
                    svm_model& myModel);
     
@@ -108,25 +126,39 @@ namespace lasp
     
     void sparse_data_to_full(svm_full_data& fullData,
                              svm_sparse_data& sparseData);
+    
+    //Same point order as sparse_data_to_full, but the points stay
+    //sparse as the columns of x, only the labels go in fullData.
+    void sparse_data_to_columns(svm_full_data& fullData,
+                                LaspSparseMatrix<float>& x,
+                                svm_sparse_data& sparseData);
+    
+    //Fraction of the entries of sparseData that are nonzero
+    double sparse_data_density(svm_sparse_data& sparseData);
 	
     void full_data_to_sparse(svm_sparse_data& sparseData,
                              svm_full_data fullData);
     
+    //Copies the points of a data view into allData and unsets the view,
+    //for the code that only reads allData
+    void view_to_sparse(svm_sparse_data& sparseData);
+    
     
     //Given a sparse data set, the two classes that you want to
     //use for your problem and an options struct, return an svm
     //problem that is set up with only examples from those two
     //classes. Also, fills holdoutData with 30% of the potential
     //training data for platt scaling.
-    svm_problem get_onevsone_subproblem(svm_sparse_data myData,
+    svm_problem get_onevsone_subproblem(svm_sparse_data& myData,
                                         svm_sparse_data& holdoutData,
                                         int class1,
                                         int class2,
                                         opt options);
     
     
-    //the non-platt scaled version of the above.
-    svm_problem get_onevsone_subproblem(svm_sparse_data myData,
+    //the non-platt scaled version of the above, which also takes data views.
+    //myData must hold both classes.
+    svm_problem get_onevsone_subproblem(svm_sparse_data& myData,
                                         int class1,
                                         int class2,
                                         opt options);
@@ -0,0 +1,1047 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fileIO_binary.h"
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace lasp {
+	
+	static const char binaryMagic[8] = {'W', 'U', 'S', 'V', 'M', 'D', 'A', 'T'};
+	static const uint32_t binaryVersion = 1;
+	static const char modelMagic[8] = {'W', 'U', 'S', 'V', 'M', 'M', 'O', 'D'};
+	static const uint32_t modelVersion = 1;
+	
+	//Unmaps a file once the last matrix using it is gone
+	struct unmap_file {
+		size_t size;
+		unmap_file(size_t size_): size(size_) {}
+		void operator()(void* ptr) const {
+			munmap(ptr, size);
+		}
+	};
+	
+	static uint64_t align_section(uint64_t offset){
+		return (offset + 63) & ~(uint64_t)63;
+	}
+	
+	//Lay out the sections of a file with the given dimensions, returns the total size
+	static uint64_t layout_binary_data(binary_data_header& header){
+		uint64_t offset = align_section(sizeof(binary_data_header));
+		header.labelOffset = offset;
+		offset = align_section(offset + header.n * sizeof(double));
+		
+		header.dataOffset = header.indptrOffset = header.indexOffset = header.valueOffset = 0;
+		if (header.sparse) {
+			header.indptrOffset = offset;
+			offset = align_section(offset + (header.n + 1) * sizeof(int64_t));
+			header.indexOffset = offset;
+			offset = align_section(offset + header.nnz * sizeof(int32_t));
+			header.valueOffset = offset;
+			offset += header.nnz * sizeof(double);
+		} else {
+			header.dataOffset = offset;
+			offset += header.n * header.d * sizeof(double);
+		}
+		
+		return offset;
+	}
+	
+	static uint64_t model_pairs(binary_model_header const& header){
+		return (uint64_t)header.numClasses * (header.numClasses - 1) / 2;
+	}
+	
+	//Same for a model file, betas always hold at least one element like svm_model's
+	static uint64_t layout_binary_model(binary_model_header& header){
+		uint64_t betaCols = std::max<uint64_t>(1, header.numSV);
+		uint64_t betaRows = std::max<uint64_t>(1, model_pairs(header));
+		
+		uint64_t offset = align_section(sizeof(binary_model_header));
+		header.labelOffset = offset;
+		offset += header.numClasses * sizeof(int32_t);
+		header.classStartOffset = offset;
+		offset = align_section(offset + (header.numClasses + 1) * sizeof(int32_t));
+		header.offsetOffset = offset;
+		offset += header.numOffsets * sizeof(double);
+		header.plattOffset = offset;
+		offset = align_section(offset + 2 * header.numPlatt * sizeof(double));
+		header.meanOffset = offset;
+		offset += header.numMeans * sizeof(double);
+		header.stdOffset = offset;
+		offset = align_section(offset + header.numStd * sizeof(double));
+		header.betaOffset = offset;
+		offset = align_section(offset + betaCols * betaRows * sizeof(float));
+		header.normOffset = offset;
+		offset = align_section(offset + header.numSV * sizeof(float));
+		
+		header.dataOffset = header.indptrOffset = header.indexOffset = header.valueOffset = 0;
+		if (header.sparse) {
+			header.indptrOffset = offset;
+			offset = align_section(offset + (header.numSV + 1) * sizeof(uint64_t));
+			header.indexOffset = offset;
+			offset = align_section(offset + header.nnz * sizeof(int32_t));
+			header.valueOffset = offset;
+			offset += header.nnz * sizeof(float);
+		} else {
+			header.dataOffset = offset;
+			offset += header.numSV * header.d * sizeof(float);
+		}
+		
+		return offset;
+	}
+	
+	static bool has_magic(const char* filename, const char* expected){
+		ifstream fin(filename, ios::binary);
+		char magic[8];
+		
+		if (!fin.read(magic, sizeof(magic))) {
+			return false;
+		}
+		
+		return memcmp(magic, expected, sizeof(magic)) == 0;
+	}
+	
+	static inline bool is_digit(char c){
+		return c >= '0' && c <= '9';
+	}
+	
+	static inline bool is_line_end(const char* pos, const char* end){
+		return pos == end || *pos == '\n' || *pos == '\r';
+	}
+	
+	static inline void skip_blanks(const char*& pos, const char* end){
+		while (pos != end && (*pos == ' ' || *pos == '\t')) {
+			++pos;
+		}
+	}
+	
+	//Parses a (possibly signed) integer in [pos, end)
+	static inline bool scan_long(const char*& pos, const char* end, long& value){
+		const char* p = pos;
+		bool negative = false;
+		
+		if (p != end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+		
+		if (p == end || !is_digit(*p)) {
+			return false;
+		}
+		
+		long result = 0;
+		while (p != end && is_digit(*p)) {
+			result = result * 10 + (*p - '0');
+			++p;
+		}
+		
+		value = negative ? -result : result;
+		pos = p;
+		return true;
+	}
+	
+	//Parses a decimal number in [pos, end). Numbers with at most 15 significant
+	//digits and small exponents are exact in double arithmetic, everything else
+	//(long mantissas, inf, nan, hex) goes through strtod on a bounded copy.
+	static inline bool scan_double(const char*& pos, const char* end, double& value){
+		static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+			1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+		
+		const char* p = pos;
+		bool negative = false;
+		
+		if (p != end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+		
+		uint64_t mantissa = 0;
+		int digits = 0, exponent = 0;
+		bool anyDigits = false, fast = true;
+		
+		for (; p != end && is_digit(*p); ++p) {
+			anyDigits = true;
+			if (mantissa == 0 && *p == '0') continue;
+			if (++digits > 15) fast = false;
+			else mantissa = mantissa * 10 + (*p - '0');
+		}
+		
+		if (p != end && *p == '.') {
+			for (++p; p != end && is_digit(*p); ++p) {
+				anyDigits = true;
+				if (mantissa == 0 && *p == '0') {
+					--exponent;
+					continue;
+				}
+				if (++digits > 15) fast = false;
+				else {
+					mantissa = mantissa * 10 + (*p - '0');
+					--exponent;
+				}
+			}
+		}
+		
+		if (anyDigits && p != end && (*p == 'e' || *p == 'E')) {
+			long exp10;
+			const char* expPos = p + 1;
+			if (scan_long(expPos, end, exp10)) {
+				p = expPos;
+				if (exp10 > 1000 || exp10 < -1000) fast = false;
+				else exponent += exp10;
+			}
+		}
+		
+		if (anyDigits && fast && (mantissa == 0 || (exponent >= -22 && exponent <= 22))) {
+			double result = static_cast<double>(mantissa);
+			if (exponent < 0) result /= powers[-exponent];
+			else result *= powers[exponent];
+			
+			value = negative ? -result : result;
+			pos = p;
+			return true;
+		}
+		
+		//Slow path, the mapped input is not null terminated so copy the token
+		char token[128];
+		size_t length = 0;
+		for (p = pos; p != end && length < sizeof(token) - 1 && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' && *p != ':'; ++p) {
+			token[length++] = *p;
+		}
+		token[length] = '\0';
+		
+		char* tokenEnd;
+		value = strtod(token, &tokenEnd);
+		if (tokenEnd == token) {
+			return false;
+		}
+		
+		pos += tokenEnd - token;
+		return true;
+	}
+	
+	//Reads the next index:value pair of a LIBSVM line, returns false at the end of the line
+	static inline bool next_feature(const char*& pos, const char* end, long& index, double& value, bool& error){
+		skip_blanks(pos, end);
+		if (is_line_end(pos, end)) {
+			return false;
+		}
+		
+		if (!scan_long(pos, end, index) || pos == end || *pos != ':') {
+			error = true;
+			return false;
+		}
+		
+		++pos;
+		if (!scan_double(pos, end, value) || !(is_line_end(pos, end) || *pos == ' ' || *pos == '\t')) {
+			error = true;
+			return false;
+		}
+		
+		return true;
+	}
+	
+	//Reads the label of a LIBSVM line, returns false for blank lines
+	static inline bool read_label(const char*& pos, const char* end, double& label, bool& error){
+		skip_blanks(pos, end);
+		if (is_line_end(pos, end)) {
+			return false;
+		}
+		
+		if (!scan_double(pos, end, label) || !(is_line_end(pos, end) || *pos == ' ' || *pos == '\t')) {
+			error = true;
+			return false;
+		}
+		
+		return true;
+	}
+	
+	bool is_binary_data(const char* filename){
+		return has_magic(filename, binaryMagic);
+	}
+	
+	int convert_LIBSVM_to_binary(const char* textFile, const char* binaryFile, bool sparse){
+		ifstream fin(textFile);
+		if (!fin.is_open()) {
+			cerr << "Could not open " << textFile << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		//First pass, get the dimensions
+		binary_data_header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+		header.version = binaryVersion;
+		header.sparse = sparse ? 1 : 0;
+		
+		long minIndex = std::numeric_limits<long>::max(), maxIndex = 0;
+		string line;
+		bool error = false;
+		
+		while (getline(fin, line)) {
+			const char* pos = line.c_str();
+			const char* lineEnd = pos + line.size();
+			double label, value;
+			long index;
+			
+			if (!read_label(pos, lineEnd, label, error)) {
+				if (error) break;
+				continue;
+			}
+			
+			while (next_feature(pos, lineEnd, index, value, error)) {
+				minIndex = std::min(minIndex, index);
+				maxIndex = std::max(maxIndex, index);
+				header.nnz++;
+			}
+			
+			if (error) break;
+			header.n++;
+		}
+		
+		if (error || minIndex < 0) {
+			cerr << "Error reading line " << header.n + 1 << " of " << textFile << endl;
+			return INVALID_INPUT;
+		}
+		
+		//Same convention as load_sparse_data, files with a 0 index are zero indexed
+		long indexBase = minIndex == 0 ? 0 : 1;
+		header.d = maxIndex + 1 - indexBase;
+		uint64_t fileSize = layout_binary_data(header);
+		
+		//Second pass, write straight into the mapped output file
+		int fd = open(binaryFile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			cerr << "Could not open " << binaryFile << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		if (ftruncate(fd, fileSize) != 0) {
+			cerr << "Could not allocate " << fileSize << " bytes for " << binaryFile << endl;
+			close(fd);
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		char* out = static_cast<char*>(mmap(0, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+		close(fd);
+		
+		if (out == MAP_FAILED) {
+			cerr << "Could not map " << binaryFile << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		memcpy(out, &header, sizeof(header));
+		double* labels = reinterpret_cast<double*>(out + header.labelOffset);
+		double* dense = reinterpret_cast<double*>(out + header.dataOffset);
+		int64_t* indptr = reinterpret_cast<int64_t*>(out + header.indptrOffset);
+		int32_t* indices = reinterpret_cast<int32_t*>(out + header.indexOffset);
+		double* values = reinterpret_cast<double*>(out + header.valueOffset);
+		
+		fin.clear();
+		fin.seekg(0, ios::beg);
+		
+		uint64_t point = 0, nnz = 0;
+		if (sparse) {
+			indptr[0] = 0;
+		}
+		
+		while (point < header.n && getline(fin, line)) {
+			const char* pos = line.c_str();
+			const char* lineEnd = pos + line.size();
+			double label, value;
+			long index;
+			
+			if (!read_label(pos, lineEnd, label, error)) {
+				continue;
+			}
+			
+			labels[point] = label;
+			while (next_feature(pos, lineEnd, index, value, error)) {
+				if (sparse) {
+					indices[nnz] = index - indexBase;
+					values[nnz] = value;
+				} else {
+					dense[point * header.d + (index - indexBase)] = value;
+				}
+				++nnz;
+			}
+			
+			++point;
+			if (sparse) {
+				indptr[point] = nnz;
+			}
+		}
+		
+		munmap(out, fileSize);
+		return CORRECT;
+	}
+	
+	int load_binary_data(const char* filename, binary_data& data){
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			cerr << "Could not open " << filename << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(binary_data_header)) {
+			cerr << filename << " is not a binary dataset" << endl;
+			close(fd);
+			return INVALID_INPUT;
+		}
+		
+		//Private mapping, writes (i.e. feature scaling) never reach the file
+		size_t fileSize = fileStat.st_size;
+		void* addr = mmap(0, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		
+		if (addr == MAP_FAILED) {
+			cerr << "Could not map " << filename << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		shared_ptr<void> mapping(addr, unmap_file(fileSize));
+		char* base = static_cast<char*>(addr);
+		
+		binary_data_header header;
+		memcpy(&header, base, sizeof(header));
+		
+		binary_data_header expected = header;
+		uint64_t expectedSize = layout_binary_data(expected);
+		
+		if (memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0 || header.version != binaryVersion ||
+			expectedSize > fileSize || memcmp(&header, &expected, sizeof(header)) != 0) {
+			cerr << filename << " is not a valid binary dataset" << endl;
+			return INVALID_INPUT;
+		}
+		
+		data.sparse = header.sparse != 0;
+		data.n = header.n;
+		data.d = header.d;
+		
+		double* labels = reinterpret_cast<double*>(base + header.labelOffset);
+		data.Y = LaspMatrix<double>::borrow(header.n, 1, labels, mapping);
+		
+		data.csr = csr_data();
+		data.csr.n = header.n;
+		data.csr.d = header.d;
+		data.csr.labels = labels;
+		
+		if (data.sparse) {
+			data.X = LaspMatrix<double>();
+			data.csr.nnz = header.nnz;
+			data.csr.indptr = reinterpret_cast<int64_t*>(base + header.indptrOffset);
+			data.csr.indices = reinterpret_cast<int32_t*>(base + header.indexOffset);
+			data.csr.values = reinterpret_cast<double*>(base + header.valueOffset);
+			data.csr.storage = mapping;
+		} else {
+			data.X = LaspMatrix<double>::borrow(header.n, header.d, reinterpret_cast<double*>(base + header.dataOffset), mapping);
+		}
+		
+		return CORRECT;
+	}
+	
+	int csr_to_dense(csr_data const& csr, LaspMatrix<double>& X){
+		X = LaspMatrix<double>(csr.n, csr.d, 0.0);
+		double* dataTemp = X.data();
+		size_t mRowsTemp = X.mRows();
+		
+#pragma omp parallel for
+		for (int64_t i = 0; i < (int64_t)csr.n; ++i) {
+			for (int64_t k = csr.indptr[i]; k < csr.indptr[i+1]; ++k) {
+				dataTemp[i * mRowsTemp + csr.indices[k]] = csr.values[k];
+			}
+		}
+		
+		return CORRECT;
+	}
+	
+	//Two pass feature statistics for csr data that was not parsed from text
+	static void compute_feature_stats(csr_data const& csr, feature_stats& stats){
+		vector<double> sums(csr.d, 0.0);
+		vector<size_t> counts(csr.d, 0);
+		
+		for (size_t k = 0; k < csr.nnz; ++k) {
+			sums[csr.indices[k]] += csr.values[k];
+			counts[csr.indices[k]]++;
+		}
+		
+		stats.mean.assign(csr.d, 0.0);
+		stats.m2.assign(csr.d, 0.0);
+		for (size_t j = 0; j < csr.d; ++j) {
+			stats.mean[j] = sums[j] / csr.n;
+		}
+		
+		for (size_t k = 0; k < csr.nnz; ++k) {
+			double diff = csr.values[k] - stats.mean[csr.indices[k]];
+			stats.m2[csr.indices[k]] += diff * diff;
+		}
+		
+		for (size_t j = 0; j < csr.d; ++j) {
+			stats.m2[j] += (csr.n - counts[j]) * stats.mean[j] * stats.mean[j];
+		}
+	}
+	
+	int csr_to_sparse_data(csr_data const& csr, svm_sparse_data& myData, feature_stats const* stats){
+		feature_stats localStats;
+		if (stats == 0) {
+			compute_feature_stats(csr, localStats);
+			stats = &localStats;
+		}
+		
+		//Size every class up front so each point is a single allocation
+		map<int, size_t> classCounts;
+		for (size_t i = 0; i < csr.n; ++i) {
+			int classification = static_cast<int>(csr.labels[i]);
+			if (classCounts[classification]++ == 0 && std::find(myData.orderSeen.begin(), myData.orderSeen.end(), classification) == myData.orderSeen.end()) {
+				myData.orderSeen.push_back(classification);
+			}
+		}
+		
+		for (map<int, size_t>::iterator iter = classCounts.begin(); iter != classCounts.end(); ++iter) {
+			myData.allData[iter->first].reserve(myData.allData[iter->first].size() + iter->second);
+		}
+		
+		myData.pointOrder.reserve(myData.pointOrder.size() + csr.n);
+		for (size_t i = 0; i < csr.n; ++i) {
+			int classification = static_cast<int>(csr.labels[i]);
+			myData.pointOrder.push_back(classification);
+			
+			vector<vector<svm_node> >& classData = myData.allData[classification];
+			classData.push_back(vector<svm_node>(csr.indptr[i+1] - csr.indptr[i]));
+			vector<svm_node>& currentNodes = classData.back();
+			
+			for (int64_t k = csr.indptr[i]; k < csr.indptr[i+1]; ++k) {
+				svm_node& newNode = currentNodes[k - csr.indptr[i]];
+				newNode.index = csr.indices[k] + 1;
+				newNode.value = csr.values[k];
+			}
+		}
+		
+		myData.numPoints = csr.n;
+		myData.numFeatures = csr.d;
+		myData.multiClass = myData.allData.size() > 2;
+		
+		//Means and standard deviations over all points, zeros included
+		myData.means.assign(stats->mean.begin(), stats->mean.end());
+		myData.standardDeviations.resize(csr.d);
+		for (size_t j = 0; j < csr.d; ++j) {
+			double std = sqrt(stats->m2[j] / csr.n);
+			if (std < std::numeric_limits<double>::denorm_min()) std = 1;
+			myData.standardDeviations[j] = std;
+		}
+		
+		return CORRECT;
+	}
+	
+	//Memory behind csr data parsed from text
+	struct csr_storage {
+		vector<double> labels, values;
+		vector<int64_t> indptr;
+		vector<int32_t> indices;
+	};
+	
+	//One byte range of a text file being parsed
+	struct parse_chunk {
+		const char *begin, *end;
+		size_t rows, nnz, rowStart, nnzStart;
+		long minIndex, maxIndex;
+		bool error;
+		
+		//Running statistics for the nonzeros in this range, by raw file index
+		vector<double> count, mean, m2;
+	};
+	
+	//Merge (nB, meanB, m2B) into (nA, meanA, m2A) with Chan's parallel update
+	static inline void merge_stats(double& nA, double& meanA, double& m2A, double nB, double meanB, double m2B){
+		double n = nA + nB;
+		if (n == 0) return;
+		
+		double delta = meanB - meanA;
+		meanA += delta * nB / n;
+		m2A += m2B + delta * delta * nA * nB / n;
+		nA = n;
+	}
+	
+	int load_LIBSVM_csr(const char* filename, csr_data& csr, feature_stats* stats){
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0) {
+			close(fd);
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		size_t fileSize = fileStat.st_size;
+		shared_ptr<void> mapping;
+		const char* text = "";
+		
+		if (fileSize > 0) {
+			void* addr = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr == MAP_FAILED) {
+				close(fd);
+				cerr << "Could not map " << filename << endl;
+				return UNOPENED_FILE_ERROR;
+			}
+			
+			madvise(addr, fileSize, MADV_SEQUENTIAL);
+			mapping = shared_ptr<void>(addr, unmap_file(fileSize));
+			text = static_cast<const char*>(addr);
+		}
+		close(fd);
+		
+		const char* textEnd = text + fileSize;
+		
+		//Split into byte ranges that start on line boundaries, small files
+		//are not worth the threads
+		int numChunks = 1;
+#ifdef _OPENMP
+		numChunks = std::max(1, std::min(omp_get_max_threads(), static_cast<int>(fileSize >> 16)));
+#endif
+		
+		vector<parse_chunk> chunks(numChunks);
+		for (int c = 0; c < numChunks; ++c) {
+			parse_chunk& chunk = chunks[c];
+			chunk.begin = text;
+			if (c > 0) {
+				const char* split = text + fileSize / numChunks * c - 1;
+				const char* newline = static_cast<const char*>(memchr(split, '\n', textEnd - split));
+				chunk.begin = newline ? newline + 1 : textEnd;
+				chunk.begin = std::max(chunk.begin, chunks[c-1].begin);
+			}
+			
+			chunk.rows = chunk.nnz = 0;
+			chunk.minIndex = std::numeric_limits<long>::max();
+			chunk.maxIndex = -1;
+			chunk.error = false;
+		}
+		
+		for (int c = 0; c < numChunks; ++c) {
+			chunks[c].end = c + 1 < numChunks ? chunks[c+1].begin : textEnd;
+		}
+		
+		//First pass only counts points and index:value pairs
+#pragma omp parallel for num_threads(numChunks) schedule(static, 1)
+		for (int c = 0; c < numChunks; ++c) {
+			parse_chunk& chunk = chunks[c];
+			const char* pos = chunk.begin;
+			
+			while (pos < chunk.end) {
+				const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', chunk.end - pos));
+				if (lineEnd == 0) lineEnd = chunk.end;
+				
+				skip_blanks(pos, lineEnd);
+				if (!is_line_end(pos, lineEnd)) {
+					chunk.rows++;
+					for (; pos != lineEnd; ++pos) {
+						chunk.nnz += *pos == ':';
+					}
+				}
+				
+				pos = lineEnd == chunk.end ? lineEnd : lineEnd + 1;
+			}
+		}
+		
+		size_t n = 0, nnz = 0;
+		for (int c = 0; c < numChunks; ++c) {
+			chunks[c].rowStart = n;
+			chunks[c].nnzStart = nnz;
+			n += chunks[c].rows;
+			nnz += chunks[c].nnz;
+		}
+		
+		shared_ptr<csr_storage> storage(new csr_storage);
+		storage->labels.resize(n);
+		storage->indptr.resize(n + 1);
+		storage->indices.resize(nnz);
+		storage->values.resize(nnz);
+		storage->indptr[0] = 0;
+		
+		double* labels = storage->labels.data();
+		int64_t* indptr = storage->indptr.data();
+		int32_t* indices = storage->indices.data();
+		double* values = storage->values.data();
+		
+		//Second pass parses into the preallocated arrays
+#pragma omp parallel for num_threads(numChunks) schedule(static, 1)
+		for (int c = 0; c < numChunks; ++c) {
+			parse_chunk& chunk = chunks[c];
+			const char* pos = chunk.begin;
+			size_t row = chunk.rowStart, k = chunk.nnzStart;
+			size_t rowEnd = chunk.rowStart + chunk.rows, kEnd = chunk.nnzStart + chunk.nnz;
+			
+			while (pos < chunk.end && !chunk.error) {
+				const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', chunk.end - pos));
+				if (lineEnd == 0) lineEnd = chunk.end;
+				
+				double label, value;
+				long index;
+				
+				if (read_label(pos, lineEnd, label, chunk.error)) {
+					if (row == rowEnd) {
+						chunk.error = true;
+						break;
+					}
+					
+					labels[row] = label;
+					
+					while (next_feature(pos, lineEnd, index, value, chunk.error)) {
+						if (k == kEnd || index < 0 || index > std::numeric_limits<int32_t>::max()) {
+							chunk.error = true;
+							break;
+						}
+						
+						indices[k] = index;
+						values[k++] = value;
+						
+						if (index >= static_cast<long>(chunk.count.size())) {
+							size_t newSize = std::max<size_t>(index + 1, chunk.count.size() * 2);
+							chunk.count.resize(newSize, 0.0);
+							chunk.mean.resize(newSize, 0.0);
+							chunk.m2.resize(newSize, 0.0);
+						}
+						
+						chunk.minIndex = std::min(chunk.minIndex, index);
+						chunk.maxIndex = std::max(chunk.maxIndex, index);
+						
+						//Welford update over the nonzeros
+						double count = ++chunk.count[index];
+						double delta = value - chunk.mean[index];
+						chunk.mean[index] += delta / count;
+						chunk.m2[index] += delta * (value - chunk.mean[index]);
+					}
+					
+					indptr[++row] = k;
+				}
+				
+				pos = lineEnd == chunk.end ? lineEnd : lineEnd + 1;
+			}
+			
+			if (row != rowEnd || k != kEnd) {
+				chunk.error = true;
+			}
+		}
+		
+		long minIndex = std::numeric_limits<long>::max(), maxIndex = -1;
+		for (int c = 0; c < numChunks; ++c) {
+			if (chunks[c].error) {
+				cerr << "Error reading " << filename << " after point " << chunks[c].rowStart << endl;
+				return INVALID_INPUT;
+			}
+			
+			minIndex = std::min(minIndex, chunks[c].minIndex);
+			maxIndex = std::max(maxIndex, chunks[c].maxIndex);
+		}
+		
+		//Same convention as before, files with a 0 index are zero indexed
+		long indexBase = minIndex == 0 || maxIndex < 0 ? 0 : 1;
+		size_t d = maxIndex + 1 - indexBase;
+		
+		if (indexBase != 0) {
+#pragma omp parallel for
+			for (long long i = 0; i < (long long)nnz; ++i) {
+				indices[i] -= indexBase;
+			}
+		}
+		
+		if (stats != 0) {
+			//Fold the implicit zeros of each range in, then merge the ranges
+			vector<double> total(d, 0.0);
+			stats->mean.assign(d, 0.0);
+			stats->m2.assign(d, 0.0);
+			
+			for (int c = 0; c < numChunks; ++c) {
+				parse_chunk& chunk = chunks[c];
+				for (size_t j = 0; j < d; ++j) {
+					size_t raw = j + indexBase;
+					double count = 0, mean = 0, m2 = 0;
+					if (raw < chunk.count.size()) {
+						count = chunk.count[raw];
+						mean = chunk.mean[raw];
+						m2 = chunk.m2[raw];
+					}
+					
+					merge_stats(count, mean, m2, chunk.rows - count, 0.0, 0.0);
+					merge_stats(total[j], stats->mean[j], stats->m2[j], count, mean, m2);
+				}
+			}
+		}
+		
+		csr = csr_data();
+		csr.n = n;
+		csr.d = d;
+		csr.nnz = nnz;
+		csr.labels = labels;
+		csr.indptr = indptr;
+		csr.indices = indices;
+		csr.values = values;
+		csr.storage = storage;
+		
+		return CORRECT;
+	}
+	
+	bool is_binary_model(const char* filename){
+		return has_magic(filename, modelMagic);
+	}
+	
+	int write_binary_model(svm_model const& myModel, const char* filename){
+		binary_model_header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, modelMagic, sizeof(modelMagic));
+		header.version = modelVersion;
+		header.kernelType = myModel.kernelType;
+		header.numClasses = myModel.orderSeen.size();
+		header.pegasos = myModel.pegasos ? 1 : 0;
+		header.sparse = myModel.xSparse.cols() > 0 ? 1 : 0;
+		header.plattScale = myModel.plattScale;
+		
+		//Only the parameters of the kernel are set, as in the text format
+		int kernel = myModel.kernelType;
+		header.gamma = kernel == RBF || kernel == POLYNOMIAL || kernel == SIGMOID ? myModel.gamma : 0;
+		header.coef = kernel == POLYNOMIAL || kernel == SIGMOID ? myModel.coef : 0;
+		header.degree = kernel == POLYNOMIAL ? myModel.degree : 0;
+		
+		header.numSV = myModel.numSupportVectors();
+		header.d = std::max(0, myModel.numFeatures);
+		header.nnz = header.sparse ? myModel.xSparse.nnz() : 0;
+		header.numOffsets = myModel.offsets.size();
+		header.numPlatt = myModel.plattScaleCoefs.size();
+		header.numMeans = myModel.means.size();
+		header.numStd = myModel.standardDeviations.size();
+		uint64_t fileSize = layout_binary_model(header);
+		
+		uint64_t betaCols = std::max<uint64_t>(1, header.numSV);
+		uint64_t betaRows = std::max<uint64_t>(1, model_pairs(header));
+		if (myModel.classStart.size() != header.numClasses + 1 || myModel.betas.cols() != betaCols || myModel.betas.rows() != betaRows ||
+			(header.numSV > 0 && (myModel.xSNorm.cols() != header.numSV || (!header.sparse && myModel.xS.rows() != header.d)))) {
+			cerr << "Model is incomplete, not writing " << filename << endl;
+			return INVALID_INPUT;
+		}
+		
+		//Write next to the target and rename over it, a model that is
+		//already mapped stays intact
+		string tempFile = string(filename) + ".tmp";
+		int fd = open(tempFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			cerr << "Could not open " << tempFile << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		if (ftruncate(fd, fileSize) != 0) {
+			cerr << "Could not allocate " << fileSize << " bytes for " << tempFile << endl;
+			close(fd);
+			unlink(tempFile.c_str());
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		char* out = static_cast<char*>(mmap(0, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+		close(fd);
+		
+		if (out == MAP_FAILED) {
+			cerr << "Could not map " << tempFile << endl;
+			unlink(tempFile.c_str());
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		memcpy(out, &header, sizeof(header));
+		int32_t* labels = reinterpret_cast<int32_t*>(out + header.labelOffset);
+		int32_t* classStart = reinterpret_cast<int32_t*>(out + header.classStartOffset);
+		for (uint32_t i = 0; i < header.numClasses; ++i) {
+			labels[i] = myModel.orderSeen[i];
+		}
+		for (uint32_t i = 0; i <= header.numClasses; ++i) {
+			classStart[i] = myModel.classStart[i];
+		}
+		
+		double* offsets = reinterpret_cast<double*>(out + header.offsetOffset);
+		double* platt = reinterpret_cast<double*>(out + header.plattOffset);
+		std::copy(myModel.offsets.begin(), myModel.offsets.end(), offsets);
+		for (uint64_t i = 0; i < header.numPlatt; ++i) {
+			platt[2 * i] = myModel.plattScaleCoefs[i].first;
+			platt[2 * i + 1] = myModel.plattScaleCoefs[i].second;
+		}
+		
+		std::copy(myModel.means.begin(), myModel.means.end(), reinterpret_cast<double*>(out + header.meanOffset));
+		std::copy(myModel.standardDeviations.begin(), myModel.standardDeviations.end(), reinterpret_cast<double*>(out + header.stdOffset));
+		
+		//Matrices may be views with a larger stride, copy column by column
+		float* betas = reinterpret_cast<float*>(out + header.betaOffset);
+		for (uint64_t sv = 0; sv < betaCols; ++sv) {
+			const float* col = myModel.betas.data() + sv * myModel.betas.mRows();
+			std::copy(col, col + betaRows, betas + sv * betaRows);
+		}
+		
+		float* norms = reinterpret_cast<float*>(out + header.normOffset);
+		for (uint64_t sv = 0; sv < header.numSV; ++sv) {
+			norms[sv] = myModel.xSNorm.data()[sv * myModel.xSNorm.mRows()];
+		}
+		
+		if (header.sparse) {
+			const size_t* ptr = myModel.xSparse.colPtr();
+			std::copy(ptr, ptr + header.numSV + 1, reinterpret_cast<uint64_t*>(out + header.indptrOffset));
+			std::copy(myModel.xSparse.rowInd(), myModel.xSparse.rowInd() + header.nnz, reinterpret_cast<int32_t*>(out + header.indexOffset));
+			std::copy(myModel.xSparse.values(), myModel.xSparse.values() + header.nnz, reinterpret_cast<float*>(out + header.valueOffset));
+		} else {
+			float* dense = reinterpret_cast<float*>(out + header.dataOffset);
+			for (uint64_t sv = 0; sv < header.numSV; ++sv) {
+				const float* col = myModel.xS.data() + sv * myModel.xS.mRows();
+				std::copy(col, col + header.d, dense + sv * header.d);
+			}
+		}
+		
+		munmap(out, fileSize);
+		
+		if (rename(tempFile.c_str(), filename) != 0) {
+			cerr << "Could not move " << tempFile << " to " << filename << endl;
+			unlink(tempFile.c_str());
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		return CORRECT;
+	}
+	
+	int load_binary_model(const char* filename, svm_model& myModel){
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) {
+			cerr << "Could not open " << filename << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(binary_model_header)) {
+			cerr << filename << " is not a binary model" << endl;
+			close(fd);
+			return INVALID_INPUT;
+		}
+		
+		//Shared read-only mapping, every process using the model reads the
+		//same page cache
+		size_t fileSize = fileStat.st_size;
+		void* addr = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		
+		if (addr == MAP_FAILED) {
+			cerr << "Could not map " << filename << endl;
+			return UNOPENED_FILE_ERROR;
+		}
+		
+		shared_ptr<void> mapping(addr, unmap_file(fileSize));
+		const char* base = static_cast<const char*>(addr);
+		
+		binary_model_header header;
+		memcpy(&header, base, sizeof(header));
+		
+		binary_model_header expected = header;
+		uint64_t expectedSize = layout_binary_model(expected);
+		
+		if (memcmp(header.magic, modelMagic, sizeof(modelMagic)) != 0 || header.version != modelVersion ||
+			expectedSize > fileSize || memcmp(&header, &expected, sizeof(header)) != 0) {
+			cerr << filename << " is not a valid binary model" << endl;
+			return INVALID_INPUT;
+		}
+		
+		//Check the indexing arrays, the rest is used as is
+		const int32_t* labels = reinterpret_cast<const int32_t*>(base + header.labelOffset);
+		const int32_t* classStart = reinterpret_cast<const int32_t*>(base + header.classStartOffset);
+		const uint64_t* indptr = reinterpret_cast<const uint64_t*>(base + header.indptrOffset);
+		bool valid = classStart[0] == 0 && classStart[header.numClasses] == (int64_t)header.numSV;
+		for (uint32_t i = 0; i < header.numClasses && valid; ++i) {
+			valid = classStart[i] <= classStart[i + 1];
+		}
+		
+		if (header.sparse) {
+			valid = valid && indptr[0] == 0 && indptr[header.numSV] == header.nnz;
+			for (uint64_t sv = 0; sv < header.numSV && valid; ++sv) {
+				valid = indptr[sv] <= indptr[sv + 1];
+			}
+		}
+		
+		if (!valid) {
+			cerr << filename << " is not a valid binary model" << endl;
+			return INVALID_INPUT;
+		}
+		
+		myModel.pegasos = header.pegasos != 0;
+		myModel.kernelType = header.kernelType;
+		myModel.numFeatures = header.d;
+		myModel.gamma = header.gamma;
+		myModel.coef = header.coef;
+		myModel.degree = header.degree;
+		myModel.plattScale = header.plattScale;
+		myModel.orderSeen.assign(labels, labels + header.numClasses);
+		myModel.classStart.assign(classStart, classStart + header.numClasses + 1);
+		
+		const double* offsets = reinterpret_cast<const double*>(base + header.offsetOffset);
+		const double* platt = reinterpret_cast<const double*>(base + header.plattOffset);
+		const double* means = reinterpret_cast<const double*>(base + header.meanOffset);
+		const double* deviations = reinterpret_cast<const double*>(base + header.stdOffset);
+		myModel.offsets.assign(offsets, offsets + header.numOffsets);
+		myModel.plattScaleCoefs.clear();
+		for (uint64_t i = 0; i < header.numPlatt; ++i) {
+			myModel.plattScaleCoefs.push_back(pair<double, double>(platt[2 * i], platt[2 * i + 1]));
+		}
+		myModel.means.assign(means, means + header.numMeans);
+		myModel.standardDeviations.assign(deviations, deviations + header.numStd);
+		
+		//The matrices point into the mapping, which lives as long as any of them
+		float* betas = const_cast<float*>(reinterpret_cast<const float*>(base + header.betaOffset));
+		float* norms = const_cast<float*>(reinterpret_cast<const float*>(base + header.normOffset));
+		myModel.betas = LaspMatrix<float>::borrow(std::max<uint64_t>(1, header.numSV), std::max<uint64_t>(1, model_pairs(header)), betas, mapping);
+		myModel.xS = LaspMatrix<float>();
+		myModel.xSparse = LaspSparseMatrix<float>();
+		myModel.xSNorm = LaspMatrix<float>();
+		
+		if (header.numSV > 0) {
+			myModel.xSNorm = LaspMatrix<float>::borrow(header.numSV, 1, norms, mapping);
+		}
+		
+		if (header.numSV > 0 && header.sparse) {
+			const int* indices = reinterpret_cast<const int32_t*>(base + header.indexOffset);
+			const float* values = reinterpret_cast<const float*>(base + header.valueOffset);
+			
+			if (sizeof(size_t) == sizeof(uint64_t)) {
+				myModel.xSparse = LaspSparseMatrix<float>::borrow(header.numSV, header.d, reinterpret_cast<const size_t*>(indptr), indices, values, mapping);
+			} else {
+				vector<size_t> ptr(indptr, indptr + header.numSV + 1);
+				myModel.xSparse = LaspSparseMatrix<float>(header.numSV, header.d, &ptr[0], indices, values);
+			}
+		} else if (header.numSV > 0) {
+			float* dense = const_cast<float*>(reinterpret_cast<const float*>(base + header.dataOffset));
+			myModel.xS = LaspMatrix<float>::borrow(header.numSV, header.d, dense, mapping);
+		}
+		
+		return CORRECT;
+	}
+}
@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LASP_FILEIO_BINARY_H
+#define LASP_FILEIO_BINARY_H
+
+#include "svm.h"
+#include "lasp_matrix.h"
+#include <stdint.h>
+
+namespace lasp
+{
+	//Binary dataset files start with this header, followed by sections
+	//aligned to 64 bytes at the given offsets:
+	//	labels:  n doubles
+	//	dense:   d x n doubles, column major (one column per point, as in LaspMatrix)
+	//	sparse:  CSR, n+1 row offsets (int64), nnz feature indices (int32,
+	//	         zero based) and nnz doubles
+	struct binary_data_header {
+		char magic[8];
+		uint32_t version;
+		uint32_t sparse;
+		uint64_t n, d, nnz;
+		uint64_t labelOffset, dataOffset, indptrOffset, indexOffset, valueOffset;
+	};
+	
+	//Compressed sparse row data, one row per point. The arrays either point
+	//into a memory mapped file or into memory held by storage.
+	struct csr_data {
+		size_t n, d, nnz;
+		const double* labels;
+		const int64_t* indptr;
+		const int32_t* indices;
+		const double* values;
+		shared_ptr<void> storage;
+		
+		csr_data(): n(0), d(0), nnz(0), labels(0), indptr(0), indices(0), values(0) {}
+	};
+	
+	//A loaded binary dataset. For dense files X and Y point straight into
+	//the mapped file, for sparse files Y and csr do.
+	struct binary_data {
+		bool sparse;
+		int n, d;
+		LaspMatrix<double> X, Y;
+		csr_data csr;
+	};
+	
+	//Binary model files start with this header, followed by sections
+	//aligned to 64 bytes at the given offsets:
+	//	labels:     numClasses int32 (orderSeen), then numClasses+1 int32 classStart
+	//	offsets:    numOffsets doubles (one per class pair), then numPlatt A,B pairs
+	//	means, standard deviations: numMeans and numStd doubles
+	//	betas:      numPairs x numSV floats, column major (one column per support vector)
+	//	norms:      numSV floats, squared norm of each support vector
+	//	dense:      d x numSV floats, column major
+	//	sparse:     numSV+1 column offsets (uint64), nnz feature indices (int32,
+	//	            zero based) and nnz floats
+	//The float sections are laid out like svm_model's matrices, so a mapped
+	//model uses them in place.
+	struct binary_model_header {
+		char magic[8];
+		uint32_t version;
+		int32_t kernelType;
+		uint32_t numClasses;
+		uint32_t pegasos, sparse, plattScale;
+		double gamma, coef, degree;
+		uint64_t numSV, d, nnz, numOffsets, numPlatt, numMeans, numStd;
+		uint64_t labelOffset, classStartOffset, offsetOffset, plattOffset, meanOffset, stdOffset;
+		uint64_t betaOffset, normOffset, dataOffset, indptrOffset, indexOffset, valueOffset;
+	};
+	
+	//Per feature mean and sum of squared deviations over all points, zeros
+	//included, as gathered while parsing
+	struct feature_stats {
+		vector<double> mean, m2;
+	};
+	
+	//Parse a LIBSVM formatted text file straight into csr arrays. The file
+	//is split into byte ranges that are parsed in parallel, feature
+	//statistics are gathered in the same pass when stats is given.
+	int load_LIBSVM_csr(const char* filename, csr_data& csr, feature_stats* stats = 0);
+	
+	//Check whether a file is in the binary dataset format
+	bool is_binary_data(const char* filename);
+	
+	//Convert a LIBSVM formatted text file into a binary dataset file
+	int convert_LIBSVM_to_binary(const char* textFile, const char* binaryFile, bool sparse);
+	
+	//Map a binary dataset file into memory, nothing is copied
+	int load_binary_data(const char* filename, binary_data& data);
+	
+	//Fill a dense d x n matrix from csr data
+	int csr_to_dense(csr_data const& csr, LaspMatrix<double>& X);
+	
+	//Build the map based sparse representation (with means and standard
+	//deviations) from csr data, stats are computed when not given
+	int csr_to_sparse_data(csr_data const& csr, svm_sparse_data& myData, feature_stats const* stats = 0);
+	
+	//Check whether a file is in the binary model format
+	bool is_binary_model(const char* filename);
+	
+	//Write a model in the binary model format. The file is written next to
+	//filename and renamed over it, so processes that have the old model
+	//mapped keep using it.
+	int write_binary_model(svm_model const& myModel, const char* filename);
+	
+	//Map a binary model file read-only and shared. The support vectors,
+	//norms and betas of myModel point into the mapping, nothing is parsed
+	//or copied, and processes mapping the same file share its pages.
+	int load_binary_model(const char* filename, svm_model& myModel);
+}
+
+#endif
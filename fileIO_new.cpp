@@ -1,4 +1,5 @@
 #include "fileIO_new.h"
+#include "fileIO_binary.h"
 
 
 namespace lasp{
@@ -24,8 +25,35 @@ vector<string> split_on_delim(const string s, char delim){
   return subStrings;
 }
 
+  //map a binary dataset, dense files are used in place, sparse files are expanded
+  static int load_binary_LIBSVM(const char* filename, lasp::LaspMatrix<double>& X, lasp::LaspMatrix<double>& Y, int& n, int& d){
+    binary_data data;
+    int error = load_binary_data(filename, data);
+    if (error != CORRECT){
+      cout << "ERROR: load_LIBSVM could not load the binary file: " << filename << endl;
+      return error;
+    }
+
+    n = data.n;
+    d = data.d;
+    Y = data.Y;
+
+    if (data.sparse){
+      csr_to_dense(data.csr, X);
+    }
+    else{
+      X = data.X;
+    }
+
+    return 0;
+  }
+
   int load_LIBSVM(const char* filename, lasp::LaspMatrix<double>& X, lasp::LaspMatrix<double>& Y, int& n, int& d, bool dimUnknown){
   
+  if (is_binary_data(filename)){
+    return load_binary_LIBSVM(filename, X, Y, n, d);
+  }
+
   ifstream inputFile(filename);
   if (!inputFile.is_open()){
     cout << "ERROR: load_LIBSVM could not open the file: " << filename << endl;
@@ -111,6 +139,18 @@ vector<string> split_on_delim(const string s, char delim){
 } 
   int load_LIBSVM(const char* filename, lasp::LaspMatrix<double>& X, lasp::LaspMatrix<int>& Y, int& n, int& d, bool dimUnknown){
   
+  if (is_binary_data(filename)){
+    lasp::LaspMatrix<double> labels;
+    int error = load_binary_LIBSVM(filename, X, labels, n, d);
+    if (error == 0){
+      Y = lasp::LaspMatrix<int>(n,1,0);
+      for (int i = 0; i < n; ++i){
+        Y(i,0) = static_cast<int>(labels(i,0));
+      }
+    }
+    return error;
+  }
+
   ifstream inputFile(filename);
   if (!inputFile.is_open()){
     cout << "ERROR: load_LIBSVM could not open the file: " << filename << endl;
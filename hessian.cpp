@@ -28,7 +28,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "hessian.h"
 #include "kernels.h"
 
-void lasp::update_hess(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<double> K, vector<int>* erv, LaspMatrix<double> y, vector<int> &S, LaspMatrix<double>& x, LaspMatrix<double>& xNorm){
+template<class M>
+void lasp::update_hess(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<double> K, vector<int>* erv, LaspMatrix<double> y, vector<int> &S, M& x, LaspMatrix<double>& xNorm){
 	bool gpu = p.options.usegpu;
 	
 	
@@ -68,6 +69,12 @@ void lasp::update_hess(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<doubl
 			LaspMatrix<double> h_kernel(h.cols(), h.rows(), 0.0);
 			
 			int numChunks = nerv > p.options.set_size ? (nerv + p.options.set_size - 1) / p.options.set_size : min(nerv, 10);
+			
+			//Under a memory budget, chunks of the erv kernel get an eighth of it
+			if (p.options.memBudget > 0) {
+				int maxChunk = budget_items(p.options.memBudget / 8, (size_t)(d + 1) * sizeof(double), nerv);
+				numChunks = (nerv + maxChunk - 1) / maxChunk;
+			}
 			int chunkStart = 0;
 			LaspMatrix<double> Kcpy(nerv / numChunks, d+1);
 			
@@ -75,7 +82,8 @@ void lasp::update_hess(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<doubl
 				Kcpy.transferToDevice();
 			}
 			
-			LaspMatrix<double> xS, xSNorm, xErv, xErvNorm;
+			M xS, xErv;
+			LaspMatrix<double> xSNorm, xErvNorm;
 			x.gather(xS, S);
 			xNorm.gather(xSNorm, S);
 			
@@ -206,3 +214,95 @@ void lasp::update_hess(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<doubl
 	HESS_new.add(mean);
 	
 }
+
+bool lasp::chol_append(LaspMatrix<double>& L, LaspMatrix<double> HESS, int d){
+	int d0 = L.rows();
+	
+	if (d0 > d || HESS.rows() < d || HESS.device()) {
+		return false;
+	} else if (d0 == d) {
+		return true;
+	}
+	
+	//Grow into the capacity of HESS, so later appends do not copy L
+	if (L.mCols() < d || L.mRows() < d) {
+		size_t capacity = max((size_t)d, HESS.mRows());
+		LaspMatrix<double> grown(d, d, 0.0, capacity, capacity, false, false);
+		
+		for (int j = 0; j < d0; ++j) {
+			memcpy(grown.data() + j * capacity + j, L.data() + j * L.mRows() + j, (d0 - j) * sizeof(double));
+		}
+		
+		L = grown;
+	} else {
+		L.resize(d, d);
+	}
+	
+	int ld = L.mRows();
+	int k = d - d0;
+	double* l = L.data();
+	
+	//New rows of HESS, lower triangle only
+	for (int j = 0; j < d; ++j) {
+		for (int i = max(j, d0); i < d; ++i) {
+			l[(size_t)j * ld + i] = HESS(j, i);
+		}
+	}
+	
+	//L21 = H21 L11^-T, L22 = chol(H22 - L21 L21')
+	double* l21 = l + d0;
+	double* l22 = l + (size_t)d0 * ld + d0;
+	
+	if (d0 > 0) {
+		host_dtrsm(true, false, true, k, d0, 1.0, l, ld, l21, ld);
+		host_dsyrk(false, false, k, d0, -1.0, l21, ld, 1.0, l22, ld);
+	}
+	
+	return host_dpotrf(false, k, l22, ld) == 0;
+}
+
+bool lasp::chol_update(LaspMatrix<double>& L, LaspMatrix<double> V, double scale){
+	if (L.device() || V.device()) {
+		return false;
+	}
+	
+	int d = L.rows();
+	int ld = L.mRows();
+	double* l = L.data();
+	
+	double sign = scale < 0 ? -1.0 : 1.0;
+	double root = std::sqrt(std::abs(scale));
+	vector<double> v(d);
+	
+	//One rank one update per row, O(d^2) each
+	for (int r = 0; r < V.rows(); ++r) {
+		for (int i = 0; i < d; ++i) {
+			v[i] = root * V(i, r);
+		}
+		
+		for (int j = 0; j < d; ++j) {
+			double* lj = l + (size_t)j * ld;
+			double diag = lj[j];
+			double diagSq = diag * diag + sign * v[j] * v[j];
+			
+			if (!(diagSq > 0)) {
+				return false;
+			}
+			
+			double newDiag = std::sqrt(diagSq);
+			double c = newDiag / diag;
+			double s = v[j] / diag;
+			lj[j] = newDiag;
+			
+			for (int i = j + 1; i < d; ++i) {
+				lj[i] = (lj[i] + sign * s * v[i]) / c;
+				v[i] = c * v[i] - s * lj[i];
+			}
+		}
+	}
+	
+	return true;
+}
+
+template void lasp::update_hess<lasp::LaspMatrix<double> >(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<double> K, vector<int>* erv, LaspMatrix<double> y, vector<int> &S, LaspMatrix<double>& x, LaspMatrix<double>& xNorm);
+template void lasp::update_hess<lasp::LaspSparseMatrix<double> >(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<double> K, vector<int>* erv, LaspMatrix<double> y, vector<int> &S, LaspSparseMatrix<double>& x, LaspMatrix<double>& xNorm);
@@ -33,7 +33,20 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace lasp
 {
-  void update_hess(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<double> K, vector<int>* erv, LaspMatrix<double> y, vector<int> &S, LaspMatrix<double>& x, LaspMatrix<double>& xNorm);
+  //M is the type of the training data, LaspMatrix<double> or LaspSparseMatrix<double>
+  template<class M>
+  void update_hess(svm_problem& p, LaspMatrix<double> HESS, LaspMatrix<double> K, vector<int>* erv, LaspMatrix<double> y, vector<int> &S, M& x, LaspMatrix<double>& xNorm);
+  
+  //The Hessian only grows by bordering and changes by low rank erv terms,
+  //so its Cholesky factor L (lower triangle) is maintained instead of
+  //refactored every Newton step. Both return false if the result is not
+  //positive definite, L must then be rebuilt from scratch.
+  
+  //Extends L to the leading d x d block of HESS
+  bool chol_append(LaspMatrix<double>& L, LaspMatrix<double> HESS, int d);
+  
+  //L L' += scale * v v' for every row v of V, scale < 0 downdates
+  bool chol_update(LaspMatrix<double>& L, LaspMatrix<double> V, double scale);
 
 }
 #endif
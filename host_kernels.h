@@ -0,0 +1,180 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef LASP_HOST_KERNELS_H
+#define LASP_HOST_KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+#include "options.h"
+
+namespace lasp {
+	
+	//exp(x) by rounding x/ln(2) to n with the 1.5*2^52 shift, a degree 12
+	//Taylor polynomial on the remainder and 2^n built from the exponent
+	//bits. Within a couple of ulp of std::exp, arguments below -708 give 0
+	//and above 709 infinity (infinite or NaN arguments are not handled).
+	//Free of calls and branches, so loops over it vectorize.
+	inline double host_exp(double x){
+		const double shifter = 6755399441055744.0;
+		const double log2e = 1.4426950408889634;
+		const double ln2Hi = 6.93145751953125e-1;
+		const double ln2Lo = 1.42860682030941723212e-6;
+		
+		double t = x * log2e + shifter;
+		double n = t - shifter;
+		double r = (x - n * ln2Hi) - n * ln2Lo;
+		
+		double p = 1.0 / 479001600.0;
+		p = p * r + 1.0 / 39916800.0;
+		p = p * r + 1.0 / 3628800.0;
+		p = p * r + 1.0 / 362880.0;
+		p = p * r + 1.0 / 40320.0;
+		p = p * r + 1.0 / 5040.0;
+		p = p * r + 1.0 / 720.0;
+		p = p * r + 1.0 / 120.0;
+		p = p * r + 1.0 / 24.0;
+		p = p * r + 1.0 / 6.0;
+		p = p * r + 0.5;
+		p = p * r + 1.0;
+		p = p * r + 1.0;
+		
+		//The low bits of t hold n, move n + bias into the exponent field.
+		//Out of range arguments are selected on the bits, selecting on
+		//doubles gets turned into branches and the loop will not vectorize
+		const double inf = std::numeric_limits<double>::infinity();
+		uint64_t bits, infBits;
+		memcpy(&infBits, &inf, sizeof(infBits));
+		memcpy(&bits, &t, sizeof(bits));
+		bits = (bits + 1023) << 52;
+		bits = x < -708.0 ? 0 : bits;
+		bits = x > 709.0 ? infBits : bits;
+		double scale;
+		memcpy(&scale, &bits, sizeof(scale));
+		
+		return p * scale;
+	}
+	
+	//Single precision version of the above, degree 7 polynomial, 0 below
+	//-87 and infinity above 88
+	inline float host_exp(float x){
+		const float shifter = 12582912.0f;
+		const float log2e = 1.44269504f;
+		const float ln2Hi = 0.693359375f;
+		const float ln2Lo = -2.12194440e-4f;
+		
+		float t = x * log2e + shifter;
+		float n = t - shifter;
+		float r = (x - n * ln2Hi) - n * ln2Lo;
+		
+		float p = 1.0f / 5040.0f;
+		p = p * r + 1.0f / 720.0f;
+		p = p * r + 1.0f / 120.0f;
+		p = p * r + 1.0f / 24.0f;
+		p = p * r + 1.0f / 6.0f;
+		p = p * r + 0.5f;
+		p = p * r + 1.0f;
+		p = p * r + 1.0f;
+		
+		const float inf = std::numeric_limits<float>::infinity();
+		uint32_t bits, infBits;
+		memcpy(&infBits, &inf, sizeof(infBits));
+		memcpy(&bits, &t, sizeof(bits));
+		bits = (bits + 127) << 23;
+		bits = x < -87.0f ? 0 : bits;
+		bits = x > 88.0f ? infBits : bits;
+		float scale;
+		memcpy(&scale, &bits, sizeof(scale));
+		
+		return p * scale;
+	}
+	
+	//tanh from a single exp of 2|x|, exact to within an ulp of 1
+	template<class T>
+	inline T host_tanh(T x){
+		T ax = x < 0 ? -x : x;
+		T value = 1 - 2 / (host_exp(2 * ax) + 1);
+		return x < 0 ? -value : value;
+	}
+	
+	//Apply a dot-product kernel to one column segment of X1'X2 in place.
+	//rowNorms holds the squared norms of the X1 points in the segment and
+	//colNorm the squared norm of the X2 point, both only read by RBF and
+	//SQDIST. Integer polynomial degrees use repeated multiplication so the
+	//loop stays vectorized.
+	template<class T>
+	void host_kernel_column(int kernel, T* col, int len, const T* rowNorms, size_t normStride, T colNorm, T gamma, T coef, T degree){
+		switch (kernel) {
+			case RBF:
+#pragma omp simd
+				for (int i = 0; i < len; ++i) {
+					col[i] = host_exp(-gamma * (rowNorms[i * normStride] + colNorm - 2 * col[i]));
+				}
+				break;
+			case SQDIST:
+#pragma omp simd
+				for (int i = 0; i < len; ++i) {
+					col[i] = rowNorms[i * normStride] + colNorm - 2 * col[i];
+				}
+				break;
+			case SIGMOID:
+#pragma omp simd
+				for (int i = 0; i < len; ++i) {
+					col[i] = host_tanh(gamma * col[i] + coef);
+				}
+				break;
+			case POLYNOMIAL: {
+				int intDegree = static_cast<int>(degree);
+				if (degree == static_cast<T>(intDegree) && intDegree >= 0 && intDegree <= 16) {
+#pragma omp simd
+					for (int i = 0; i < len; ++i) {
+						T base = gamma * col[i] + coef;
+						T value = 1;
+						for (int k = 0; k < intDegree; ++k) {
+							value *= base;
+						}
+						col[i] = value;
+					}
+				} else {
+					for (int i = 0; i < len; ++i) {
+						col[i] = std::pow(gamma * col[i] + coef, degree);
+					}
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	
+}
+
+#endif
@@ -0,0 +1,367 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "host_pool.h"
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace lasp {
+	
+	static const size_t poolAlignment = 64;
+	
+	HostPool::HostPool(): live_(0), peak_(0), cached_(0), cacheLimit_((size_t)1 << 30), hits_(0), misses_(0), phasePeak_(0), budget_(0) {}
+	
+	HostPool& HostPool::instance(){
+		//Never destroyed, matrices with static lifetime may release late
+		static HostPool* pool = new HostPool();
+		return *pool;
+	}
+	
+	size_t HostPool::size_class(size_t bytes){
+		if (bytes <= poolAlignment) {
+			return poolAlignment;
+		}
+		
+		size_t power = poolAlignment;
+		while (power * 2 < bytes) {
+			power *= 2;
+		}
+		
+		size_t step = std::max(power / 4, poolAlignment);
+		return (bytes + step - 1) / step * step;
+	}
+	
+	void* HostPool::allocate_block(size_t bytes){
+		void* ptr = 0;
+#ifdef _WIN32
+		ptr = _aligned_malloc(bytes, poolAlignment);
+#else
+		if (posix_memalign(&ptr, poolAlignment, bytes) != 0) {
+			ptr = 0;
+		}
+#endif
+		return ptr;
+	}
+	
+	void HostPool::free_block(void* ptr){
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+	
+	void* HostPool::allocate(size_t bytes){
+		size_t blockBytes = size_class(bytes);
+		void* ptr = 0;
+		
+#pragma omp critical(lasp_host_pool)
+		{
+			std::map<size_t, std::vector<void*> >::iterator iter = freeBlocks_.find(blockBytes);
+			if (iter != freeBlocks_.end() && !iter->second.empty()) {
+				ptr = iter->second.back();
+				iter->second.pop_back();
+				cached_ -= blockBytes;
+				hits_++;
+			} else {
+				misses_++;
+			}
+		}
+		
+		if (ptr == 0) {
+			ptr = allocate_block(blockBytes);
+			
+			//Cached blocks of other sizes may be what is in the way
+			if (ptr == 0) {
+				trim();
+				ptr = allocate_block(blockBytes);
+			}
+			
+			if (ptr == 0) {
+				throw std::bad_alloc();
+			}
+		}
+		
+#pragma omp critical(lasp_host_pool)
+		{
+			blockSizes_[ptr] = blockBytes;
+			live_ += blockBytes;
+			peak_ = std::max(peak_, live_);
+			phasePeak_ = std::max(phasePeak_, live_);
+		}
+		
+		return ptr;
+	}
+	
+	bool HostPool::release(void* ptr){
+		if (ptr == 0) {
+			return true;
+		}
+		
+		bool found = false, keep = false;
+		size_t blockBytes = 0;
+		
+#pragma omp critical(lasp_host_pool)
+		{
+			std::map<void*, size_t>::iterator iter = blockSizes_.find(ptr);
+			if (iter != blockSizes_.end()) {
+				found = true;
+				blockBytes = iter->second;
+				blockSizes_.erase(iter);
+				live_ -= blockBytes;
+				
+				if (cached_ + blockBytes <= cacheLimit_) {
+					freeBlocks_[blockBytes].push_back(ptr);
+					cached_ += blockBytes;
+					keep = true;
+				}
+			}
+		}
+		
+		if (found && !keep) {
+			free_block(ptr);
+		}
+		
+		return found;
+	}
+	
+	void HostPool::trim(){
+		std::vector<void*> blocks;
+		
+#pragma omp critical(lasp_host_pool)
+		{
+			for (std::map<size_t, std::vector<void*> >::iterator iter = freeBlocks_.begin(); iter != freeBlocks_.end(); ++iter) {
+				blocks.insert(blocks.end(), iter->second.begin(), iter->second.end());
+			}
+			
+			freeBlocks_.clear();
+			cached_ = 0;
+		}
+		
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			free_block(blocks[i]);
+		}
+	}
+	
+	void HostPool::setCacheLimit(size_t bytes){
+#pragma omp critical(lasp_host_pool)
+		{
+			cacheLimit_ = bytes;
+		}
+		
+		if (cachedBytes() > bytes) {
+			trim();
+		}
+	}
+	
+	size_t HostPool::liveBytes(){
+		size_t result;
+#pragma omp critical(lasp_host_pool)
+		result = live_;
+		return result;
+	}
+	
+	size_t HostPool::peakBytes(){
+		size_t result;
+#pragma omp critical(lasp_host_pool)
+		result = peak_;
+		return result;
+	}
+	
+	size_t HostPool::cachedBytes(){
+		size_t result;
+#pragma omp critical(lasp_host_pool)
+		result = cached_;
+		return result;
+	}
+	
+	void HostPool::resetPeak(){
+#pragma omp critical(lasp_host_pool)
+		peak_ = live_;
+	}
+	
+	void HostPool::setBudget(size_t bytes){
+#pragma omp critical(lasp_host_pool)
+		budget_ = bytes;
+	}
+	
+	void HostPool::beginPhase(const char* name){
+#pragma omp critical(lasp_host_pool)
+		{
+			if (!phase_.empty()) {
+				size_t& phasePeak = phasePeaks_[phase_];
+				phasePeak = std::max(phasePeak, phasePeak_);
+			}
+			
+			phase_ = name;
+			phasePeak_ = live_;
+		}
+	}
+	
+	void HostPool::reportPhases(std::ostream& out){
+		std::map<std::string, size_t> peaks;
+		size_t budget;
+		
+#pragma omp critical(lasp_host_pool)
+		{
+			peaks = phasePeaks_;
+			if (!phase_.empty()) {
+				peaks[phase_] = std::max(peaks[phase_], phasePeak_);
+			}
+			budget = budget_;
+		}
+		
+		const double mb = 1024.0 * 1024.0;
+		std::ios::fmtflags flags = out.flags();
+		
+		out << std::fixed << std::setprecision(1);
+		for (std::map<std::string, size_t>::iterator iter = peaks.begin(); iter != peaks.end(); ++iter) {
+			out << "Host memory peak (" << iter->first << "): " << iter->second / mb << "MB";
+			if (budget > 0) {
+				out << " of " << budget / mb << "MB budget" << (iter->second > budget ? ", OVER BUDGET" : "");
+			}
+			out << std::endl;
+		}
+		
+		out.flags(flags);
+	}
+	
+	void HostPool::report(std::ostream& out, const char* label){
+		size_t live, peak, cached, hits, misses;
+		
+#pragma omp critical(lasp_host_pool)
+		{
+			live = live_;
+			peak = peak_;
+			cached = cached_;
+			hits = hits_;
+			misses = misses_;
+		}
+		
+		const double mb = 1024.0 * 1024.0;
+		std::ios::fmtflags flags = out.flags();
+		
+		out << "Host memory";
+		if (label != 0) {
+			out << " (" << label << ")";
+		}
+		out << std::fixed << std::setprecision(1) << ": live " << live / mb << "MB, peak " << peak / mb << "MB, cached " << cached / mb << "MB, ";
+		out << hits << " of " << hits + misses << " allocations reused" << std::endl;
+		
+		out.flags(flags);
+	}
+	
+#ifndef _WIN32
+	//Unmaps a scratch file once the last matrix using it is gone
+	struct unmap_scratch {
+		size_t size;
+		unmap_scratch(size_t size_): size(size_) {}
+		void operator()(void* ptr) const {
+			munmap(ptr, size);
+		}
+	};
+	
+	//Page aligned range covering [ptr, ptr + bytes)
+	static void page_range(void* ptr, size_t bytes, char*& start, size_t& length){
+		size_t page = sysconf(_SC_PAGESIZE);
+		uintptr_t begin = reinterpret_cast<uintptr_t>(ptr) / page * page;
+		uintptr_t end = reinterpret_cast<uintptr_t>(ptr) + bytes;
+		start = reinterpret_cast<char*>(begin);
+		length = end - begin;
+	}
+	
+	size_t available_memory(){
+		long pages = sysconf(_SC_AVPHYS_PAGES);
+		long page = sysconf(_SC_PAGESIZE);
+		return pages > 0 && page > 0 ? (size_t)pages * (size_t)page : 0;
+	}
+	
+	std::shared_ptr<void> map_scratch_file(size_t bytes, const std::string& dir){
+		std::string path = (dir.empty() ? std::string(".") : dir) + "/wusvm_kernel_XXXXXX";
+		std::vector<char> name(path.begin(), path.end());
+		name.push_back('\0');
+		
+		int fd = mkstemp(&name[0]);
+		if (fd < 0) {
+			return std::shared_ptr<void>();
+		}
+		
+		//Nobody else needs to see the file, it lives as long as the mapping
+		unlink(&name[0]);
+		
+		void* addr = MAP_FAILED;
+		if (ftruncate(fd, bytes) == 0) {
+			addr = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		close(fd);
+		
+		if (addr == MAP_FAILED) {
+			return std::shared_ptr<void>();
+		}
+		
+		return std::shared_ptr<void>(addr, unmap_scratch(bytes));
+	}
+	
+	void prefetch_scratch(void* ptr, size_t bytes){
+		char* start;
+		size_t length;
+		page_range(ptr, bytes, start, length);
+		madvise(start, length, MADV_WILLNEED);
+	}
+	
+	void release_scratch(void* ptr, size_t bytes){
+		//Shared file pages keep their contents, they are only unmapped
+		char* start;
+		size_t length;
+		page_range(ptr, bytes, start, length);
+		madvise(start, length, MADV_DONTNEED);
+	}
+#else
+	size_t available_memory(){
+		return 0;
+	}
+	
+	std::shared_ptr<void> map_scratch_file(size_t bytes, const std::string& dir){
+		return std::shared_ptr<void>();
+	}
+	
+	void prefetch_scratch(void* ptr, size_t bytes){}
+	void release_scratch(void* ptr, size_t bytes){}
+#endif
+}
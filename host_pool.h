@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LASP_HOST_POOL_H
+#define LASP_HOST_POOL_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+#include <ostream>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+namespace lasp {
+	
+	//Size-class pool behind LaspMatrix host memory. Blocks are 64 byte
+	//aligned and kept on a free list when released so that kernel
+	//temporaries of the same shape reuse memory instead of going back to
+	//malloc. Classes are spaced four per power of two, so at most 25% of a
+	//block is unused.
+	class HostPool {
+		std::map<size_t, std::vector<void*> > freeBlocks_;
+		std::map<void*, size_t> blockSizes_;
+		
+		size_t live_, peak_, cached_, cacheLimit_;
+		size_t hits_, misses_;
+		
+		//Peak live bytes of each named phase, and the phase running now
+		std::map<std::string, size_t> phasePeaks_;
+		std::string phase_;
+		size_t phasePeak_, budget_;
+		
+		HostPool();
+		
+		void* allocate_block(size_t bytes);
+		void free_block(void* ptr);
+		
+	public:
+		static HostPool& instance();
+		
+		//Round a request up to its size class
+		static size_t size_class(size_t bytes);
+		
+		//Throws std::bad_alloc when the system is out of memory
+		void* allocate(size_t bytes);
+		
+		//Returns false if ptr did not come from the pool
+		bool release(void* ptr);
+		
+		//Give all cached blocks back to the system
+		void trim();
+		
+		//Bytes of free blocks kept for reuse before they go back to the system
+		void setCacheLimit(size_t bytes);
+		
+		//Bytes handed out and not yet released, and the most that ever were
+		size_t liveBytes();
+		size_t peakBytes();
+		size_t cachedBytes();
+		void resetPeak();
+		
+		//Budget the phase report compares against, 0 for none
+		void setBudget(size_t bytes);
+		
+		//Charge the peak since the last call to the phase that just ended
+		//and start counting for the named one
+		void beginPhase(const char* name);
+		
+		void report(std::ostream& out, const char* label = 0);
+		void reportPhases(std::ostream& out);
+	};
+	
+	//How many items of itemBytes fit in bytes, between 1 and maxItems
+	inline int budget_items(size_t bytes, size_t itemBytes, int maxItems){
+		size_t items = itemBytes > 0 ? bytes / itemBytes : maxItems;
+		return static_cast<int>(std::max<size_t>(1, std::min<size_t>(items, std::max(maxItems, 1))));
+	}
+	
+	//Bytes of physical memory not in use right now, 0 if unknown
+	size_t available_memory();
+	
+	//Maps an unlinked scratch file of the given size in dir, for matrices
+	//that do not fit in RAM. The OS pages it, the file is gone once the
+	//last owner is. Empty on failure.
+	std::shared_ptr<void> map_scratch_file(size_t bytes, const std::string& dir);
+	
+	//Paging hints for a range of a scratch mapping: start reading it in
+	//ahead of use, or drop it from our resident set once done with it
+	void prefetch_scratch(void* ptr, size_t bytes);
+	void release_scratch(void* ptr, size_t bytes);
+}
+
+#endif
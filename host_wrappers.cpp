@@ -30,6 +30,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 extern "C"{
 	void dgemm_(char* TRANSA, char* TRANSB, int* m, int* n, int* k, double* alpha, double* a, int* lda, double* b, int* ldb, double* beta, double* c, int* ldc);
 	void sgemm_(char* TRANSA, char* TRANSB, int* m, int* n, int* k, float* alpha, float* a, int* lda, float* b, int* ldb, float* beta, float* c, int* ldc);
+	void dsyrk_(char* UPLO, char* TRANS, int* n, int* k, double* alpha, double* a, int* lda, double* beta, double* c, int* ldc);
+	void ssyrk_(char* UPLO, char* TRANS, int* n, int* k, float* alpha, float* a, int* lda, float* beta, float* c, int* ldc);
 	void dger_(int* m, int* n, double* alpha, double* x, int* incx, double* y, int* incy, double* a, int* lda);
 	void sger_(int* m, int* n, float* alpha, float* x, int* incx, float* y, int* incy, float* a, int* lda);
 	void dgesv_(int* n, int* nrhs, double* a, int* lda, int* ipiv, double* b, int* ldb, int* info);
@@ -38,6 +40,8 @@ extern "C"{
 	void spotrf_(char* UPLO, int* n, float* a, int* lda, int* info);
 	void dpotrs_(char* UPLO, int* n, int* nrhs, double* a, int* lda, double* b, int* ldb, int* info);
 	void spotrs_(char* UPLO, int* n, int* nrhs, float* a, int* lda, float* b, int* ldb, int* info);
+	void dtrsm_(char* SIDE, char* UPLO, char* TRANSA, char* DIAG, int* m, int* n, double* alpha, double* a, int* lda, double* b, int* ldb);
+	void strsm_(char* SIDE, char* UPLO, char* TRANSA, char* DIAG, int* m, int* n, float* alpha, float* a, int* lda, float* b, int* ldb);
 	void dgecon_(char* NORM, int* n, double* a, int* lda, double* aNorm, double* rcond, double* work, int* iwork, int* info);
 	void sgecon_(char* NORM, int* n, float* a, int* lda, float* aNorm, float* rcond, float* work, int* iwork, int* info);
 	double dlange_(char* NORM, int* m, int*n, double* a, int* lda, double* work);
@@ -105,6 +109,24 @@ namespace lasp{
 		return BLAS_SUCCESS;
 	}
 	
+	int host_dsyrk(bool upper, bool trans, int n, int k, double alpha, double* a, int lda, double beta, double* c, int ldc){
+		char uplo = upper ? 'u' : 'l';
+		char Atran = trans ? 't' : 'n';
+		
+		dsyrk_(&uplo, &Atran, &n, &k, &alpha, a, &lda, &beta, c, &ldc);
+		
+		return BLAS_SUCCESS;
+	}
+	
+	int host_ssyrk(bool upper, bool trans, int n, int k, float alpha, float* a, int lda, float beta, float* c, int ldc){
+		char uplo = upper ? 'u' : 'l';
+		char Atran = trans ? 't' : 'n';
+		
+		ssyrk_(&uplo, &Atran, &n, &k, &alpha, a, &lda, &beta, c, &ldc);
+		
+		return BLAS_SUCCESS;
+	}
+	
 	
 	int host_dger(int m, int n, double alpha, double* x, int incx, double* y, int incy, double* a, int lda){
 		dger_(&m, &n, &alpha, x, &incx, y, &incy, a, &lda);
@@ -211,6 +233,28 @@ namespace lasp{
 		return info;
 	}
 	
+	int host_dtrsm(bool right, bool upper, bool transa, int m, int n, double alpha, double* a, int lda, double* b, int ldb){
+		char side = right ? 'R' : 'L';
+		char up = upper ? 'U' : 'L';
+		char Atran = transa ? 't' : 'n';
+		char diag = 'N';
+		
+		dtrsm_(&side, &up, &Atran, &diag, &m, &n, &alpha, a, &lda, b, &ldb);
+		
+		return BLAS_SUCCESS;
+	}
+	
+	int host_strsm(bool right, bool upper, bool transa, int m, int n, float alpha, float* a, int lda, float* b, int ldb){
+		char side = right ? 'R' : 'L';
+		char up = upper ? 'U' : 'L';
+		char Atran = transa ? 't' : 'n';
+		char diag = 'N';
+		
+		strsm_(&side, &up, &Atran, &diag, &m, &n, &alpha, a, &lda, b, &ldb);
+		
+		return BLAS_SUCCESS;
+	}
+	
 	
 #ifndef CUDA
 	int device_dgesv(DeviceParams params, int n, int nrhs, double* a, int lda, int* ipiv, double* b, int ldb){
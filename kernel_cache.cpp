@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "kernel_cache.h"
+#include "lasp_matrix.h"
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+
+namespace lasp {
+	
+	template<class T>
+	bool KernelCache<T>::Key::operator<(const Key& other) const {
+		if (data != other.data) return data < other.data;
+		if (point != other.point) return point < other.point;
+		if (kernel != other.kernel) return kernel < other.kernel;
+		if (gamma != other.gamma) return gamma < other.gamma;
+		if (coef != other.coef) return coef < other.coef;
+		return degree < other.degree;
+	}
+	
+	template<class T>
+	KernelCache<T>::KernelCache(): bytes_(0), limit_((size_t)256 << 20), hits_(0), misses_(0) {}
+	
+	template<class T>
+	KernelCache<T>& KernelCache<T>::instance(){
+		//Never destroyed, like the host pool
+		static KernelCache<T>* cache = new KernelCache<T>();
+		return *cache;
+	}
+	
+	template<class T>
+	bool KernelCache<T>::cacheable(const kernel_opt& kernelOptions){
+		int kernel = kernelOptions.kernel;
+		return kernel == RBF || kernel == LINEAR || kernel == POLYNOMIAL || kernel == SIGMOID || kernel == SQDIST;
+	}
+	
+	template<class T>
+	typename KernelCache<T>::Key KernelCache<T>::make_key(uint64_t data, int point, const kernel_opt& kernelOptions){
+		Key key;
+		key.data = data;
+		key.point = point;
+		key.kernel = kernelOptions.kernel;
+		key.gamma = kernelOptions.kernel == LINEAR || kernelOptions.kernel == SQDIST ? 0 : kernelOptions.gamma;
+		key.coef = kernelOptions.kernel == POLYNOMIAL || kernelOptions.kernel == SIGMOID ? kernelOptions.coef : 0;
+		key.degree = kernelOptions.kernel == POLYNOMIAL ? kernelOptions.degree : 0;
+		return key;
+	}
+	
+	template<class T>
+	bool KernelCache<T>::find_fingerprint(const MatrixId& matrixId, uint64_t& result){
+		bool found = false;
+		
+#pragma omp critical(lasp_kernel_cache)
+		{
+			typename std::map<MatrixId, uint64_t>::iterator iter = fingerprints_.find(matrixId);
+			if (iter != fingerprints_.end()) {
+				result = iter->second;
+				found = true;
+			}
+		}
+		
+		return found;
+	}
+	
+	template<class T>
+	void KernelCache<T>::store_fingerprint(const MatrixId& matrixId, uint64_t hash){
+#pragma omp critical(lasp_kernel_cache)
+		{
+			//Matrix keys are never reused, drop the memo once it gets long
+			if (fingerprints_.size() > 1024) {
+				fingerprints_.clear();
+			}
+			fingerprints_[matrixId] = hash;
+		}
+	}
+	
+	//FNV-1a step over the bits of one value
+	template<class V>
+	static inline uint64_t fnv_step(uint64_t hash, V value){
+		uint64_t bits = 0;
+		memcpy(&bits, &value, sizeof(V) < sizeof(bits) ? sizeof(V) : sizeof(bits));
+		return (hash ^ bits) * 1099511628211ULL;
+	}
+	
+	template<class T>
+	uint64_t KernelCache<T>::fingerprint(LaspMatrix<T>& X){
+		MatrixId matrixId(X.key(), std::make_pair(X.cols(), X.rows()));
+		uint64_t hash = 0;
+		if (find_fingerprint(matrixId, hash)) {
+			return hash;
+		}
+		
+		//FNV-1a over the shape and the element bits
+		hash = 14695981039346656037ULL;
+		hash = fnv_step(hash, X.cols());
+		hash = fnv_step(hash, X.rows());
+		
+		T* data = X.data();
+		size_t cols = X.cols(), rows = X.rows(), mRows = X.mRows();
+		for (size_t col = 0; col < cols; ++col) {
+			for (size_t row = 0; row < rows; ++row) {
+				hash = fnv_step(hash, data[col * mRows + row]);
+			}
+		}
+		
+		store_fingerprint(matrixId, hash);
+		return hash;
+	}
+	
+	template<class T>
+	uint64_t KernelCache<T>::fingerprint(LaspSparseMatrix<T>& X){
+		MatrixId matrixId(X.key(), std::make_pair(X.cols(), X.nnz()));
+		uint64_t hash = 0;
+		if (find_fingerprint(matrixId, hash)) {
+			return hash;
+		}
+		
+		//Same hash over the compressed arrays, the nonzero count keeps it
+		//apart from a dense matrix of the same shape
+		hash = 14695981039346656037ULL;
+		hash = fnv_step(hash, X.cols());
+		hash = fnv_step(hash, X.rows());
+		hash = fnv_step(hash, X.nnz());
+		
+		const size_t* ptr = X.colPtr();
+		const int* ind = X.rowInd();
+		const T* val = X.values();
+		for (size_t col = 0; col < X.cols(); ++col) {
+			hash = fnv_step(hash, ptr[col + 1]);
+			for (size_t k = ptr[col]; k < ptr[col + 1]; ++k) {
+				hash = fnv_step(hash, ind[k]);
+				hash = fnv_step(hash, val[k]);
+			}
+		}
+		
+		store_fingerprint(matrixId, hash);
+		return hash;
+	}
+	
+	template<class T>
+	bool KernelCache<T>::fetch(uint64_t data, int point, const kernel_opt& kernelOptions, const int* cols, int numCols, T* out, size_t stride){
+		Key key = make_key(data, point, kernelOptions);
+		bool found = false;
+		
+#pragma omp critical(lasp_kernel_cache)
+		{
+			typename std::map<Key, typename EntryList::iterator>::iterator iter = index_.find(key);
+			if (iter != index_.end()) {
+				found = true;
+				hits_++;
+				
+				//Move to the front of the LRU list
+				entries_.splice(entries_.begin(), entries_, iter->second);
+				const std::vector<T>& row = iter->second->second;
+				
+				if (cols != 0) {
+					for (int j = 0; j < numCols; ++j) {
+						out[j * stride] = row[cols[j]];
+					}
+				} else {
+					for (size_t j = 0; j < row.size(); ++j) {
+						out[j * stride] = row[j];
+					}
+				}
+			} else {
+				misses_++;
+			}
+		}
+		
+		return found;
+	}
+	
+	template<class T>
+	void KernelCache<T>::insert(uint64_t data, int point, const kernel_opt& kernelOptions, const T* row, int n, size_t stride){
+		size_t rowBytes = n * sizeof(T);
+		if (rowBytes > limit_) {
+			return;
+		}
+		
+		Key key = make_key(data, point, kernelOptions);
+		std::vector<T> values(n);
+		for (int j = 0; j < n; ++j) {
+			values[j] = row[j * stride];
+		}
+		
+#pragma omp critical(lasp_kernel_cache)
+		{
+			if (index_.find(key) == index_.end()) {
+				while (bytes_ + rowBytes > limit_ && !entries_.empty()) {
+					bytes_ -= entries_.back().second.size() * sizeof(T);
+					index_.erase(entries_.back().first);
+					entries_.pop_back();
+				}
+				
+				entries_.push_front(std::make_pair(key, std::vector<T>()));
+				entries_.front().second.swap(values);
+				index_[key] = entries_.begin();
+				bytes_ += rowBytes;
+			}
+		}
+	}
+	
+	template<class T>
+	void KernelCache<T>::clear(){
+#pragma omp critical(lasp_kernel_cache)
+		{
+			entries_.clear();
+			index_.clear();
+			fingerprints_.clear();
+			bytes_ = 0;
+		}
+	}
+	
+	template<class T>
+	void KernelCache<T>::setLimit(size_t bytes){
+#pragma omp critical(lasp_kernel_cache)
+		{
+			limit_ = bytes;
+			while (bytes_ > limit_ && !entries_.empty()) {
+				bytes_ -= entries_.back().second.size() * sizeof(T);
+				index_.erase(entries_.back().first);
+				entries_.pop_back();
+			}
+		}
+	}
+	
+	template<class T>
+	size_t KernelCache<T>::bytes(){
+		size_t result;
+#pragma omp critical(lasp_kernel_cache)
+		result = bytes_;
+		return result;
+	}
+	
+	template<class T>
+	size_t KernelCache<T>::hits(){
+		size_t result;
+#pragma omp critical(lasp_kernel_cache)
+		result = hits_;
+		return result;
+	}
+	
+	template<class T>
+	size_t KernelCache<T>::misses(){
+		size_t result;
+#pragma omp critical(lasp_kernel_cache)
+		result = misses_;
+		return result;
+	}
+	
+	template<class T>
+	void KernelCache<T>::report(std::ostream& out, const char* label){
+		size_t bytes, rows, hits, misses;
+		
+#pragma omp critical(lasp_kernel_cache)
+		{
+			bytes = bytes_;
+			rows = entries_.size();
+			hits = hits_;
+			misses = misses_;
+		}
+		
+		std::ios::fmtflags flags = out.flags();
+		
+		out << "Kernel cache";
+		if (label != 0) {
+			out << " (" << label << ")";
+		}
+		out << std::fixed << std::setprecision(1) << ": " << hits << " hits, " << misses << " misses, ";
+		out << rows << " rows in " << bytes / (1024.0 * 1024.0) << "MB" << std::endl;
+		
+		out.flags(flags);
+	}
+	
+	template class KernelCache<float>;
+	template class KernelCache<double>;
+}
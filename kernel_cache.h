@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef LASP_KERNEL_CACHE_H
+#define LASP_KERNEL_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+#include "options.h"
+
+namespace lasp {
+	
+	template<class T>
+	class LaspMatrix;
+	
+	template<class T>
+	class LaspSparseMatrix;
+	
+	//Memory bounded LRU cache of kernel rows. An entry holds k(x_p, X) for
+	//one point p against every point of a data matrix X, keyed by a
+	//fingerprint of the contents of X, the point and the kernel parameters.
+	//Rows carry over between Newton retraining steps and between problems
+	//built from the same data, e.g. a hyperparameter sweep that only moves C.
+	//Matrices are fingerprinted once per shape, so their contents must not
+	//be edited in place while they are in use.
+	template<class T>
+	class KernelCache {
+		struct Key {
+			uint64_t data;
+			int point, kernel;
+			double gamma, coef, degree;
+			
+			bool operator<(const Key& other) const;
+		};
+		
+		typedef std::list<std::pair<Key, std::vector<T> > > EntryList;
+		EntryList entries_;
+		std::map<Key, typename EntryList::iterator> index_;
+		
+		//Fingerprints by matrix key and shape
+		typedef std::pair<void*, std::pair<size_t, size_t> > MatrixId;
+		std::map<MatrixId, uint64_t> fingerprints_;
+		
+		size_t bytes_, limit_;
+		size_t hits_, misses_;
+		
+		KernelCache();
+		
+		static Key make_key(uint64_t data, int point, const kernel_opt& kernelOptions);
+		
+		bool find_fingerprint(const MatrixId& matrixId, uint64_t& result);
+		void store_fingerprint(const MatrixId& matrixId, uint64_t hash);
+		
+	public:
+		static KernelCache<T>& instance();
+		
+		//Kernels whose rows can be cached (symmetric, parameters in kernel_opt)
+		static bool cacheable(const kernel_opt& kernelOptions);
+		
+		//Fingerprint of the contents of X
+		uint64_t fingerprint(LaspMatrix<T>& X);
+		uint64_t fingerprint(LaspSparseMatrix<T>& X);
+		
+		//Copy the cached row of point to out[j * stride], for the entries
+		//listed in cols or all of them if cols is 0. False on a miss.
+		bool fetch(uint64_t data, int point, const kernel_opt& kernelOptions, const int* cols, int numCols, T* out, size_t stride);
+		
+		//Add the full row of point, read from row[j * stride]
+		void insert(uint64_t data, int point, const kernel_opt& kernelOptions, const T* row, int n, size_t stride);
+		
+		void clear();
+		
+		//Bytes of kernel rows to keep, least recently used rows go first
+		void setLimit(size_t bytes);
+		
+		size_t bytes();
+		size_t hits();
+		size_t misses();
+		
+		void report(std::ostream& out, const char* label = 0);
+	};
+}
+
+#endif
@@ -26,10 +26,69 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "kernels.h"
+#include "kernel_cache.h"
 #include "svm.h"
 
 namespace lasp{
 
+//Kernel between points ind1 of X and points ind2 of X (all of X if ind2 is
+//0). Rows already in the kernel cache are copied, the rest are computed
+//together, and when they span all of X they are added to the cache.
+//M is LaspMatrix<T> or LaspSparseMatrix<T>.
+template<class T, class M>
+LaspMatrix<T> cached_kernel(kernel_opt kernelOptions, M X, LaspMatrix<T> Xnorm, int *ind1, int ind1Len, int *ind2, int ind2Len){
+	KernelCache<T>& cache = KernelCache<T>::instance();
+	uint64_t data = cache.fingerprint(X);
+	int n = X.cols();
+	int outCols = ind2Len > 0 ? ind2Len : n;
+	
+	LaspMatrix<T> out(outCols, ind1Len);
+	T* outData = out.data();
+	size_t ldOut = out.mRows();
+	
+	vector<int> missing, missingPoints;
+	for (int i = 0; i < ind1Len; ++i) {
+		if (!cache.fetch(data, ind1[i], kernelOptions, ind2Len > 0 ? ind2 : 0, outCols, outData + i, ldOut)) {
+			missing.push_back(i);
+			missingPoints.push_back(ind1[i]);
+		}
+	}
+	
+	if (missing.empty()) {
+		return out;
+	}
+	
+	M X1Param, X2Param = X;
+	LaspMatrix<T> Xnorm1Param, Xnorm2Param = Xnorm;
+	X.gather(X1Param, missingPoints);
+	Xnorm.gather(Xnorm1Param, missingPoints);
+	
+	if (ind2Len > 0) {
+		X2Param = M();
+		Xnorm2Param = LaspMatrix<T>();
+		vector<int> map(ind2, ind2 + ind2Len);
+		X.gather(X2Param, map);
+		Xnorm.gather(Xnorm2Param, map);
+	}
+	
+	LaspMatrix<T> computed;
+	computed.getKernel(kernelOptions, X1Param, Xnorm1Param, X2Param, Xnorm2Param, false, false, false);
+	
+	T* computedData = computed.data();
+	size_t ldComputed = computed.mRows();
+	for (int r = 0; r < missing.size(); ++r) {
+		for (int j = 0; j < outCols; ++j) {
+			outData[j * ldOut + missing[r]] = computedData[j * ldComputed + r];
+		}
+		
+		if (ind2Len == 0) {
+			cache.insert(data, missingPoints[r], kernelOptions, computedData + r, n, ldComputed);
+		}
+	}
+	
+	return out;
+}
+
 template<class T>
 LaspMatrix<T> compute_kernel(kernel_opt kernelOptions, LaspMatrix<T> X1, LaspMatrix<T> Xnorm1, int *ind1, int ind1Len, LaspMatrix<T> X2, LaspMatrix<T> Xnorm2, int *ind2, int ind2Len, bool useGPU){
 	bool gpu = useGPU;
@@ -39,6 +98,11 @@ LaspMatrix<T> compute_kernel(kernel_opt kernelOptions, LaspMatrix<T> X1, LaspMat
 		LaspMatrix<T> ones(1, ind1Len, 1.0);
 		return ones;
 	}
+	
+	//Rows of points of a data set against the same data set go through the cache
+	if(!useGPU && ind1Len > 0 && X1.key() == X2.key() && !X1.isSubMatrix() && !X2.isSubMatrix() && !X1.device() && KernelCache<T>::cacheable(kernelOptions)){
+		return cached_kernel(kernelOptions, X1, Xnorm1, ind1, ind1Len, ind2, ind2Len);
+	}
 
 	LaspMatrix<T> X1Param = X1, X2Param = X2, Xnorm1Param = Xnorm1, Xnorm2Param = Xnorm2;
 	int X1colsParam = X1.cols(), X2colsParam = X2.cols();
@@ -69,8 +133,47 @@ LaspMatrix<T> compute_kernel(kernel_opt kernelOptions, LaspMatrix<T> X1, LaspMat
 	return out;
 }
 
+//Sparse points are always computed on the host
+template<class T>
+LaspMatrix<T> compute_kernel(kernel_opt kernelOptions, LaspSparseMatrix<T> X1, LaspMatrix<T> Xnorm1, int *ind1, int ind1Len, LaspSparseMatrix<T> X2, LaspMatrix<T> Xnorm2, int *ind2, int ind2Len, bool useGPU){
+	LaspMatrix<T> out;
+	
+	if(X2.rows() == 0 || X2.cols() == 0){
+		LaspMatrix<T> ones(1, ind1Len, 1.0);
+		return ones;
+	}
+	
+	if(ind1Len > 0 && X1.key() == X2.key() && KernelCache<T>::cacheable(kernelOptions)){
+		return cached_kernel(kernelOptions, X1, Xnorm1, ind1, ind1Len, ind2, ind2Len);
+	}
+	
+	LaspSparseMatrix<T> X1Param = X1, X2Param = X2;
+	LaspMatrix<T> Xnorm1Param = Xnorm1, Xnorm2Param = Xnorm2;
+	
+	if(ind1Len > 0){
+		X1Param = LaspSparseMatrix<T>();
+		Xnorm1Param = LaspMatrix<T>();
+		vector<int> map(ind1, ind1 + ind1Len);
+		X1.gather(X1Param, map);
+		Xnorm1.gather(Xnorm1Param, map);
+	}
+	
+	if(ind2Len > 0){
+		X2Param = LaspSparseMatrix<T>();
+		Xnorm2Param = LaspMatrix<T>();
+		vector<int> map(ind2, ind2 + ind2Len);
+		X2.gather(X2Param, map);
+		Xnorm2.gather(Xnorm2Param, map);
+	}
+	
+	out.getKernel(kernelOptions, X1Param, Xnorm1Param, X2Param, Xnorm2Param, false, false, false);
+	return out;
+}
+
 template LaspMatrix<float> compute_kernel<float>(kernel_opt kernelOptions, LaspMatrix<float> X1, LaspMatrix<float> Xnorm1, int *ind1, int ind1Len, LaspMatrix<float> X2, LaspMatrix<float> Xnorm2, int *ind2, int ind2Len, bool useGPU);
 template LaspMatrix<double> compute_kernel<double>(kernel_opt kernelOptions, LaspMatrix<double> X1, LaspMatrix<double> Xnorm1, int *ind1, int ind1Len, LaspMatrix<double> X2, LaspMatrix<double> Xnorm2, int *ind2, int ind2Len, bool useGPU);
+template LaspMatrix<float> compute_kernel<float>(kernel_opt kernelOptions, LaspSparseMatrix<float> X1, LaspMatrix<float> Xnorm1, int *ind1, int ind1Len, LaspSparseMatrix<float> X2, LaspMatrix<float> Xnorm2, int *ind2, int ind2Len, bool useGPU);
+template LaspMatrix<double> compute_kernel<double>(kernel_opt kernelOptions, LaspSparseMatrix<double> X1, LaspMatrix<double> Xnorm1, int *ind1, int ind1Len, LaspSparseMatrix<double> X2, LaspMatrix<double> Xnorm2, int *ind2, int ind2Len, bool useGPU);
 
 }
 
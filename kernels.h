@@ -36,5 +36,8 @@ namespace lasp
 	
 template<class T>
 	LaspMatrix<T> compute_kernel(kernel_opt, LaspMatrix<T>, LaspMatrix<T>, int*, int, LaspMatrix<T>, LaspMatrix<T>, int *, int, bool);
+	
+template<class T>
+	LaspMatrix<T> compute_kernel(kernel_opt, LaspSparseMatrix<T>, LaspMatrix<T>, int*, int, LaspSparseMatrix<T>, LaspMatrix<T>, int *, int, bool);
 }
 #endif
@@ -29,6 +29,7 @@
 #define LASP_MATRIX_H
 
 #include "abstract_matrix.h"
+#include "host_pool.h"
 #include <iostream>
 #include <vector>
 #include <iterator>
@@ -42,6 +43,7 @@
 #include <memory>
 
 #include "blas_wrappers.h"
+#include "host_kernels.h"
 
 #ifdef CUDA
 #include <cuda_runtime.h>
@@ -59,6 +61,9 @@ namespace lasp
 	template<class T>
 	struct EvalBase;
 	
+	template<class T>
+	class LaspSparseMatrix;
+	
 	template<class T>
     class LaspMatrix {
 		
@@ -75,6 +80,9 @@ namespace lasp
 		//subclass we're in.
 		T **data_, **dData_;
 		
+		//Holds on to the owner of borrowed memory, empty if we own our data
+		shared_ptr<void> *owner_;
+		
 		//Private accessors given by reference
 		inline int& _rc() const{ return *rc_; };
 		inline int& _subrc() const{ return *subrc_;};
@@ -92,6 +100,7 @@ namespace lasp
 		inline bool& _unified() const{ return *unified_; }
 		inline T*& _data() const{ return *data_; };
 		inline T*& _dData() const{ return *dData_; }
+		inline shared_ptr<void>& _owner() const{ return *owner_; }
 		
 		//Internal methods for reference counting management
 		void cleanup();
@@ -138,6 +147,7 @@ namespace lasp
 		inline bool device() const{ return *device_ || *unified_; }
 		inline bool registered() const{ return *registered_; }
 		inline bool unified() const{ return *unified_; }
+		inline bool borrowed() const{ return static_cast<bool>(*owner_); }
 		inline bool isSubMatrix() const { return rowOffset() != 0 || colOffset() != 0 || rowEnd() != 0 || colEnd() != 0; };
 		inline DeviceContext& context() const { return *context_; }
 		
@@ -345,6 +355,13 @@ namespace lasp
 		int getKernel(kernel_opt kernelOptions, LaspMatrix<T>& X1, LaspMatrix<T>& X2, LaspMatrix<T>& l, bool mult = false, bool transMult = false, bool useGPU = true);
 		int getKernel(kernel_opt kernelOptions, LaspMatrix<T>& X1, LaspMatrix<T>& X2, bool mult = false, bool transMult = false, bool useGPU = true);
 		
+		//Sparse points (host only, see lasp_sparse.h), mult is the plain product
+		int getKernel(kernel_opt kernelOptions, LaspSparseMatrix<T>& X1, LaspMatrix<T>& Xnorm1, LaspSparseMatrix<T>& X2, LaspMatrix<T>& Xnorm2, bool mult = false, bool transMult = false, bool useGPU = true);
+		int getKernel(kernel_opt kernelOptions, LaspSparseMatrix<T>& X1, LaspMatrix<T>& Xnorm1, LaspMatrix<T>& X2, LaspMatrix<T>& Xnorm2, bool mult = false, bool transMult = false, bool useGPU = true);
+		
+		//Kernel of X with itself, on the host only one triangle is computed (in cache sized blocks) and then mirrored
+		int getSymKernel(kernel_opt kernelOptions, LaspMatrix<T>& X, LaspMatrix<T>& Xnorm, bool useGPU = true);
+		
 		template<class N>
 		LaspMatrix<N> convert(bool mem=false);
 		
@@ -367,10 +384,15 @@ namespace lasp
 		static LaspMatrix<T> random(size_t n);
 		static LaspMatrix<T> vcat(LaspMatrix<T> top, LaspMatrix<T> bottom);
 		static LaspMatrix<T> hcat(LaspMatrix<T> left, LaspMatrix<T> right);
+		
+		//Wrap memory owned elsewhere (i.e. a memory mapped file) without copying.
+		//The matrix never frees d, owner is kept alive until the matrix lets go
+		//of the data (on destruction or when a resize needs new memory).
+		static LaspMatrix<T> borrow(size_t col, size_t row, T* d, shared_ptr<void> owner = shared_ptr<void>(), size_t mRow = 0);
 	};
 	
 	template<class T>
-	LaspMatrix<T>::LaspMatrix(): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*){
+	LaspMatrix<T>::LaspMatrix(): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*), owner_(new shared_ptr<void>()){
 		_rc() = 1;
 		_subrc() = 1;
 		_rows() = 0;
@@ -390,7 +412,7 @@ namespace lasp
 	}
 	
 	template<class T>
-	LaspMatrix<T>::LaspMatrix(size_t col, size_t row, T* d, size_t mCol, size_t mRow): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*){
+	LaspMatrix<T>::LaspMatrix(size_t col, size_t row, T* d, size_t mCol, size_t mRow): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*), owner_(new shared_ptr<void>()){
 		_rc() = 1;
 		_subrc() = 1;
 		_rows() = row;
@@ -417,7 +439,7 @@ namespace lasp
 	}
 	
 	template<class T>
-	LaspMatrix<T>::LaspMatrix(size_t col, size_t row, T val, size_t mCol, size_t mRow, bool fill, bool fill_mem): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*){
+	LaspMatrix<T>::LaspMatrix(size_t col, size_t row, T val, size_t mCol, size_t mRow, bool fill, bool fill_mem): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*), owner_(new shared_ptr<void>()){
 		_rc() = 1;
 		_subrc() = 1;
 		_rows() = row;
@@ -453,7 +475,7 @@ namespace lasp
 	}
 	
 	template<class T>
-	LaspMatrix<T>::LaspMatrix(vector<T> vec): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*){
+	LaspMatrix<T>::LaspMatrix(vector<T> vec): rc_(new int), rows_(new size_t), cols_(new size_t), mCols_(new size_t), mRows_(new size_t), colOffset_(new size_t), rowOffset_(new size_t), colEnd_(new size_t), rowEnd_(new size_t), subrc_(new int), data_(new T*), dData_(new T*), device_(new bool), registered_(new bool), unified_(new bool), context_(DeviceContext::instance()), key_(new void*), owner_(new shared_ptr<void>()){
 		_rc() = 1;
 		_subrc() = 1;
 		_rows() = 0;
@@ -478,7 +500,7 @@ namespace lasp
 	}
 	
 	template<class T>
-	LaspMatrix<T>::LaspMatrix(const LaspMatrix<T>& other): rc_(other.rc_), rows_(other.rows_), cols_(other.cols_), mCols_(other.mCols_), mRows_(other.mRows_), colOffset_(other.colOffset_), rowOffset_(other.rowOffset_), colEnd_(other.colEnd_), rowEnd_(other.rowEnd_), subrc_(other.subrc_),  data_(other.data_), dData_(other.dData_), context_(other.context_), device_(other.device_), registered_(other.registered_), unified_(other.unified_), key_(other.key_){
+	LaspMatrix<T>::LaspMatrix(const LaspMatrix<T>& other): rc_(other.rc_), rows_(other.rows_), cols_(other.cols_), mCols_(other.mCols_), mRows_(other.mRows_), colOffset_(other.colOffset_), rowOffset_(other.rowOffset_), colEnd_(other.colEnd_), rowEnd_(other.rowEnd_), subrc_(other.subrc_),  data_(other.data_), dData_(other.dData_), context_(other.context_), device_(other.device_), registered_(other.registered_), unified_(other.unified_), key_(other.key_), owner_(other.owner_){
 		_rc()++;
 		_subrc()++;
 	}
@@ -566,6 +588,24 @@ namespace lasp
 		return output;
 	}
 	
+	//Deleter for borrowed memory that has no owner to keep alive
+	struct no_delete {
+		void operator()(void*) const {}
+	};
+	
+	template<class T>
+	LaspMatrix<T> LaspMatrix<T>::borrow(size_t col, size_t row, T* d, shared_ptr<void> owner, size_t mRow){
+		LaspMatrix<T> retVal;
+		retVal._cols() = col;
+		retVal._rows() = row;
+		retVal._mCols() = col;
+		retVal._mRows() = mRow == 0 ? row : mRow;
+		retVal._data() = d;
+		retVal._unified() = false;
+		retVal._owner() = owner ? owner : shared_ptr<void>(static_cast<void*>(d), no_delete());
+		return retVal;
+	}
+	
 	template<class T>
 	int LaspMatrix<T>::copy(LaspMatrix<T>& other, bool copyMem){
 		int resizeResult = resize(other.cols(), other.rows());
@@ -636,6 +676,7 @@ namespace lasp
 			delete device_;
 			delete registered_;
 			delete unified_;
+			delete owner_;
 			key_ = 0;
 		}
 		
@@ -674,6 +715,7 @@ namespace lasp
 		device_ = other.device_;
 		registered_ = other.registered_;
 		unified_ = other.unified_;
+		owner_ = other.owner_;
 		context_ = other.context_;
 		rowOffset_ = other.rowOffset_;
 		colOffset_ = other.colOffset_;
@@ -1039,6 +1081,7 @@ namespace lasp
 		
 		std::swap(_data(), output._data());
 		std::swap(_dData(), output._dData());
+		std::swap(_owner(), output._owner());
 		std::swap(_cols(), output._cols());
 		std::swap(_rows(), output._rows());
 		std::swap(_mCols(), output._mCols());
@@ -3686,6 +3729,72 @@ namespace lasp
 		out.eWiseDivM(out1, out);
 	}
 	
+	//Host path for the kernels that are a function of the inner product.
+	//Each tile of X1'X2 is a gemm, and the norm correction and nonlinearity
+	//are applied while the tile is still in cache rather than in separate
+	//passes (with their own temporaries) over the whole output
+	template<class T>
+	int calc_tiled(LaspMatrix<T>& out, LaspMatrix<T> X1, LaspMatrix<T> X2, LaspMatrix<T> Xnorm1, LaspMatrix<T> Xnorm2, int kernel, T gamma, T coef, T degree){
+		if (X1.rows() != X2.rows()) {
+			cerr << "Error: Dimension mismatch in getKernel" << endl;
+			return INVALID_DIMENSIONS;
+		}
+		
+		out.transferToHost();
+		X1.transferToHost();
+		X2.transferToHost();
+		Xnorm1.transferToHost();
+		Xnorm2.transferToHost();
+		
+		int n1 = X1.cols(), n2 = X2.cols(), d = X1.rows();
+		int error = out.resize(n2, n1, false);
+		if (error != MATRIX_SUCCESS) {
+			return error;
+		}
+		
+		bool norms = kernel == RBF || kernel == SQDIST;
+		T* x1Data = X1.data();
+		T* x2Data = X2.data();
+		T* norm1 = norms ? Xnorm1.data() : 0;
+		T* norm2 = norms ? Xnorm2.data() : 0;
+		int ld1 = std::max(X1.mRows(), (size_t)1), ld2 = std::max(X2.mRows(), (size_t)1);
+		size_t ldo = out.mRows();
+		size_t normStride1 = Xnorm1.rows() == 1 ? Xnorm1.mRows() : 1;
+		size_t normStride2 = Xnorm2.rows() == 1 ? Xnorm2.mRows() : 1;
+		T* outData = out.data();
+		
+		const int tileSize = 256;
+		int rowTiles = (n1 + tileSize - 1) / tileSize;
+		int colTiles = (n2 + tileSize - 1) / tileSize;
+		
+#ifdef _OPENMP
+		size_t ompCount = static_cast<size_t>(n1) * n2 * std::max(d, 1);
+		size_t ompLimit = out.context().getOmpLimit();
+#endif
+		
+#pragma omp parallel for schedule(dynamic, 1) if(ompCount > ompLimit)
+		for (int tile = 0; tile < rowTiles * colTiles; ++tile) {
+			int i0 = (tile % rowTiles) * tileSize, j0 = (tile / rowTiles) * tileSize;
+			int ni = std::min(tileSize, n1 - i0), nj = std::min(tileSize, n2 - j0);
+			T* block = outData + j0 * ldo + i0;
+			
+			if (d > 0) {
+				host_gemm(true, false, ni, nj, d, static_cast<T>(1), x1Data + static_cast<size_t>(i0) * ld1, ld1, x2Data + static_cast<size_t>(j0) * ld2, ld2, static_cast<T>(0), block, ldo);
+			} else {
+				for (int j = 0; j < nj; ++j) {
+					std::fill(block + j * ldo, block + j * ldo + ni, static_cast<T>(0));
+				}
+			}
+			
+			for (int j = 0; j < nj; ++j) {
+				T colNorm = norms ? norm2[(j0 + j) * normStride2] : 0;
+				host_kernel_column(kernel, block + j * ldo, ni, norms ? norm1 + i0 * normStride1 : 0, normStride1, colNorm, gamma, coef, degree);
+			}
+		}
+		
+		return MATRIX_SUCCESS;
+	}
+	
 	template<class T>
 	int LaspMatrix<T>::getKernel(kernel_opt kernelOptions, LaspMatrix<T>& X1, LaspMatrix<T>& Xnorm1, LaspMatrix<T>& X2, LaspMatrix<T>& Xnorm2, LaspMatrix<T>& l, bool mult, bool transMult, bool useGPU){
 		//Check that the norms exist for RBF and SQDIST
@@ -3759,6 +3868,20 @@ namespace lasp
 			return MATRIX_SUCCESS;
 		}
 		
+		//Host data goes through the tiled path, device data that got here
+		//because the CUDA path failed keeps the matrix operations
+		int kernel = kernelOptions.kernel;
+		bool dotKernel = kernel == RBF || kernel == POLYNOMIAL || kernel == SIGMOID || kernel == SQDIST;
+		bool aliased = key() == X1.key() || key() == X2.key();
+		if (dotKernel && !aliased && !device() && !X1.device() && !X2.device()) {
+			T coef = static_cast<T>(kernelOptions.coef);
+			if (kernel == POLYNOMIAL) {
+				coef = std::max(coef, static_cast<T>(0)); //Same clamp as calc_pol
+			}
+			
+			return calc_tiled(*this, X1, X2, Xnorm1, Xnorm2, kernel, static_cast<T>(kernelOptions.gamma), coef, static_cast<T>(kernelOptions.degree));
+		}
+		
 		if (kernelOptions.kernel == RBF){
 			calc_rbf(*this, X1, X2, Xnorm1, Xnorm2, static_cast<T>(kernelOptions.gamma));
 		}
@@ -3802,6 +3925,88 @@ namespace lasp
 		return getKernel(kernelOptions, X1, temp1, X2, temp2, temp3, mult, transMult, useGPU);
 	}
 	
+	template<class T>
+	int LaspMatrix<T>::getSymKernel(kernel_opt kernelOptions, LaspMatrix<T>& X, LaspMatrix<T>& Xnorm, bool useGPU){
+		int kernel = kernelOptions.kernel;
+		bool dotKernel = kernel == LINEAR || kernel == POLYNOMIAL || kernel == SIGMOID || kernel == RBF || kernel == SQDIST;
+		bool gpu = !unified() && context().getNumDevices() > 0 && (useGPU || X.device() || Xnorm.device());
+		
+		//Kernels that are not functions of the inner product, and the device, use the general path
+		if (!dotKernel || gpu) {
+			return getKernel(kernelOptions, X, Xnorm, X, Xnorm, false, false, useGPU);
+		}
+		
+		if ((kernel == RBF || kernel == SQDIST) && Xnorm.size() == 0) {
+			X.colSqSum(Xnorm);
+		}
+		
+		transferToHost();
+		X.transferToHost();
+		Xnorm.transferToHost();
+		
+		int n = X.cols(), d = X.rows();
+		int error = resize(n, n, false);
+		if (error != MATRIX_SUCCESS) {
+			return error;
+		}
+		
+		T* xData = X.data();
+		int ldx = X.mRows();
+		T* out = data();
+		size_t ldo = mRows();
+		bool useNorms = kernel == RBF || kernel == SQDIST;
+		T* norms = useNorms ? Xnorm.data() : 0;
+		size_t normStride = Xnorm.rows() == 1 ? Xnorm.mRows() : 1;
+		
+		T gamma = static_cast<T>(kernelOptions.gamma);
+		T coef = static_cast<T>(kernelOptions.coef);
+		T degree = static_cast<T>(kernelOptions.degree);
+		if (kernel == POLYNOMIAL) {
+			coef = std::max(coef, static_cast<T>(0)); //Same clamp as calc_pol
+		}
+		
+		//Upper triangle blocks, each is a syrk (diagonal) or gemm followed
+		//by the kernel function while the block is still in cache
+		const int blockSize = 256;
+		int numBlocks = (n + blockSize - 1) / blockSize;
+		vector<pair<int, int> > blocks;
+		for (int bj = 0; bj < numBlocks; ++bj) {
+			for (int bi = 0; bi <= bj; ++bi) {
+				blocks.push_back(make_pair(bi, bj));
+			}
+		}
+		
+#ifdef _OPENMP
+		size_t ompCount = static_cast<size_t>(n) * n * std::max(d, 1);
+		size_t ompLimit = context().getOmpLimit();
+#endif
+		
+#pragma omp parallel for schedule(dynamic, 1) if(ompCount > ompLimit)
+		for (int b = 0; b < (int)blocks.size(); ++b) {
+			int i0 = blocks[b].first * blockSize, j0 = blocks[b].second * blockSize;
+			int ni = std::min(blockSize, n - i0), nj = std::min(blockSize, n - j0);
+			T* block = out + j0 * ldo + i0;
+			
+			if (i0 == j0) {
+				host_syrk(true, true, ni, d, static_cast<T>(1), xData + static_cast<size_t>(i0) * ldx, ldx, static_cast<T>(0), block, ldo);
+			} else {
+				host_gemm(true, false, ni, nj, d, static_cast<T>(1), xData + static_cast<size_t>(i0) * ldx, ldx, xData + static_cast<size_t>(j0) * ldx, ldx, static_cast<T>(0), block, ldo);
+			}
+			
+			for (int j = j0; j < j0 + nj; ++j) {
+				int iEnd = std::min(i0 + ni, j + 1);
+				T colNorm = useNorms ? norms[j * normStride] : 0;
+				host_kernel_column(kernel, out + j * ldo + i0, iEnd - i0, useNorms ? norms + i0 * normStride : 0, normStride, colNorm, gamma, coef, degree);
+				
+				for (int i = i0; i < iEnd; ++i) {
+					out[i * ldo + j] = out[j * ldo + i];
+				}
+			}
+		}
+		
+		return MATRIX_SUCCESS;
+	}
+	
 	template<class T>
 	void LaspMatrix<T>::laspAlloc(size_t size){
 		bool normalAlloc = true;
@@ -3820,7 +4025,7 @@ namespace lasp
 		}
 		
 		if (normalAlloc){
-			_data() = new T[size * sizeof(T)];
+			_data() = static_cast<T*>(HostPool::instance().allocate(size * sizeof(T)));
 		}
 	}
 	
@@ -3840,6 +4045,12 @@ namespace lasp
 	
 	template<class T>
 	void LaspMatrix<T>::laspFree(T* ptr){
+		//Borrowed memory belongs to its owner, just let go of it
+		if (borrowed()) {
+			_owner().reset();
+			return;
+		}
+		
 		if (unified()) {
 #ifdef CUDA
 #ifdef CUDA6
@@ -3851,9 +4062,12 @@ namespace lasp
 #endif
 		}
 		
-		try {
-			delete [] ptr;
-		} catch (...) {}
+		//Memory passed in by the caller was allocated with new []
+		if (!HostPool::instance().release(ptr)) {
+			try {
+				delete [] ptr;
+			} catch (...) {}
+		}
 	}
 	
 #ifndef CUDA
@@ -3949,7 +4163,7 @@ namespace lasp
 	template<class T>
 	void LaspMatrix<T>::freeData(){
 		if (_data() != 0){
-			delete [] _data();
+			laspFree(_data());
 		}
 	}
 	
@@ -3974,7 +4188,7 @@ namespace lasp
 				CUDA_CHECK(cudaHostUnregister(_data()));
 				_registered() = false;
 			} else {
-				_data() = new T[(size_t)_mRows() * (size_t)_mCols()];
+				laspAlloc((size_t)_mRows() * (size_t)_mCols());
 				if(dData() != 0){
 					CUDA_CHECK(cudaMemcpy((void*)_data(), (void*)_dData(), (size_t)_mRows() * (size_t)_mCols() * sizeof(T), cudaMemcpyDeviceToHost));
 					CUDA_CHECK(cudaFree((void*)_dData()));
@@ -3998,7 +4212,7 @@ namespace lasp
 				_dData() = 0;
 			}
 			
-			delete [] _data();
+			laspFree(_data());
 			_data() = 0;
 			_device() = true;
 			
@@ -4076,7 +4290,7 @@ namespace lasp
 			if(dData() != 0){
 				if(_registered()){
 					CUDA_CHECK(cudaHostUnregister(_data()));
-					delete [] _data();
+					laspFree(_data());
 				} else {
 					CUDA_CHECK(cudaFree((void*)dData()));
 				}
@@ -4339,11 +4553,11 @@ namespace lasp
 	template<class T>
 	void LaspMatrix<T>::freeData(){
 		if (!device() && _data() != 0){
-			delete [] _data();
+			laspFree(_data());
 		} else if (dData() != 0){
 			if(_registered()){
 				CUDA_CHECK_THROW(cudaHostUnregister(_data()));
-				delete [] _data();
+				laspFree(_data());
 			} else {
 				CUDA_CHECK_THROW(cudaFree((void*)_dData()));
 			}
@@ -4354,4 +4568,6 @@ namespace lasp
 	
 }
 
+#include "lasp_sparse.h"
+
 #endif
@@ -0,0 +1,448 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef LASP_SPARSE_H
+#define LASP_SPARSE_H
+
+#include "lasp_matrix.h"
+#include <vector>
+#include <memory>
+
+namespace lasp {
+	
+	//Compressed sparse matrix laid out like LaspMatrix, one column per point
+	//and one row per feature. The nonzeros of column j are ind[ptr[j]] to
+	//ind[ptr[j+1]-1] (0-based features) with their values in val. Copies
+	//share storage, and the data always stays on the host.
+	template<class T>
+	class LaspSparseMatrix {
+		struct Storage {
+			std::vector<size_t> ptr;
+			std::vector<int> ind;
+			std::vector<T> val;
+			size_t rows;
+			void* key;
+			
+			//Borrowed arrays (see borrow) are used in place of the vectors
+			//for as long as owner is set
+			shared_ptr<void> owner;
+			const size_t* ptrView;
+			const int* indView;
+			const T* valView;
+			size_t colsView;
+		};
+		
+		//Copy borrowed arrays into the vectors before they are changed
+		void own();
+		
+		shared_ptr<Storage> storage_;
+		
+		template<class N>
+		LaspSparseMatrix<N> convert_to(N*) const;
+		LaspSparseMatrix<T> convert_to(T*) const;
+		
+	public:
+		//Empty matrix, or cols points of rows features with no nonzeros
+		LaspSparseMatrix(size_t cols = 0, size_t rows = 0);
+		
+		//Copy of existing compressed arrays, ptr holds cols+1 entries
+		template<class V>
+		LaspSparseMatrix(size_t cols, size_t rows, const size_t* ptr, const int* ind, const V* val);
+		
+		//Uses existing compressed arrays in place (ptr[0] must be 0), owner
+		//keeps them alive. They are only copied if a column is added.
+		static LaspSparseMatrix<T> borrow(size_t cols, size_t rows, const size_t* ptr, const int* ind, const T* val, shared_ptr<void> owner);
+		
+		size_t cols() const { return storage_->owner ? storage_->colsView : storage_->ptr.size() - 1; }
+		size_t rows() const { return storage_->rows; }
+		size_t nnz() const { return colPtr()[cols()]; }
+		void* key() const { return storage_->key; }
+		
+		const size_t* colPtr() const { return storage_->owner ? storage_->ptrView : &storage_->ptr[0]; }
+		const int* rowInd() const { return storage_->owner ? storage_->indView : storage_->ind.empty() ? 0 : &storage_->ind[0]; }
+		const T* values() const { return storage_->owner ? storage_->valView : storage_->val.empty() ? 0 : &storage_->val[0]; }
+		
+		//Add a point with len nonzeros, features outside of rows() are dropped
+		int appendCol(const int* ind, const T* val, size_t len);
+		void reserve(size_t cols, size_t nnz);
+		
+		//Same interface as LaspMatrix for the code shared by both
+		bool isSubMatrix() const { return false; }
+		bool device() const { return false; }
+		int transferToDevice() { return CANNOT_COMPLETE_OPERATION; }
+		int transferToHost() { return MATRIX_SUCCESS; }
+		
+		int colSqSum(LaspMatrix<T>& output, T scalar = 1);
+		
+		template<class ITER>
+		int gather(LaspSparseMatrix<T>& output, ITER begin, ITER end);
+		int gather(LaspSparseMatrix<T>& output, vector<int>& map);
+		
+		LaspSparseMatrix<T> copy() const;
+		
+		template<class N>
+		LaspSparseMatrix<N> convert() const { return convert_to(static_cast<N*>(0)); }
+		
+		//Dense copy, only meant for small matrices
+		LaspMatrix<T> toDense() const;
+	};
+	
+	template<class T>
+	LaspSparseMatrix<T>::LaspSparseMatrix(size_t cols, size_t rows): storage_(new Storage){
+		storage_->ptr.assign(cols + 1, 0);
+		storage_->rows = rows;
+		storage_->key = DeviceContext::instance()->getNextKey();
+	}
+	
+	template<class T>
+	template<class V>
+	LaspSparseMatrix<T>::LaspSparseMatrix(size_t cols, size_t rows, const size_t* ptr, const int* ind, const V* val): storage_(new Storage){
+		storage_->ptr.assign(ptr, ptr + cols + 1);
+		storage_->ind.assign(ind + ptr[0], ind + ptr[cols]);
+		storage_->val.assign(val + ptr[0], val + ptr[cols]);
+		storage_->rows = rows;
+		storage_->key = DeviceContext::instance()->getNextKey();
+		
+		//Rebase in case the arrays are a slice of a larger matrix
+		size_t base = ptr[0];
+		for (size_t j = 0; j <= cols; ++j) {
+			storage_->ptr[j] -= base;
+		}
+	}
+	
+	template<class T>
+	LaspSparseMatrix<T> LaspSparseMatrix<T>::borrow(size_t cols, size_t rows, const size_t* ptr, const int* ind, const T* val, shared_ptr<void> owner){
+		LaspSparseMatrix<T> result(0, rows);
+		Storage& s = *result.storage_;
+		s.owner = owner ? owner : shared_ptr<void>(const_cast<size_t*>(ptr), no_delete());
+		s.ptrView = ptr;
+		s.indView = ind;
+		s.valView = val;
+		s.colsView = cols;
+		return result;
+	}
+	
+	template<class T>
+	void LaspSparseMatrix<T>::own(){
+		Storage& s = *storage_;
+		if (!s.owner) {
+			return;
+		}
+		
+		s.ptr.assign(s.ptrView, s.ptrView + s.colsView + 1);
+		s.ind.assign(s.indView, s.indView + s.ptr.back());
+		s.val.assign(s.valView, s.valView + s.ptr.back());
+		s.owner.reset();
+	}
+	
+	template<class T>
+	int LaspSparseMatrix<T>::appendCol(const int* ind, const T* val, size_t len){
+		own();
+		Storage& s = *storage_;
+		for (size_t k = 0; k < len; ++k) {
+			if (ind[k] >= 0 && ind[k] < s.rows) {
+				s.ind.push_back(ind[k]);
+				s.val.push_back(val[k]);
+			}
+		}
+		
+		s.ptr.push_back(s.ind.size());
+		return MATRIX_SUCCESS;
+	}
+	
+	template<class T>
+	void LaspSparseMatrix<T>::reserve(size_t cols, size_t nnz){
+		own();
+		storage_->ptr.reserve(cols + 1);
+		storage_->ind.reserve(nnz);
+		storage_->val.reserve(nnz);
+	}
+	
+	template<class T>
+	int LaspSparseMatrix<T>::colSqSum(LaspMatrix<T>& output, T scalar){
+		size_t n = cols();
+		if (output.device()) output.transferToHost();
+		output.resize(n, 1);
+		
+		const size_t* ptr = colPtr();
+		const T* val = values();
+		T* out = output.data();
+		
+#pragma omp parallel for if(nnz() > output.context().getOmpLimit())
+		for (long j = 0; j < (long)n; ++j) {
+			T sum = 0;
+			for (size_t k = ptr[j]; k < ptr[j + 1]; ++k) {
+				sum += val[k] * val[k];
+			}
+			out[j] = sum * scalar;
+		}
+		
+		return MATRIX_SUCCESS;
+	}
+	
+	template<class T>
+	template<class ITER>
+	int LaspSparseMatrix<T>::gather(LaspSparseMatrix<T>& output, ITER begin, ITER end){
+		if (output.key() == key()) {
+			cerr << "ERROR: Gather into same matrix not supported" << endl;
+			return INVALID_LOCATION;
+		}
+		
+		const size_t* ptr = colPtr();
+		size_t n = cols(), total = 0;
+		for (ITER i = begin; i != end; ++i) {
+			if (*i < 0 || *i >= n) {
+				cerr << "ERROR: Map index for gather is out of bounds" << endl;
+				return OUT_OF_BOUNDS;
+			}
+			
+			total += ptr[*i + 1] - ptr[*i];
+		}
+		
+		LaspSparseMatrix<T> result(0, rows());
+		Storage& s = *result.storage_;
+		s.ptr.reserve((end - begin) + 1);
+		s.ind.resize(total);
+		s.val.resize(total);
+		
+		size_t pos = 0;
+		for (ITER i = begin; i != end; ++i) {
+			size_t start = ptr[*i], len = ptr[*i + 1] - start;
+			std::copy(rowInd() + start, rowInd() + start + len, s.ind.begin() + pos);
+			std::copy(values() + start, values() + start + len, s.val.begin() + pos);
+			pos += len;
+			s.ptr.push_back(pos);
+		}
+		
+		output = result;
+		return MATRIX_SUCCESS;
+	}
+	
+	template<class T>
+	int LaspSparseMatrix<T>::gather(LaspSparseMatrix<T>& output, vector<int>& map){
+		return gather(output, map.begin(), map.end());
+	}
+	
+	template<class T>
+	LaspSparseMatrix<T> LaspSparseMatrix<T>::copy() const{
+		return LaspSparseMatrix<T>(cols(), rows(), colPtr(), rowInd(), values());
+	}
+	
+	template<class T>
+	template<class N>
+	LaspSparseMatrix<N> LaspSparseMatrix<T>::convert_to(N*) const{
+		return LaspSparseMatrix<N>(cols(), rows(), colPtr(), rowInd(), values());
+	}
+	
+	template<class T>
+	LaspSparseMatrix<T> LaspSparseMatrix<T>::convert_to(T*) const{
+		return *this;
+	}
+	
+	template<class T>
+	LaspMatrix<T> LaspSparseMatrix<T>::toDense() const{
+		LaspMatrix<T> result(cols(), rows(), 0.0);
+		const size_t* ptr = colPtr();
+		const int* ind = rowInd();
+		const T* val = values();
+		
+		for (size_t j = 0; j < cols(); ++j) {
+			for (size_t k = ptr[j]; k < ptr[j + 1]; ++k) {
+				result(j, ind[k]) = val[k];
+			}
+		}
+		
+		return result;
+	}
+	
+	//Sparse X1'X2 into out (X2.cols() x X1.cols() like getKernel) with the
+	//kernel applied to each column. X1 is transposed to feature major
+	//order first, so a column only touches the X1 entries that share a
+	//feature with its X2 point.
+	template<class T>
+	int calc_sparse(LaspMatrix<T>& out, LaspSparseMatrix<T>& X1, LaspSparseMatrix<T>& X2, LaspMatrix<T>& Xnorm1, LaspMatrix<T>& Xnorm2, int kernel, T gamma, T coef, T degree){
+		size_t n1 = X1.cols(), n2 = X2.cols(), d = std::max(X1.rows(), X2.rows());
+		int error = out.resize(n2, n1, false);
+		if (error != MATRIX_SUCCESS) {
+			return error;
+		}
+		
+		//Feature major copy of X1
+		const size_t* ptr1 = X1.colPtr();
+		const int* ind1 = X1.rowInd();
+		const T* val1 = X1.values();
+		vector<size_t> tPtr(d + 1, 0);
+		vector<int> tInd(X1.nnz());
+		vector<T> tVal(X1.nnz());
+		
+		for (size_t k = 0; k < X1.nnz(); ++k) {
+			++tPtr[ind1[k] + 1];
+		}
+		
+		for (size_t f = 0; f < d; ++f) {
+			tPtr[f + 1] += tPtr[f];
+		}
+		
+		vector<size_t> next(tPtr.begin(), tPtr.end() - 1);
+		for (size_t i = 0; i < n1; ++i) {
+			for (size_t k = ptr1[i]; k < ptr1[i + 1]; ++k) {
+				size_t pos = next[ind1[k]]++;
+				tInd[pos] = i;
+				tVal[pos] = val1[k];
+			}
+		}
+		
+		bool norms = kernel == RBF || kernel == SQDIST;
+		T* norm1 = norms ? Xnorm1.data() : 0;
+		T* norm2 = norms ? Xnorm2.data() : 0;
+		size_t normStride1 = Xnorm1.rows() == 1 ? Xnorm1.mRows() : 1;
+		size_t normStride2 = Xnorm2.rows() == 1 ? Xnorm2.mRows() : 1;
+		
+		const size_t* ptr2 = X2.colPtr();
+		const int* ind2 = X2.rowInd();
+		const T* val2 = X2.values();
+		T* outData = out.data();
+		size_t ldo = out.mRows();
+		
+#ifdef _OPENMP
+		size_t ompCount = n1 * n2;
+		size_t ompLimit = out.context().getOmpLimit();
+#endif
+		
+#pragma omp parallel for schedule(dynamic, 16) if(ompCount > ompLimit)
+		for (long j = 0; j < (long)n2; ++j) {
+			T* col = outData + j * ldo;
+			std::fill(col, col + n1, static_cast<T>(0));
+			
+			for (size_t k = ptr2[j]; k < ptr2[j + 1]; ++k) {
+				T v = val2[k];
+				size_t end = tPtr[ind2[k] + 1];
+				for (size_t t = tPtr[ind2[k]]; t < end; ++t) {
+					col[tInd[t]] += v * tVal[t];
+				}
+			}
+			
+			T colNorm = norms ? norm2[j * normStride2] : 0;
+			host_kernel_column(kernel, col, n1, norm1, normStride1, colNorm, gamma, coef, degree);
+		}
+		
+		return MATRIX_SUCCESS;
+	}
+	
+	//Sparse X1 against dense X2, each entry is a sparse dot product
+	template<class T>
+	int calc_sparse(LaspMatrix<T>& out, LaspSparseMatrix<T>& X1, LaspMatrix<T>& X2, LaspMatrix<T>& Xnorm1, LaspMatrix<T>& Xnorm2, int kernel, T gamma, T coef, T degree){
+		if (X2.device()) X2.transferToHost();
+		
+		size_t n1 = X1.cols(), n2 = X2.cols(), d = X2.rows();
+		int error = out.resize(n2, n1, false);
+		if (error != MATRIX_SUCCESS) {
+			return error;
+		}
+		
+		bool norms = kernel == RBF || kernel == SQDIST;
+		T* norm1 = norms ? Xnorm1.data() : 0;
+		T* norm2 = norms ? Xnorm2.data() : 0;
+		size_t normStride1 = Xnorm1.rows() == 1 ? Xnorm1.mRows() : 1;
+		size_t normStride2 = Xnorm2.rows() == 1 ? Xnorm2.mRows() : 1;
+		
+		const size_t* ptr1 = X1.colPtr();
+		const int* ind1 = X1.rowInd();
+		const T* val1 = X1.values();
+		T* x2Data = X2.data();
+		size_t ld2 = X2.mRows();
+		T* outData = out.data();
+		size_t ldo = out.mRows();
+		
+#ifdef _OPENMP
+		size_t ompCount = X1.nnz() * n2;
+		size_t ompLimit = out.context().getOmpLimit();
+#endif
+		
+#pragma omp parallel for schedule(dynamic, 16) if(ompCount > ompLimit)
+		for (long j = 0; j < (long)n2; ++j) {
+			T* col = outData + j * ldo;
+			const T* x2 = x2Data + j * ld2;
+			
+			for (size_t i = 0; i < n1; ++i) {
+				T sum = 0;
+				for (size_t k = ptr1[i]; k < ptr1[i + 1]; ++k) {
+					sum += ind1[k] < d ? val1[k] * x2[ind1[k]] : 0;
+				}
+				col[i] = sum;
+			}
+			
+			T colNorm = norms ? norm2[j * normStride2] : 0;
+			host_kernel_column(kernel, col, n1, norm1, normStride1, colNorm, gamma, coef, degree);
+		}
+		
+		return MATRIX_SUCCESS;
+	}
+	
+	//Shared setup of the sparse getKernel overloads
+	template<class T, class M>
+	int sparse_kernel(LaspMatrix<T>& out, kernel_opt kernelOptions, LaspSparseMatrix<T>& X1, LaspMatrix<T>& Xnorm1, M& X2, LaspMatrix<T>& Xnorm2, bool mult, bool transMult){
+		int kernel = mult ? LINEAR : kernelOptions.kernel;
+		if (transMult || (kernel != RBF && kernel != LINEAR && kernel != POLYNOMIAL && kernel != SIGMOID && kernel != SQDIST)) {
+			cerr << "Error: Operation not supported for sparse matrices in getKernel" << endl;
+			return METHOD_NOT_IMPLEMENTED;
+		}
+		
+		if((kernel == RBF || kernel == SQDIST) && Xnorm1.size() == 0){
+			X1.colSqSum(Xnorm1);
+		}
+		
+		if((kernel == RBF || kernel == SQDIST) && Xnorm2.size() == 0){
+			X2.colSqSum(Xnorm2);
+		}
+		
+		//Sparse kernels are host only
+		if (out.device()) out.transferToHost();
+		if (Xnorm1.device()) Xnorm1.transferToHost();
+		if (Xnorm2.device()) Xnorm2.transferToHost();
+		
+		T coef = static_cast<T>(kernelOptions.coef);
+		if (kernel == POLYNOMIAL) {
+			coef = std::max(coef, static_cast<T>(0)); //Same clamp as calc_pol
+		}
+		
+		return calc_sparse(out, X1, X2, Xnorm1, Xnorm2, kernel, static_cast<T>(kernelOptions.gamma), coef, static_cast<T>(kernelOptions.degree));
+	}
+	
+	template<class T>
+	int LaspMatrix<T>::getKernel(kernel_opt kernelOptions, LaspSparseMatrix<T>& X1, LaspMatrix<T>& Xnorm1, LaspSparseMatrix<T>& X2, LaspMatrix<T>& Xnorm2, bool mult, bool transMult, bool useGPU){
+		return sparse_kernel(*this, kernelOptions, X1, Xnorm1, X2, Xnorm2, mult, transMult);
+	}
+	
+	template<class T>
+	int LaspMatrix<T>::getKernel(kernel_opt kernelOptions, LaspSparseMatrix<T>& X1, LaspMatrix<T>& Xnorm1, LaspMatrix<T>& X2, LaspMatrix<T>& Xnorm2, bool mult, bool transMult, bool useGPU){
+		return sparse_kernel(*this, kernelOptions, X1, Xnorm1, X2, Xnorm2, mult, transMult);
+	}
+}
+
+#endif
@@ -355,8 +355,9 @@ namespace lasp {
 		//Make sure our kernel allocation succeeds
 		LaspMatrix<T> Ke;
 		while(true){
-			maxElem = options().set_size;
-			numChunks = options().smallKernel ? 1 + ((X.cols() - 1) / maxElem) : 1;
+			//Under a memory budget the kernel block gets a quarter of it
+			maxElem = options().memBudget > 0 ? budget_items(options().memBudget / 4, w.cols() * sizeof(T), X.cols()) : options().set_size;
+			numChunks = options().smallKernel || options().memBudget > 0 ? 1 + ((X.cols() - 1) / maxElem) : 1;
 			
 			//Kernel matrix
 			try {
@@ -365,6 +366,7 @@ namespace lasp {
 			} catch (std::bad_alloc) {
 				options().smallKernel = true;
 				options().set_size /= 2;
+				options().memBudget /= 2;
 			}
 		}
 		
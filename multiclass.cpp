@@ -0,0 +1,157 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "multiclass.h"
+#include "fileIO.h"
+#include "pegasos.h"
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace lasp {
+	
+	//Orders jobs by descending cost so the big pairs start first
+	static bool compare_job_cost(const onevsone_job& a, const onevsone_job& b){
+		if (a.cost != b.cost) {
+			return a.cost > b.cost;
+		}
+		return a.index < b.index;
+	}
+	
+	vector<onevsone_job> get_onevsone_jobs(svm_sparse_data& data){
+		vector<onevsone_job> jobs;
+		
+		for(int i = 0; i < data.orderSeen.size(); ++i) {
+			for(int j = i+1; j < data.orderSeen.size(); ++j) {
+				onevsone_job job;
+				job.index = jobs.size();
+				job.firstClass = data.orderSeen[i];
+				job.secondClass = data.orderSeen[j];
+				job.cost = data.classSize(job.firstClass) + data.classSize(job.secondClass);
+				jobs.push_back(job);
+			}
+		}
+		
+		return jobs;
+	}
+	
+	template<class T>
+	int train_onevsone(svm_sparse_data& data, opt options, vector<svm_problem>& solvedProblems, vector<svm_sparse_data>* holdouts){
+		vector<onevsone_job> jobs = get_onevsone_jobs(data);
+		int numJobs = jobs.size();
+		
+		//Make sure every class we index below exists, so the parallel
+		//section only ever reads the map
+		for (int i = 0; i < data.orderSeen.size(); ++i) {
+			data.classSize(data.orderSeen[i]);
+		}
+		
+		//Device setup is process wide, do it once before the solvers start
+		configure_devices(options);
+		configure_memory(options);
+		
+		vector<svm_problem> problems(numJobs);
+		vector<svm_sparse_data> holdoutData(holdouts ? numJobs : 0);
+		vector<int> errors(numJobs, CORRECT);
+		
+		vector<onevsone_job> queue(jobs);
+		std::stable_sort(queue.begin(), queue.end(), compare_job_cost);
+		
+		int outerThreads = 1, innerThreads = 1;
+#ifdef _OPENMP
+		int maxThreads = omp_get_max_threads();
+		outerThreads = std::max(1, std::min(numJobs, maxThreads));
+		innerThreads = std::max(1, maxThreads / outerThreads);
+		
+		//Leftover threads are only useful if nested regions can use them
+		int oldLevels = omp_get_max_active_levels();
+		if (innerThreads > 1) {
+			omp_set_max_active_levels(std::max(oldLevels, 2));
+		}
+#endif
+		
+		if (options.verb > 1) {
+			cout << "Training " << numJobs << " classifiers with " << outerThreads << " concurrent jobs of " << innerThreads << " threads" << endl;
+		}
+		
+		//Dynamic scheduling over the cost-sorted queue: idle threads pull the
+		//next largest pair, which keeps the tail short
+#pragma omp parallel for schedule(dynamic, 1) num_threads(outerThreads) if(outerThreads > 1)
+		for (int q = 0; q < numJobs; ++q) {
+			onevsone_job& job = queue[q];
+			
+#ifdef _OPENMP
+			omp_set_num_threads(innerThreads);
+#endif
+			
+			if(options.verb > 0) {
+#pragma omp critical(lasp_multiclass_output)
+				cout << "Training " << job.firstClass << " v. " << job.secondClass << " classifier" << endl;
+			}
+			
+			try {
+				svm_problem& curProblem = problems[job.index];
+				if (holdouts) {
+					curProblem = get_onevsone_subproblem(data, holdoutData[job.index], job.firstClass, job.secondClass, options);
+				} else {
+					curProblem = get_onevsone_subproblem(data, job.firstClass, job.secondClass, options);
+				}
+				
+				if (options.pegasos) {
+					errors[job.index] = pegasos_svm_host<T>(curProblem);
+				} else {
+					errors[job.index] = lasp_svm_host<T>(curProblem);
+				}
+			} catch (...) {
+				errors[job.index] = UNSPECIFIED_MATRIX_ERROR;
+			}
+		}
+		
+#ifdef _OPENMP
+		omp_set_max_active_levels(oldLevels);
+#endif
+		
+		for (int i = 0; i < numJobs; ++i) {
+			if (errors[i] != CORRECT) {
+				cerr << "Error training " << jobs[i].firstClass << " v. " << jobs[i].secondClass << " classifier" << endl;
+				return errors[i];
+			}
+		}
+		
+		solvedProblems.insert(solvedProblems.end(), problems.begin(), problems.end());
+		if (holdouts) {
+			holdouts->insert(holdouts->end(), holdoutData.begin(), holdoutData.end());
+		}
+		
+		return CORRECT;
+	}
+	
+	template int train_onevsone<float>(svm_sparse_data& data, opt options, vector<svm_problem>& solvedProblems, vector<svm_sparse_data>* holdouts);
+	template int train_onevsone<double>(svm_sparse_data& data, opt options, vector<svm_problem>& solvedProblems, vector<svm_sparse_data>* holdouts);
+}
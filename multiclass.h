@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LASP_MULTICLASS_H
+#define LASP_MULTICLASS_H
+
+#include "svm.h"
+
+namespace lasp
+{
+	//A single one-vs-one training job, cost is the expected
+	//work for the pair (n_pos + n_neg)
+	struct onevsone_job {
+		int index;
+		int firstClass, secondClass;
+		size_t cost;
+	};
+	
+	//Builds the list of class pairs in the order they appear in
+	//the model, with the cost of each pair filled in
+	vector<onevsone_job> get_onevsone_jobs(svm_sparse_data& data);
+	
+	//Trains every one-vs-one classifier of data, running independent
+	//pairs concurrently. Jobs are handed out largest first and each
+	//job gets an equal share of the OpenMP threads for its own
+	//parallel regions. Solved problems (and holdouts, if given) are
+	//returned in the usual pair order.
+	template<class T>
+	int train_onevsone(svm_sparse_data& data, opt options, vector<svm_problem>& solvedProblems, vector<svm_sparse_data>* holdouts = 0);
+}
+
+#endif
@@ -27,8 +27,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "next_point.h"
 
-template<class T>
-int lasp::choose_next_point(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspMatrix<T> dXs, LaspMatrix<T> dXnormS, LaspMatrix<T> dX, LaspMatrix<T> dXnorm, int rows, LaspMatrix<T>& d_x, int& d_xInd, LaspMatrix<T> dK2, int dK2cols, int dK2rows, LaspMatrix<T> d_out_minus1, int& d_out_minus1Length, T C, T gamma, LaspMatrix<T> dK2norm, bool useGPU){
+template<class T, class M>
+int lasp::choose_next_point(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, M dX, LaspMatrix<T> dXnorm, int rows, LaspMatrix<T>& d_x, int& d_xInd, LaspMatrix<T> dK2, int dK2cols, int dK2rows, LaspMatrix<T> d_out_minus1, int& d_out_minus1Length, T C, T gamma, LaspMatrix<T> dK2norm, bool useGPU){
 	
 	
 	bool gpu = useGPU;
@@ -41,17 +41,12 @@ int lasp::choose_next_point(kernel_opt kernelOptions, vector<int> candidates, ve
 	
 	d_out_minus1.resize(1,dK2.rows());
 	
-	LaspMatrix<T> dXc;
-	dX.gather(dXc, candidates);
-	
-	LaspMatrix<T> dXnormc;
-	dXnorm.gather(dXnormc, candidates);
-	
 	int indS = S.size();
 	LaspMatrix<T> dK3;
 	
+	//Basis vectors against candidates, straight from the training data
 	if(indS != 0){
-		dK3 = compute_kernel<T>(kernelOptions, dXs, dXnormS, 0, 0, dXc, dXnormc, 0, 0, gpu);
+		dK3 = compute_kernel<T>(kernelOptions, dX, dXnorm, S.data(), indS, dX, dXnorm, candidates.data(), candidates.size(), gpu);
 	}
 	
 	LaspMatrix<T> h(1,dK2cols,0.0);
@@ -145,8 +140,10 @@ void lasp::chooseNextHelper(LaspMatrix<T>& d_x, int d_xInd, LaspMatrix<T> g, Las
 	}
 }
 
-template int lasp::choose_next_point<float>(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspMatrix<float> dXs, LaspMatrix<float> dXnormS, LaspMatrix<float> dX, LaspMatrix<float> dXnorm, int rows, LaspMatrix<float>& d_x, int& d_xInd, LaspMatrix<float> dK2, int dK2cols, int dK2rows, LaspMatrix<float> d_out_minus1, int& d_out_minus1Length, float C, float gamma, LaspMatrix<float> dK2norm, bool useGPU);
-template int lasp::choose_next_point<double>(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspMatrix<double> dXs, LaspMatrix<double> dXnormS, LaspMatrix<double> dX, LaspMatrix<double> dXnorm, int rows, LaspMatrix<double>& d_x, int& d_xInd, LaspMatrix<double> dK2, int dK2cols, int dK2rows, LaspMatrix<double> d_out_minus1, int& d_out_minus1Length, double C, double gamma, LaspMatrix<double> dK2norm, bool useGPU);
+template int lasp::choose_next_point<float, lasp::LaspMatrix<float> >(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspMatrix<float> dX, LaspMatrix<float> dXnorm, int rows, LaspMatrix<float>& d_x, int& d_xInd, LaspMatrix<float> dK2, int dK2cols, int dK2rows, LaspMatrix<float> d_out_minus1, int& d_out_minus1Length, float C, float gamma, LaspMatrix<float> dK2norm, bool useGPU);
+template int lasp::choose_next_point<double, lasp::LaspMatrix<double> >(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspMatrix<double> dX, LaspMatrix<double> dXnorm, int rows, LaspMatrix<double>& d_x, int& d_xInd, LaspMatrix<double> dK2, int dK2cols, int dK2rows, LaspMatrix<double> d_out_minus1, int& d_out_minus1Length, double C, double gamma, LaspMatrix<double> dK2norm, bool useGPU);
+template int lasp::choose_next_point<float, lasp::LaspSparseMatrix<float> >(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspSparseMatrix<float> dX, LaspMatrix<float> dXnorm, int rows, LaspMatrix<float>& d_x, int& d_xInd, LaspMatrix<float> dK2, int dK2cols, int dK2rows, LaspMatrix<float> d_out_minus1, int& d_out_minus1Length, float C, float gamma, LaspMatrix<float> dK2norm, bool useGPU);
+template int lasp::choose_next_point<double, lasp::LaspSparseMatrix<double> >(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspSparseMatrix<double> dX, LaspMatrix<double> dXnorm, int rows, LaspMatrix<double>& d_x, int& d_xInd, LaspMatrix<double> dK2, int dK2cols, int dK2rows, LaspMatrix<double> d_out_minus1, int& d_out_minus1Length, double C, double gamma, LaspMatrix<double> dK2norm, bool useGPU);
 
 template void lasp::chooseNextHelper<float>(LaspMatrix<float>& d_x, int d_xInd, LaspMatrix<float> g, LaspMatrix<float> h, int select, LaspMatrix<float> d_out_minus1, LaspMatrix<float> dK2, bool useGPU);
 template void lasp::chooseNextHelper<double>(LaspMatrix<double>& d_x, int d_xInd, LaspMatrix<double> g, LaspMatrix<double> h, int select, LaspMatrix<double> d_out_minus1, LaspMatrix<double> dK2, bool useGPU);
@@ -34,8 +34,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace lasp
 {
-template<class T>
-  int choose_next_point(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, LaspMatrix<T> dXs, LaspMatrix<T> dXnormS, LaspMatrix<T> dX, LaspMatrix<T> dXnorm, int rows, LaspMatrix<T>& d_x, int& d_xInd, LaspMatrix<T> dK2, int dK2cols, int dK2rows, LaspMatrix<T> d_out_minus1, int& d_out_minus1Length, T C, T gamma, LaspMatrix<T> dK2norm, bool);
+//M is the type of the training data, LaspMatrix<T> or LaspSparseMatrix<T>
+template<class T, class M>
+  int choose_next_point(kernel_opt kernelOptions, vector<int> candidates, vector<int> S, M dX, LaspMatrix<T> dXnorm, int rows, LaspMatrix<T>& d_x, int& d_xInd, LaspMatrix<T> dK2, int dK2cols, int dK2rows, LaspMatrix<T> d_out_minus1, int& d_out_minus1Length, T C, T gamma, LaspMatrix<T> dK2norm, bool);
 
 template<class T>
  void chooseNextHelper(LaspMatrix<T>&, int, LaspMatrix<T>, LaspMatrix<T>, int, LaspMatrix<T>, LaspMatrix<T>,bool);
@@ -27,6 +27,7 @@
 
 #include "options.h"
 #include <cmath>
+#include <ctime>
 
 namespace lasp {
     
@@ -75,6 +76,8 @@ namespace lasp {
 		eta = 1.0;
 		alpha = 1.0;
 		beta = 1.0;
+		seed = time(0);
+		memBudget = 0;
 		
 		
         compressedSVM = false;
@@ -93,6 +93,12 @@ namespace lasp{
 		double mean;
 		bool forward_stopping;
 		double eta;
+		//Seed for the random choices made in training
+		unsigned int seed;
+		//Directory for an out-of-core kernel matrix, empty to stay in RAM
+		std::string scratchDir;
+		//Bytes that kernel blocks, chunks and caches are planned to fit in, 0 for no budget
+		size_t memBudget;
 		
         //(Yu)
         bool compressedSVM;
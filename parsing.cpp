@@ -65,7 +65,10 @@ void lasp::exit_with_help()
 #endif
 	cout << "--no_cache (-K) no cache: avoid caching the full kernel matrix\n";
 	cout << "--contigify_kernel (-t) contigify kernel: avoid copying full kernel matrix\n";
+	cout << "--mem-budget (-M) megabytes: plan kernel blocks and caches to fit in this much memory (default = none)\n";
+	cout << "--scratch (-Z) directory: back the kernel matrix with a file here when it does not fit in memory\n";
 	cout << "--random (-f) randomize: randomizes training set selection\n";
+	cout << "--seed (-R) seed: seeds shuffling and basis selection for repeatable runs (default = time)\n";
 	cout << "--sgd (-p) SGD classifier: use stochastic gradient descent for training\n";
 	cout << "--version (-q) version: displays version number and build details\n";
 	cout << "-h help: displays this message\n";
@@ -85,6 +88,7 @@ void lasp::exit_classify()
 #endif
 	cout << "--no_cache (-K) no cache: avoid caching the full kernel matrix\n";
 	cout << "-s set_size: maximum batch of test points when using -K (default = 5000)\n";
+	cout << "--mem-budget (-M) megabytes: size batches of test points to fit in this much memory (default = none)\n";
 	cout << "--version (-q) version: displays version number and build details\n";
 	cout << "-h help: displays this message\n";
 	std::exit(0);
@@ -116,11 +120,15 @@ int lasp::parse_args(int optCount, char **optArgs, lasp::opt &options){
 		{"contigify_kernel", no_argument, 0, 't'},
 		{"maxgpus", required_argument, 0, 'y'},
         //(Yu)
-        {"compressed", required_argument, 0, 'w'}
+        {"compressed", required_argument, 0, 'w'},
+		{"seed", required_argument, 0, 'R'},
+		{"scratch", required_argument, 0, 'Z'},
+		{"mem-budget", required_argument, 0, 'M'},
+		{0, 0, 0, 0}
 	};
 	
 	
-	while((c = getopt_long(optCount, optArgs, "n:s:i:y:bv:tm:x:a:pj:g:c:k:r:d:o:huqflw:eS:KT:OUCI:w", long_options, 0)) != -1)
+	while((c = getopt_long(optCount, optArgs, "n:s:i:y:bv:tm:x:a:pj:g:c:k:r:d:o:huqflw:eS:KT:OUCI:wR:Z:M:", long_options, 0)) != -1)
 		switch(c)
 	{
 		case 'n':
@@ -200,6 +208,21 @@ int lasp::parse_args(int optCount, char **optArgs, lasp::opt &options){
 				exit_with_help();
 			options.coef = floatVal;
 			break;
+		case 'R':
+			intVal = strtol(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || intVal < 0)
+				exit_with_help();
+			options.seed = intVal;
+			break;
+		case 'Z':
+			options.scratchDir = optarg;
+			break;
+		case 'M':
+			intVal = strtol(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || intVal < 0)
+				exit_with_help();
+			options.memBudget = (size_t)intVal << 20;
+			break;
 		case 'd':
 			floatVal = strtof(optarg, &end);
 			if(end == optarg || *end != '\0' || floatVal < 0)
@@ -35,13 +35,6 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <set>
 
 
-#ifdef CPP11
-#include <random>
-#define getrandom(max) dist(mt)
-#else
-#define getrandom(max) (rand() % max)
-#endif
-
 using namespace std;
 
 namespace lasp{
@@ -49,7 +42,7 @@ namespace lasp{
 	int pegasos_svm_host(svm_problem& p) {
 		bool gpu = p.options.usegpu;
 		
-		//Check that we have a CUDA device
+		//Check that we have a CUDA device (set up by configure_devices)
 		if (gpu && DeviceContext::instance()->getNumDevices() < 1) {
 			if (p.options.verb > 0) {
 				cerr << "No CUDA device found, reverting to CPU-only version" << endl;
@@ -57,21 +50,8 @@ namespace lasp{
 			
 			p.options.usegpu = false;
 			gpu = false;
-		} else if(!gpu){
-			DeviceContext::instance()->setNumDevices(0);
-		} else if (p.options.maxGPUs > -1){
-			DeviceContext::instance()->setNumDevices(p.options.maxGPUs);
 		}
 		
-		//Random number generator
-		#ifdef CPP11
-		random_device rd;
-		mt19937 mt(rd());
-		uniform_int_distribution<int> dist(0, p.n - 1);
-		#else
-		srand (time(0));
-		#endif
-		
 		//Timing Variables
 		clock_t baseTime = clock();
 		
@@ -83,7 +63,7 @@ namespace lasp{
 		kernelOptions.coef = p.options.coef;
 		
 		//Training examples
-		LaspMatrix<T> x = LaspMatrix<double>(p.n, p.features, p.xS).convert<T>();
+		LaspMatrix<T> x = training_points(p).convert<T>();
 		
 		//Training labels
 		LaspMatrix<T> y= LaspMatrix<double>(p.n,1,p.y).convert<T>();
@@ -147,7 +127,7 @@ namespace lasp{
 			set<int> unique;
 			
 			for (int i = 0; i < k; ++i) {
-				int ind = getrandom(p.n);
+				int ind = p.solver(p.n);
 				if (unique.count(ind) > 0) {
 					--i;
 				} else {
@@ -252,7 +232,8 @@ namespace lasp{
 						alphas_inds(ind) = alpha_ind;
 						++next_ind;
 						
-						alphas.resize(next_ind, 1);
+						//The new weight is read before it is written, so zero it
+						alphas.resize(next_ind, 1, true, true, 0.0);
 						xS.resize(next_ind, p.features);
 						xnormS.resize(next_ind, 1);
 						
@@ -361,12 +342,17 @@ namespace lasp{
 		
 		p.y = y.template getRawArrayCopy<double>();
 		p.xS = xS.template getRawArrayCopy<double>();
+		p.xOwner.reset();
 		p.S = S;
 		
 		if (p.options.verb > 0){
 			cout << "Training Complete" << endl;
 		}
 		
+		if (p.options.verb > 1){
+			HostPool::instance().report(cout, "training");
+		}
+		
 		return CORRECT;
 	}
 	
@@ -29,69 +29,70 @@
 #include "predict.h"
 #include "kernels.h"
 #include "fileIO.h"
+#include "predictor.h"
 #include <math.h>
 #include <list>
 
+namespace lasp {
+	//Test points per kernel block. Under a memory budget a block of
+	//floatsPerPoint floats per point gets a quarter of it, otherwise -s
+	//sets the batch size.
+	static int test_chunk_size(opt& options, size_t floatsPerPoint, int numPoints){
+		if (options.memBudget > 0) {
+			return budget_items(options.memBudget / 4, floatsPerPoint * sizeof(float), numPoints);
+		}
+		
+		return std::max(1, options.set_size);
+	}
+}
 
 
-void lasp::classify_host(svm_model& myModel,
-						 svm_sparse_data& sparseData,
-						 int& correct,
-						 char* outputfile)
+void lasp::classify_points(svm_predictor& predictor,
+                           bool dag,
+                           svm_sparse_data& sparseData,
+                           int& correct)
 {
-	lasp::svm_full_data testData;
-	sparse_data_to_full(testData, sparseData);
-    
-    //(Yu) normalize the test data
-//    featureScaling<float>(testData.x, testData.numFeatures, testData.numPoints, myModel.means, myModel.standardDeviations);
-//    
-	map<int, vector<int> > classificationVectors;
-	for(int i = 0; i < myModel.orderSeen.size(); ++i) {
-		for(int j = i+1; j < myModel.orderSeen.size(); ++j) {
-			lasp::svm_binary_model curModel;
-			int c1, c2;
-			c1 = myModel.orderSeen[i]; c2 = myModel.orderSeen[j];
-			curModel = get_binary_model(myModel, c1, c2);
-			
-			double* classifications = new double[sparseData.numPoints];
-			lasp::classify_host(classifications, curModel, testData, myModel.options);
-			for(int k = 0; k < sparseData.numPoints; ++k) {
-				int guess = classifications[k] > 0 ? c1 : c2;
-				classificationVectors[k].push_back(guess);
+	//Data views are read where they lie, already in input order
+	svm_data_view& view = sparseData.view;
+	if (!view.empty()) {
+		vector<int> labels(sparseData.numPoints);
+		if (view.indptr) {
+			LaspSparseMatrix<double> X = LaspSparseMatrix<double>::borrow(sparseData.numPoints, sparseData.numFeatures, view.indptr, view.indices, view.values, shared_ptr<void>());
+			if (dag) {
+				predictor.predict_dag(X, labels.data());
+			} else {
+				predictor.predict_votes(X, labels.data());
 			}
-			
-			delete[] classifications;
-		}
-	}
-	
-	//popular vote implementation
-	vector<int> finalClassifications;
-	for(int i = 0; i < testData.numPoints; ++i) {
-		map<int, int> voteCounts;
-		for(int j = 0; j < myModel.orderSeen.size(); ++j) {
-			voteCounts[myModel.orderSeen[j]] = 0;
+		} else if (dag) {
+			predictor.predict_dag(view.x, sparseData.numFeatures, sparseData.numPoints, labels.data());
+		} else {
+			predictor.predict(view.x, sparseData.numFeatures, sparseData.numPoints, labels.data());
 		}
 		
-		for(int j = 0; j < classificationVectors[i].size(); ++j) {
-			voteCounts[classificationVectors[i][j]] ++;
-		}
-		
-		int popCount = -1;
-		int popClass = myModel.orderSeen[0];
-		for(map<int,int>::iterator iter = voteCounts.begin();
-			iter != voteCounts.end();
-			++iter) {
-			if(iter->second > popCount) {
-				popCount = iter->second;
-				popClass = iter->first;
+		correct = 0;
+		if (view.y) {
+			for (int i = 0; i < labels.size(); ++i) {
+				if (labels[i] == int(view.y[i])) ++correct;
 			}
 		}
 		
-        //(Yu) the order of finalClassification is not the orginal order of test points
-		finalClassifications.push_back(popClass);
+		sparseData.outputClassifications = labels;
+		return;
+	}
+	
+	//The test points stay in one sparse matrix. The DAG routes their
+	//indexes between its nodes, voting stops each point once its winner
+	//can no longer change.
+	lasp::svm_full_data testData;
+	LaspSparseMatrix<float> dXe;
+	sparse_data_to_columns(testData, dXe, sparseData);
+	
+	vector<int> finalClassifications(testData.numPoints);
+	if (dag) {
+		predictor.predict_dag(dXe, finalClassifications.data());
+	} else {
+		predictor.predict_votes(dXe, finalClassifications.data());
 	}
-    
-    
 	
 	correct = 0;
 	for(int i = 0; i < finalClassifications.size(); ++i) {
@@ -107,7 +108,7 @@ void lasp::classify_host(svm_model& myModel,
 		int curClass = iter->first;
 		int outputIndex = 0;
 		
-		for (; testData.y[index] == curClass; ++index) {
+		for (; index < finalClassifications.size() && testData.y[index] == curClass; ++index) {
 			for (; outputIndex < sparseData.pointOrder.size(); ++outputIndex) {
 				if (sparseData.pointOrder[outputIndex] == curClass) {
 					outputClassifications[outputIndex] = finalClassifications[index];
@@ -118,12 +119,26 @@ void lasp::classify_host(svm_model& myModel,
 		}
 	}
 	
-	if (outputfile != 0) {
-		output_classifications(outputfile, outputClassifications);
-	}
 	//(Yu) the order of outputClassifications is the orginal order of test points
 	sparseData.outputClassifications = outputClassifications;
+}
+
+
+void lasp::classify_host(svm_model& myModel,
+						 svm_sparse_data& sparseData,
+						 int& correct,
+						 char* outputfile)
+{
+	svm_predictor predictor(myModel, 0);
+	classify_points(predictor, false, sparseData, correct);
+	
+	if (outputfile != 0) {
+		output_classifications(outputfile, sparseData.outputClassifications);
+	}
 	
+	if (myModel.options.verb > 1) {
+		HostPool::instance().reportPhases(cout);
+	}
 }
 
 
@@ -133,114 +148,13 @@ void lasp::dagclassify_host(svm_model& myModel,
                             int& correct,
                             char* outputfile) {
 	
-	lasp::svm_full_data testData;
-	sparse_data_to_full(testData, sparseData);
-    
-    //(Yu) normalize the test data
-    featureScaling<float>(testData.x, testData.numFeatures, testData.numPoints, myModel.means, myModel.standardDeviations);
-    
-    
-	int numClasses = myModel.orderSeen.size();
-	int numPoints = sparseData.numPoints;
-	
-	// Each vector in this list contains the indexes for one partition
-	// of the data. Size of list increases by one for each iteration of
-	// outer loop, reaching numClasses by the end.
-	list<vector<int> > indexes;
-	vector<int> allIndexes;
-	for (int i = 0; i < numPoints; ++i) {
-		allIndexes.push_back(i);
-	}
+	//Points are standardized with the model's means as they are loaded
+	svm_predictor predictor(myModel, 0, true);
+	classify_points(predictor, true, sparseData, correct);
 	
-	indexes.push_back(allIndexes);
-	// Each iteration of outer loop can be seen as one level of the DAG
-    
-	for(int i = 1; i < numClasses; ++i) {
-		indexes.push_back(vector<int>());
-		// Each iteration of inner loop can be seen as one node on level i
-		// of the DAG.
-		
-		for(int j = 0; j < i; ++j) {
-			indexes.push_back(vector<int>());
-			lasp::svm_binary_model curModel;
-			int c1, c2;
-			c1 = myModel.orderSeen[j]; c2 = myModel.orderSeen[numClasses - i + j];
-			curModel = get_binary_model(myModel, c1, c2);
-			
-			// Create arrays to hold the data and copy it over. No way around this
-			// that I could think of.
-			float *x = new float[testData.numFeatures * indexes.front().size()];
-			float *y = new float[indexes.front().size()];
-			for (int k = 0; k < indexes.front().size(); ++k) {
-				int start = indexes.front()[k] * testData.numFeatures;
-				int end = (indexes.front()[k] + 1) * testData.numFeatures;
-				y[k] = 0.0;
-				std::copy(testData.x + start, testData.x + end, x + testData.numFeatures * k);
-			}
-			
-			// Create the full data object
-			lasp::svm_full_data data;
-			data.numFeatures = testData.numFeatures;
-			data.numPoints = indexes.front().size();
-			data.x = x;
-			data.y = y;
-			
-			// Classify and update index vectors.
-			double classifications[data.numPoints];
-			lasp::classify_host(classifications, curModel, data, myModel.options);
-			for (int k = 0; k < data.numPoints; ++k) {
-				if (classifications[k] > 0) {
-					(++indexes.rbegin())->push_back(indexes.front()[k]);
-				} else {
-					indexes.back().push_back(indexes.front()[k]);
-				}
-			}
-			
-			// Done with this node.
-			indexes.pop_front();
-		}
-	}
-    
-	// Label instances based on membership in the index vectors.
-	vector<int> finalClassifications(testData.numPoints);
-	int i = 0;
-	for (std::list<vector<int> >::iterator it = indexes.begin(); it != indexes.end(); ++it,++i) {
-		vector<int> vec = *it;
-		for (int j = 0; j < vec.size(); ++j) {
-			finalClassifications[vec[j]] = myModel.orderSeen[i];
-		}
-	}
-	
-	correct = 0;
-	for(int i = 0; i < finalClassifications.size(); ++i) {
-		if(finalClassifications[i] == testData.y[i]) ++correct;
-	}
-    
-	int unclassified = -99999, index = 0;
-	vector<int> outputClassifications(finalClassifications.size(), unclassified);
-    
-	//Reorder points to match the input order
-	typedef map<int, vector<vector<svm_node> > >::iterator SparseIterator;
-	for(SparseIterator iter = sparseData.allData.begin(); iter != sparseData.allData.end(); ++iter) {
-		int curClass = iter->first;
-		int outputIndex = 0;
-		
-		for (; index < finalClassifications.size() && testData.y[index] == curClass; ++index) {
-			for (; outputIndex < sparseData.pointOrder.size(); ++outputIndex) {
-				if (sparseData.pointOrder[outputIndex] == curClass) {
-					outputClassifications[outputIndex] = finalClassifications[index];
-					++outputIndex;
-					break;
-				}
-			}
-		}
-	}
-    
 	if (outputfile != 0) {
-		output_classifications(outputfile, outputClassifications);
+		output_classifications(outputfile, sparseData.outputClassifications);
 	}
-	
-	sparseData.outputClassifications = outputClassifications;
 }
 
 
@@ -251,64 +165,64 @@ lasp::svm_binary_model lasp::get_binary_model(lasp::svm_model& sparseModel,
 {
 	svm_binary_model returnModel;
 	returnModel.kernelType = sparseModel.kernelType;
-	returnModel.numFeatures = sparseModel.numFeatures;
+	returnModel.numFeatures = std::max(0, sparseModel.numFeatures);
 	returnModel.degree = sparseModel.degree;
 	returnModel.coef = sparseModel.coef;
 	returnModel.gamma = sparseModel.gamma;
 	returnModel.pegasos = sparseModel.pegasos;
-	returnModel.b = sparseModel.offsets[positiveClass][negativeClass];
-	
-	map<vector<svm_node>, map<int, double>, CompareSparseVectors >& posSV = sparseModel.modelData[positiveClass];
-	map<vector<svm_node>, map<int, double>, CompareSparseVectors >& negSV = sparseModel.modelData[negativeClass];
-	
-	vector<double> betas;
-	vector<vector<double> > fullSupportVectors;
-	
-	typedef map<vector<svm_node>, map<int, double> >::iterator SVIterator;
-	for(SVIterator iter = posSV.begin();
-		iter != posSV.end();
-		++iter) {
-		vector<svm_node> curSparse = iter->first;
-		vector<double> curFull;
-		int curSparseIndex = 0;
-		for(int i = 0; i < sparseModel.numFeatures; ++i) {
-			if(curSparse.size() > 0 && curSparseIndex < curSparse.size() && curSparse[curSparseIndex].index == i+1) {
-				curFull.push_back(curSparse[curSparseIndex].value);
-				curSparseIndex++;
-			}
-			else {
-				curFull.push_back(0);
-			}
-		}
-		
-		fullSupportVectors.push_back(curFull);
-		betas.push_back(iter->second[negativeClass]);
+	returnModel.b = 0;
+	
+	int numClasses = sparseModel.orderSeen.size();
+	int pos = -1, neg = -1;
+	for (int i = 0; i < numClasses; ++i) {
+		if (sparseModel.orderSeen[i] == positiveClass) pos = i;
+		if (sparseModel.orderSeen[i] == negativeClass) neg = i;
 	}
 	
-	for(SVIterator iter = negSV.begin();
-		iter != negSV.end();
-		++iter) {
-		vector<svm_node> curSparse = iter->first;
-		vector<double> curFull;
-		int curSparseIndex = 0;
-		for(int i = 0; i < sparseModel.numFeatures; ++i) {
-			if(curSparse.size() > 0 && curSparseIndex < curSparse.size() && curSparse[curSparseIndex].index == i+1) {
-				curFull.push_back(curSparse[curSparseIndex].value);
-				curSparseIndex++;
-			}
-			else {
-				curFull.push_back(0);
+	//A class the model has never seen contributes no support vectors
+	int pair = -1;
+	float sign = 1;
+	if (pos >= 0 && neg >= 0 && pos != neg) {
+		//The model of a reversed pair is the negated model of the pair
+		sign = pos < neg ? 1 : -1;
+		pair = class_pair_index(std::min(pos, neg), std::max(pos, neg), numClasses);
+		returnModel.b = sign * sparseModel.offsets[pair];
+	}
+	
+	int classes[2] = {pos, neg};
+	int numSupportVectors = 0;
+	for (int c = 0; c < 2 && pair >= 0; ++c) {
+		numSupportVectors += sparseModel.classStart[classes[c] + 1] - sparseModel.classStart[classes[c]];
+	}
+	
+	int numFeatures = returnModel.numFeatures;
+	returnModel.numSupportVectors = numSupportVectors;
+	returnModel.xS = new float[std::max(1, numSupportVectors * numFeatures)];
+	returnModel.betas = new float[std::max(1, numSupportVectors)];
+	
+	//The support vectors of the pair are the column ranges of its two classes
+	bool sparse = sparseModel.xSparse.cols() > 0;
+	int sv = 0;
+	for (int c = 0; c < 2 && pair >= 0; ++c) {
+		for (int k = sparseModel.classStart[classes[c]]; k < sparseModel.classStart[classes[c] + 1]; ++k, ++sv) {
+			float* curFull = returnModel.xS + (size_t)sv * numFeatures;
+			if (sparse) {
+				const size_t* ptr = sparseModel.xSparse.colPtr();
+				const int* ind = sparseModel.xSparse.rowInd();
+				const float* val = sparseModel.xSparse.values();
+				std::fill(curFull, curFull + numFeatures, 0.0f);
+				for (size_t e = ptr[k]; e < ptr[k+1]; ++e) {
+					curFull[ind[e]] = val[e];
+				}
+			} else {
+				const float* col = sparseModel.xS.data() + (size_t)k * sparseModel.xS.mRows();
+				std::copy(col, col + numFeatures, curFull);
 			}
+			
+			returnModel.betas[sv] = sign * sparseModel.betas(k, pair);
 		}
-		
-		fullSupportVectors.push_back(curFull);
-		betas.push_back(iter->second[positiveClass]);
 	}
 	
-	returnModel.numSupportVectors = fullSupportVectors.size();
-	double_vector_to_float_array_two_dim(returnModel.xS, fullSupportVectors);
-	double_vector_to_float_array(returnModel.betas, betas);
-	
 	return returnModel;
 }
 
@@ -317,17 +231,6 @@ int lasp::classify_host(double* classifications,
 						lasp::svm_full_data& myData, opt& options,
 						bool distFromHyperplane)
 {
-	//Set GPU parameters
-	if (options.usegpu && DeviceContext::instance()->getNumDevices() < 1) {
-		if (options.verb > 0) {
-			cerr << "No CUDA device found, reverting to CPU-only version" << endl;
-		}
-		
-		options.usegpu = false;
-	} else if (options.maxGPUs > -1){
-		DeviceContext::instance()->setNumDevices(options.maxGPUs);
-	}
-	
 	//Get a matrix of the weights to multiply in later
 	LaspMatrix<float> betas(myModel.numSupportVectors, 1);
 	
@@ -336,143 +239,401 @@ int lasp::classify_host(double* classifications,
 		betas(i, 0) = myModel.betas[i];
 	}
 	
-	//Create data matricies
-	LaspMatrix<float> dXS(myModel.numSupportVectors, myModel.numFeatures, myModel.xS);
-	LaspMatrix<float> dXe(myData.numPoints, myData.numFeatures, myData.x);
-    
-	//Check for implicit bias used in pegasos training
-	bool pegasos = myModel.pegasos;
-	double bias = pegasos ? 0 : myModel.b;
-	
-	//Account for potential difference in number of realized features in train/test data
-	int totalFeatures = 0;
-	if (pegasos) {
-        
-		totalFeatures = std::max(dXS.rows(), dXe.rows() + 1);
-		if (totalFeatures > dXS.rows()) {
-			LaspMatrix<float> lastRowS = dXS(0, dXS.rows()-1, dXS.cols(), dXS.rows()).copy();
-			dXS.resize(dXS.cols(), dXS.rows()-1);
-			dXS.resize(dXS.cols(), totalFeatures, true, true, 0.0);
-			dXS.setRow(dXS.rows()-1, lastRowS);
+	vector<float> offsets(1, myModel.b);
+	LaspMatrix<float> decisions;
+	int error = decision_values_host(decisions, betas, offsets, myModel, myData, options);
+	
+	if (error != 0) {
+		return error;
+	}
+	
+	//Set classes
+	if(!distFromHyperplane){
+#pragma omp parallel for
+		for (int i=0; i < myData.numPoints; ++i) {
+			classifications[i] = decisions(i, 0) > 0 ? 1 : -1;
+		}
+	}
+	else {
+#pragma omp parallel for
+		for (int i=0; i < myData.numPoints; ++i) {
+			classifications[i] = decisions(i, 0);
 		}
+	}
+	
+	return 0;
+}
+
+
+namespace lasp {
+	//Lays the test points (columns of dXe) out over the modelRows
+	//features of the support vectors: missing features are zero and
+	//extra ones are dropped, since they only meet zeros in the support
+	//vectors. Their mass is kept in the norms, which are taken first.
+	//Pegasos models end in a constant bias feature.
+	static void fit_test_features(LaspMatrix<float>& dXe, LaspMatrix<float>& dXeNorm, int modelRows, bool pegasos){
+		dXeNorm = LaspMatrix<float>(dXe.cols(), 1);
+		dXe.colSqSum(dXeNorm);
 		
-		dXe.resize(dXe.cols(), totalFeatures, true, true, 0.0);
-		LaspMatrix<float> lastRow = dXe(0, dXe.rows()-1, dXe.cols(), dXe.rows());
-		lastRow.add(1.0);
-	} else {
-        
-		totalFeatures = std::max(dXS.rows(), dXe.rows());
-		dXS.resize(dXS.cols(), totalFeatures, true, true, 0.0);
-		dXe.resize(dXe.cols(), totalFeatures, true, true, 0.0);
+		int features = pegasos ? modelRows - 1 : modelRows;
+		if (!pegasos && dXe.rows() == features) {
+			return;
+		}
+		
+		LaspMatrix<float> fitted(dXe.cols(), modelRows, 0.0);
+		int copyRows = std::min(features, (int)dXe.rows());
+		
+#pragma omp parallel for
+		for (int i = 0; i < dXe.cols(); ++i) {
+			const float* col = dXe.data() + (size_t)i * dXe.mRows();
+			float* out = fitted.data() + (size_t)i * fitted.mRows();
+			std::copy(col, col + copyRows, out);
+			if (pegasos) {
+				out[modelRows - 1] = 1.0;
+			}
+		}
+		
+		if (pegasos) {
+			dXeNorm.add(1.0);
+		}
+		
+		dXe = fitted;
 	}
 	
-	// Update the features and data in the model to reflect changes
-	myModel.numFeatures = totalFeatures;
-	myModel.xS = dXS.data();
-	myModel.pegasos = false; //Update should not be done more than once
-	myData.numFeatures = totalFeatures;
-	myData.x = dXe.data();
-	
-	LaspMatrix<float> dXe_copy, dXS_copy;
-    
-	// Get copies of data matricies if we're copying them to the device
-	if(options.usegpu){
-		dXe_copy.transferToDevice();
-		dXS_copy.transferToDevice();
-		betas.transferToDevice();
+	//Decision values of the models in the rows of betas, for test points
+	//already fitted to the support vectors' features
+	static int dense_decision_values(LaspMatrix<float>& decisions,
+									 LaspMatrix<float> betas,
+									 vector<float> const& offsets,
+									 kernel_opt kernelOptions,
+									 LaspMatrix<float> dXS,
+									 LaspMatrix<float> dXSNorm,
+									 LaspMatrix<float> dXe,
+									 LaspMatrix<float> dXeNorm,
+									 opt& options){
+		//Set GPU parameters
+		if (options.usegpu && DeviceContext::instance()->getNumDevices() < 1) {
+			if (options.verb > 0) {
+				cerr << "No CUDA device found, reverting to CPU-only version" << endl;
+			}
+			
+			options.usegpu = false;
+		} else if (options.maxGPUs > -1){
+			DeviceContext::instance()->setNumDevices(options.maxGPUs);
+		}
 		
-		int error = dXe_copy.copy(dXe);
-		error += dXS_copy.copy(dXS);
+		int numModels = betas.rows();
+		int numPoints = dXe.cols();
+		int numSupportVectors = dXS.cols();
+		decisions.resize(numPoints, numModels);
 		
-		if (error != 0) {
+		LaspMatrix<float> dXe_copy, dXS_copy, dXeNorm_copy, dXSNorm_copy;
+		
+		// Get copies of data matricies if we're copying them to the device
+		if(options.usegpu){
+			dXe_copy.transferToDevice();
+			dXS_copy.transferToDevice();
+			dXeNorm_copy.transferToDevice();
+			dXSNorm_copy.transferToDevice();
+			betas.transferToDevice();
+			
+			int error = dXe_copy.copy(dXe);
+			error += dXS_copy.copy(dXS);
+			error += dXeNorm_copy.copy(dXeNorm);
+			error += dXSNorm_copy.copy(dXSNorm);
+			
+			if (error != 0) {
+				dXe_copy = dXe;
+				dXS_copy = dXS;
+				dXeNorm_copy = dXeNorm;
+				dXSNorm_copy = dXSNorm;
+			}
+		} else {
 			dXe_copy = dXe;
 			dXS_copy = dXS;
+			dXeNorm_copy = dXeNorm;
+			dXSNorm_copy = dXSNorm;
 		}
-	} else {
-		dXe_copy = dXe;
-		dXS_copy = dXS;
+		
+		//Calculate chunks to break up test points into if we're using the small kernel option
+		int maxElem = 0;
+		int numChunks = 0;
+		int chunkStart = 0;
+		
+		//Make sure our kernel allocation succeeds
+		LaspMatrix<float> Ke;
+		HostPool::instance().beginPhase("prediction");
+		while(true){
+			maxElem = test_chunk_size(options, numSupportVectors + numModels, numPoints);
+			numChunks = options.smallKernel || options.memBudget > 0 ? 1 + ((numPoints - 1) / maxElem) : 1;
+			
+			//Kernel matrix
+			try {
+				Ke.resize(numPoints / numChunks, numSupportVectors);
+				break;
+			} catch (std::bad_alloc) {
+				options.smallKernel = true;
+				options.set_size /= 2;
+				options.memBudget /= 2;
+			}
+		}
+		
+		if (options.usegpu) {
+			Ke.transferToDevice();
+		}
+		
+		//Loop through the chunks
+		for (int chunk = 0; chunk < numChunks; ++chunk) {
+			int chunkSize = (chunk == numChunks - 1) ? numPoints - chunkStart : numPoints / numChunks;
+			int chunkEnd = chunkStart + chunkSize;
+			
+			if (chunkSize == 0) {
+				continue;
+			}
+			
+			//Get chunk kernel matrix
+			LaspMatrix<float> dXe_chunk = dXe_copy(chunkStart, 0, chunkEnd, dXe.rows());
+			LaspMatrix<float> dXeNorm_chunk = dXeNorm_copy(chunkStart, 0, chunkEnd, 1);
+			Ke.getKernel(kernelOptions, dXS_copy, dXSNorm_copy, dXe_chunk, dXeNorm_chunk, false, false, options.usegpu);
+			LaspMatrix<float> classes;
+			
+			betas.multiply(Ke, classes);
+			classes.transferToHost();  //Avoid race condition in operator()
+			
+			//All models share the kernel block, each row of classes is one model
+#pragma omp parallel for
+			for (int i=0; i < chunkSize; ++i) {
+				for (int m = 0; m < numModels; ++m) {
+					decisions(i + chunkStart, m) = classes(i, m) + offsets[m];
+				}
+			}
+			
+			chunkStart = chunkEnd;
+		}
+		
+		return 0;
 	}
 	
-	//Calculate norms
-	LaspMatrix<float> dXeNorm(myData.numPoints,1);
-	dXe_copy.colSqSum(dXeNorm);
+	static kernel_opt model_kernel(int kernelType, double gamma, double degree, double coef){
+		kernel_opt kernelOptions;
+		kernelOptions.kernel = kernelType;
+		kernelOptions.gamma = gamma;
+		kernelOptions.degree = degree;
+		kernelOptions.coef = coef;
+		return kernelOptions;
+	}
 	
-	LaspMatrix<float> dXSNorm(myData.numPoints,1);
-	dXS_copy.colSqSum(dXSNorm);
+	//Features of a linear model's weights that test points carry, the bias
+	//of a pegasos model is the last weight
+	static int linear_features(svm_model& myModel){
+		return myModel.pegasos ? myModel.weights.cols() - 1 : myModel.weights.cols();
+	}
 	
-	//Set kernel options
-	kernel_opt kernelOptions;
-	kernelOptions.kernel = myModel.kernelType;
-	kernelOptions.gamma = myModel.gamma;
-	kernelOptions.degree = myModel.degree;
-	kernelOptions.coef = myModel.coef;
+	static float linear_offset(svm_model& myModel, int pair){
+		return myModel.pegasos ? myModel.weights(myModel.weights.cols() - 1, pair) : myModel.offsets[pair];
+	}
 	
-	//Calculate chunks to break up test points into if we're using the small kernel option
-	int maxElem = 0;
-	int numChunks = 0;
-	int chunkStart = 0;
+	//Linear models: one weight vector per class pair, dense test points
+	//are a single multiply
+	static int linear_decision_values(LaspMatrix<float>& decisions, svm_model& myModel, LaspMatrix<float> dXe){
+		int numPairs = myModel.weights.rows();
+		int numPoints = dXe.cols();
+		int features = std::min(linear_features(myModel), (int)dXe.rows());
+		
+		if (features > 0) {
+			LaspMatrix<float> w = myModel.weights(0, 0, features, numPairs);
+			LaspMatrix<float> x = dXe(0, 0, numPoints, features);
+			w.multiply(x, decisions);
+		} else {
+			decisions = LaspMatrix<float>(numPoints, numPairs, 0.0);
+		}
+		
+		vector<float> offsets(numPairs);
+		for (int pair = 0; pair < numPairs; ++pair) {
+			offsets[pair] = linear_offset(myModel, pair);
+		}
+		
+#pragma omp parallel for
+		for (int i = 0; i < numPoints; ++i) {
+			float* out = decisions.data() + (size_t)i * decisions.mRows();
+			for (int pair = 0; pair < numPairs; ++pair) {
+				out[pair] += offsets[pair];
+			}
+		}
+		
+		return 0;
+	}
 	
-	//Make sure our kernel allocation succeeds
-	LaspMatrix<float> Ke;
-	while(true){
-		maxElem = options.set_size;
-		numChunks = options.smallKernel ? 1 + ((myData.numPoints - 1) / maxElem) : 1;
+	//Sparse test points only touch the weights of their nonzero features
+	static int linear_decision_values(LaspMatrix<float>& decisions, svm_model& myModel, LaspSparseMatrix<float> const& dXe){
+		int numPairs = myModel.weights.rows();
+		int numPoints = dXe.cols();
+		int features = linear_features(myModel);
 		
-		//Kernel matrix
-		try {
-			Ke.resize(myData.numPoints / numChunks, myModel.numSupportVectors);
-			break;
-		} catch (std::bad_alloc) {
-			options.smallKernel = true;
-			options.set_size /= 2;
+		vector<float> offsets(numPairs);
+		for (int pair = 0; pair < numPairs; ++pair) {
+			offsets[pair] = linear_offset(myModel, pair);
 		}
+		
+		decisions.resize(numPoints, numPairs);
+		const size_t* ptr = dXe.colPtr();
+		const int* ind = dXe.rowInd();
+		const float* val = dXe.values();
+		const float* weights = myModel.weights.data();
+		size_t weightStride = myModel.weights.mRows();
+		
+#pragma omp parallel for
+		for (int i = 0; i < numPoints; ++i) {
+			float* out = decisions.data() + (size_t)i * decisions.mRows();
+			std::copy(offsets.begin(), offsets.end(), out);
+			
+			for (size_t e = ptr[i]; e < ptr[i + 1]; ++e) {
+				if (ind[e] >= features) continue;
+				const float* w = weights + (size_t)ind[e] * weightStride;
+				for (int pair = 0; pair < numPairs; ++pair) {
+					out[pair] += val[e] * w[pair];
+				}
+			}
+		}
+		
+		return 0;
 	}
+}
+
+int lasp::decision_values_host(LaspMatrix<float>& decisions,
+							   LaspMatrix<float> betas,
+							   vector<float> const& offsets,
+							   lasp::svm_binary_model& myModel,
+							   lasp::svm_full_data& myData, opt& options)
+{
+	//Create data matricies
+	LaspMatrix<float> dXS = LaspMatrix<float>::borrow(myModel.numSupportVectors, myModel.numFeatures, myModel.xS);
+	LaspMatrix<float> dXe = LaspMatrix<float>::borrow(myData.numPoints, myData.numFeatures, myData.x);
 	
-	if (options.usegpu) {
-		Ke.transferToDevice();
+	LaspMatrix<float> dXSNorm(myModel.numSupportVectors, 1), dXeNorm;
+	dXS.colSqSum(dXSNorm);
+	fit_test_features(dXe, dXeNorm, dXS.rows(), myModel.pegasos);
+	
+	//The bias of a pegasos model is one of its features
+	vector<float> modelOffsets(offsets);
+	if (myModel.pegasos) {
+		modelOffsets.assign(offsets.size(), 0.0f);
 	}
 	
-	//Loop through the chunks
-	for (int chunk = 0; chunk < numChunks; ++chunk) {
-		int chunkSize = (chunk == numChunks - 1) ? myData.numPoints - chunkStart : myData.numPoints / numChunks;
-		int chunkEnd = chunkStart + chunkSize;
+	kernel_opt kernelOptions = model_kernel(myModel.kernelType, myModel.gamma, myModel.degree, myModel.coef);
+	return dense_decision_values(decisions, betas, modelOffsets, kernelOptions, dXS, dXSNorm, dXe, dXeNorm, options);
+}
+
+int lasp::decision_values_host(LaspMatrix<float>& decisions,
+							   lasp::svm_model& myModel,
+							   lasp::svm_full_data& myData, opt& options)
+{
+	if (myModel.weights.cols() > 0) {
+		return linear_decision_values(decisions, myModel, LaspMatrix<float>::borrow(myData.numPoints, myData.numFeatures, myData.x));
+	}
+	
+	if (myModel.xSparse.cols() > 0) {
+		LaspSparseMatrix<float> dXe(0, myData.numFeatures);
+		LaspMatrix<float> x = LaspMatrix<float>::borrow(myData.numPoints, myData.numFeatures, myData.x);
+		vector<int> ind;
+		vector<float> val;
+		for (int i = 0; i < myData.numPoints; ++i) {
+			ind.clear();
+			val.clear();
+			for (int f = 0; f < myData.numFeatures; ++f) {
+				if (x(i, f) != 0) {
+					ind.push_back(f);
+					val.push_back(x(i, f));
+				}
+			}
+			dXe.appendCol(ind.data(), val.data(), ind.size());
+		}
 		
-		if (chunkSize == 0) {
-			continue;
+		return decision_values_host(decisions, myModel, dXe, options);
+	}
+	
+	LaspMatrix<float> dXe = LaspMatrix<float>::borrow(myData.numPoints, myData.numFeatures, myData.x);
+	LaspMatrix<float> dXeNorm;
+	fit_test_features(dXe, dXeNorm, myModel.xS.rows(), myModel.pegasos);
+	
+	vector<float> offsets(myModel.offsets.begin(), myModel.offsets.end());
+	if (myModel.pegasos) {
+		offsets.assign(offsets.size(), 0.0f);
+	}
+	
+	kernel_opt kernelOptions = model_kernel(myModel.kernelType, myModel.gamma, myModel.degree, myModel.coef);
+	return dense_decision_values(decisions, myModel.betas, offsets, kernelOptions, myModel.xS, myModel.xSNorm, dXe, dXeNorm, options);
+}
+
+int lasp::decision_values_host(LaspMatrix<float>& decisions,
+							   lasp::svm_model& myModel,
+							   LaspSparseMatrix<float> dXe,
+							   opt& options)
+{
+	if (myModel.weights.cols() > 0) {
+		return linear_decision_values(decisions, myModel, dXe);
+	}
+	
+	//Dense support vectors take the test points dense
+	if (myModel.xSparse.cols() == 0) {
+		LaspMatrix<float> x = dXe.toDense();
+		svm_full_data myData;
+		myData.x = x.data();
+		myData.numPoints = x.cols();
+		myData.numFeatures = x.rows();
+		return decision_values_host(decisions, myModel, myData, options);
+	}
+	
+	LaspMatrix<float> betas = myModel.betas;
+	LaspSparseMatrix<float> dXS = myModel.xSparse;
+	LaspMatrix<float> dXSNorm = myModel.xSNorm;
+	vector<float> offsets(myModel.offsets.begin(), myModel.offsets.end());
+	
+	int numModels = betas.rows();
+	int numPoints = dXe.cols();
+	decisions.resize(numPoints, numModels);
+	
+	//Calculate norms, the kernel takes the larger feature count of the two
+	LaspMatrix<float> dXeNorm;
+	dXe.colSqSum(dXeNorm);
+	
+	kernel_opt kernelOptions = model_kernel(myModel.kernelType, myModel.gamma, myModel.degree, myModel.coef);
+	
+	HostPool::instance().beginPhase("prediction");
+	int chunkSize = options.smallKernel || options.memBudget > 0 ? test_chunk_size(options, dXS.cols() + numModels, numPoints) : std::max(1, numPoints);
+	LaspMatrix<float> Ke;
+	
+	//Loop through the chunks, gathering the test points of each
+	vector<int> chunkPoints;
+	for (int chunkStart = 0; chunkStart < numPoints; chunkStart += chunkSize) {
+		int chunkEnd = std::min(numPoints, chunkStart + chunkSize);
+		
+		chunkPoints.clear();
+		for (int i = chunkStart; i < chunkEnd; ++i) {
+			chunkPoints.push_back(i);
 		}
 		
-		//Get chunk kernel matrix
-		LaspMatrix<float> dXe_chunk = dXe_copy(chunkStart, 0, chunkEnd, dXe.rows());
-		LaspMatrix<float> dXeNorm_chunk = dXeNorm(chunkStart, 0, chunkEnd, 1);
-		Ke.getKernel(kernelOptions, dXS_copy, dXSNorm, dXe_chunk, dXeNorm_chunk, false, false, options.usegpu);
-		LaspMatrix<float> classes;
+		LaspSparseMatrix<float> dXe_chunk;
+		LaspMatrix<float> dXeNorm_chunk;
+		dXe.gather(dXe_chunk, chunkPoints);
+		dXeNorm.gather(dXeNorm_chunk, chunkPoints);
 		
+		int error = Ke.getKernel(kernelOptions, dXS, dXSNorm, dXe_chunk, dXeNorm_chunk, false, false, false);
+		if (error != 0) {
+			return error;
+		}
+		
+		LaspMatrix<float> classes;
 		betas.multiply(Ke, classes);
-		classes.add(bias);
-		classes.transferToHost();  //Avoid race condition in operator()
 		
-		//Set classes
-		if(!distFromHyperplane){
 #pragma omp parallel for
-			for (int i=0; i < chunkSize; ++i) {
-				classifications[i + chunkStart] = classes(i, 0) > 0 ? 1 : -1;
+		for (int i = 0; i < chunkEnd - chunkStart; ++i) {
+			for (int m = 0; m < numModels; ++m) {
+				decisions(i + chunkStart, m) = classes(i, m) + offsets[m];
 			}
 		}
-		else {
-#pragma omp parallel for
-			for (int i=0; i < chunkSize; ++i) {
-				classifications[i + chunkStart] = classes(i, 0);
-			}
-		}
-		
-		chunkStart = chunkEnd;
 	}
 	
-	
-	dXS.release();
-	dXe.release();
 	return 0;
 }
 
-
-
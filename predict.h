@@ -30,6 +30,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace lasp
 {
+  class svm_predictor;
 
   //The highest-level classify function.
   //Given a model, a set of sparse data,
@@ -50,6 +51,15 @@ namespace lasp
                         svm_sparse_data& sparseData,
                         int& correct,
                         char* outputfile);
+  
+  //Classifies sparseData with a predictor built for its model (scaled
+  //for the DAG), by the DAG or by voting, and counts the correct labels.
+  //The labels go in sparseData.outputClassifications in input order.
+  //Only sparseData is written, so calls on one predictor may overlap.
+  void classify_points(svm_predictor& predictor,
+                       bool dag,
+                       svm_sparse_data& sparseData,
+                       int& correct);
 
   //Given full svm_model/svm_data structs, puts the
   //classifications, as calcuated from the model, and
@@ -66,5 +76,27 @@ namespace lasp
 				    int less,
 				    int greater);
 
+  //Evaluates several binary models that share one set of support
+  //vectors. Row m of betas holds the weights of model m, decisions
+  //gets one row of hyperplane distances per model.
+  int decision_values_host(LaspMatrix<float>& decisions,
+			   LaspMatrix<float> betas,
+			   vector<float> const& offsets,
+			   svm_binary_model& myModel,
+			   svm_full_data& myData, opt& options);
+
+  //Decision values of every class pair of a one-vs-one model, one row
+  //of decisions per pair (see class_pair_index).
+  int decision_values_host(LaspMatrix<float>& decisions,
+			   svm_model& myModel,
+			   svm_full_data& myData, opt& options);
+
+  //Same as above for test points in the columns of dXe. Sparse support
+  //vectors are evaluated sparse, on the host only.
+  int decision_values_host(LaspMatrix<float>& decisions,
+			   svm_model& myModel,
+			   LaspSparseMatrix<float> dXe,
+			   opt& options);
+
 }
 #endif
@@ -0,0 +1,757 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "predictor.h"
+#ifndef _WIN32
+#include <sched.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace lasp {
+	
+	svm_predictor::svm_predictor(svm_model const& model, int threads, bool scale, size_t scratchBytes): model_(model){
+		numClasses_ = model_.orderSeen.size();
+		numPairs_ = numClasses_ * (numClasses_ - 1) / 2;
+		numSV_ = model_.numSupportVectors();
+		
+		if (model_.weights.cols() > 0) {
+			modelRows_ = model_.weights.cols();
+		} else {
+			modelRows_ = model_.xSparse.cols() > 0 ? model_.xSparse.rows() : model_.xS.rows();
+		}
+		
+		modelRows_ = std::max(modelRows_, 1);
+		features_ = model_.pegasos ? modelRows_ - 1 : modelRows_;
+		
+		//The bias of a pegasos model is one of its features
+		offsets_.assign(std::max(numPairs_, 1), 0.0f);
+		if (!model_.pegasos) {
+			for (int pair = 0; pair < numPairs_ && pair < model_.offsets.size(); ++pair) {
+				offsets_[pair] = model_.offsets[pair];
+			}
+		}
+		
+		gamma_ = model_.gamma;
+		degree_ = model_.degree;
+		coef_ = model_.kernelType == POLYNOMIAL ? std::max(model_.coef, 0.0) : model_.coef; //Same clamp as getKernel
+		
+		//Only the features the model has means for are scaled, a constant
+		//feature is left as it is
+		if (scale) {
+			int scaled = std::min<int>(features_, std::min(model_.means.size(), model_.standardDeviations.size()));
+			for (int f = 0; f < scaled; ++f) {
+				double deviation = model_.standardDeviations[f];
+				scaleMean_.push_back(model_.means[f]);
+				scaleInv_.push_back(deviation != 0 ? 1.0 / deviation : 1.0);
+			}
+		}
+		
+		base_.assign(modelRows_, 0.0f);
+		for (int f = 0; f < scaleMean_.size(); ++f) {
+			base_[f] = -scaleMean_[f] * scaleInv_[f];
+		}
+		
+		if (model_.pegasos) {
+			base_[modelRows_ - 1] = 1.0f;
+		}
+		
+		baseNorm_ = 0;
+		for (int f = 0; f < modelRows_; ++f) {
+			baseNorm_ += base_[f] * base_[f];
+		}
+		
+		bool kernel = model_.weights.cols() == 0;
+		if (kernel && model_.xSparse.cols() > 0) {
+			const size_t* ptr = model_.xSparse.colPtr();
+			const int* ind = model_.xSparse.rowInd();
+			const float* val = model_.xSparse.values();
+			
+			featurePtr_.assign(modelRows_ + 1, 0);
+			for (size_t e = 0; e < model_.xSparse.nnz(); ++e) {
+				featurePtr_[ind[e] + 1]++;
+			}
+			
+			for (int f = 0; f < modelRows_; ++f) {
+				featurePtr_[f + 1] += featurePtr_[f];
+			}
+			
+			featureSV_.resize(model_.xSparse.nnz());
+			featureValue_.resize(model_.xSparse.nnz());
+			vector<size_t> next(featurePtr_.begin(), featurePtr_.end() - 1);
+			for (int sv = 0; sv < numSV_; ++sv) {
+				for (size_t e = ptr[sv]; e < ptr[sv + 1]; ++e) {
+					size_t pos = next[ind[e]]++;
+					featureSV_[pos] = sv;
+					featureValue_[pos] = val[e];
+				}
+			}
+		}
+		
+		if (!kernel && numPairs_ > 0) {
+			baseDecisions_.assign(offsets_.begin(), offsets_.end());
+			host_sgemm(false, false, numPairs_, 1, modelRows_, 1, model_.weights.data(), model_.weights.mRows(), &base_[0], modelRows_, 1, &baseDecisions_[0], numPairs_);
+		}
+		
+		if (threads < 1) {
+#ifdef _OPENMP
+			threads = omp_get_max_threads();
+#else
+			threads = 1;
+#endif
+		}
+		
+		//Blocks of up to 64 points, a slot stays within 4MB or its share
+		//of scratchBytes
+		size_t slotBytes = scratchBytes > 0 ? scratchBytes / threads : 4 << 20;
+		size_t pointBytes = (modelRows_ + 1 + (kernel ? numSV_ : 0) + offsets_.size()) * sizeof(float);
+		blockSize_ = budget_items(slotBytes, pointBytes, 64);
+		
+		slots_.resize(threads);
+		for (int i = 0; i < threads; ++i) {
+			Slot& slot = slots_[i];
+			slot.x.resize((size_t)modelRows_ * blockSize_);
+			for (int col = 0; col < blockSize_; ++col) {
+				std::copy(base_.begin(), base_.end(), slot.x.begin() + (size_t)col * modelRows_);
+			}
+			
+			slot.xNorm.assign(blockSize_, 0.0f);
+			slot.kernel.assign(kernel ? (size_t)std::max(numSV_, 1) * blockSize_ : 0, 0.0f);
+			slot.decisions.assign(offsets_.size() * blockSize_, 0.0f);
+			slot.votes.assign(std::max(numClasses_, 1), 0);
+			slot.left.assign(std::max(numClasses_, 1), 0);
+			slot.done.assign(std::max(numPairs_, 1), 0);
+			slot.busy = false;
+		}
+	}
+	
+	svm_predictor::Slot& svm_predictor::acquire(){
+		while (true) {
+			Slot* slot = 0;
+			
+#pragma omp critical(lasp_predictor_slots)
+			{
+				for (size_t i = 0; i < slots_.size() && slot == 0; ++i) {
+					if (!slots_[i].busy) {
+						slots_[i].busy = true;
+						slot = &slots_[i];
+					}
+				}
+			}
+			
+			if (slot) {
+				return *slot;
+			}
+			
+			//More callers than slots, wait for one to finish
+#ifndef _WIN32
+			sched_yield();
+#endif
+		}
+	}
+	
+	void svm_predictor::release(Slot& slot){
+#pragma omp critical(lasp_predictor_slots)
+		{
+			slot.busy = false;
+		}
+	}
+	
+	//Extra features are dropped but kept in the norm, as in the batch path
+	template<class V>
+	void svm_predictor::load_dense(Slot& slot, int i, const V* x, int features){
+		float* out = &slot.x[(size_t)i * modelRows_];
+		int scaled = scaleMean_.size();
+		float norm = baseNorm_;
+		
+		for (int f = 0; f < features; ++f) {
+			float value = f < scaled ? (x[f] - scaleMean_[f]) * scaleInv_[f] : x[f];
+			if (f < features_) {
+				norm += value * value - base_[f] * base_[f];
+				out[f] = value;
+			} else {
+				norm += value * value;
+			}
+		}
+		
+		slot.xNorm[i] = norm;
+	}
+	
+	template<class V>
+	void svm_predictor::load_sparse(Slot& slot, int i, const int* indices, const V* values, size_t nnz){
+		float* out = &slot.x[(size_t)i * modelRows_];
+		int scaled = scaleMean_.size();
+		float norm = baseNorm_;
+		
+		for (size_t e = 0; e < nnz; ++e) {
+			int f = indices[e];
+			float value = f < scaled ? (values[e] - scaleMean_[f]) * scaleInv_[f] : values[e];
+			if (f < features_) {
+				norm += value * value - base_[f] * base_[f];
+				out[f] = value;
+			} else {
+				norm += value * value;
+			}
+		}
+		
+		slot.xNorm[i] = norm;
+	}
+	
+	void svm_predictor::clear_dense(Slot& slot, int i, int features){
+		float* out = &slot.x[(size_t)i * modelRows_];
+		std::copy(base_.begin(), base_.begin() + std::min(features, features_), out);
+	}
+	
+	void svm_predictor::clear_sparse(Slot& slot, int i, const int* indices, size_t nnz){
+		float* out = &slot.x[(size_t)i * modelRows_];
+		for (size_t e = 0; e < nnz; ++e) {
+			if (indices[e] < features_) {
+				out[indices[e]] = base_[indices[e]];
+			}
+		}
+	}
+	
+	void svm_predictor::load_point(Slot& slot, int i, dense_points const& X, int col){
+		load_dense(slot, i, X.x + (size_t)col * X.features, X.features);
+	}
+	
+	void svm_predictor::clear_point(Slot& slot, int i, dense_points const& X, int col){
+		clear_dense(slot, i, X.features);
+	}
+	
+	template<class V>
+	void svm_predictor::load_point(Slot& slot, int i, LaspSparseMatrix<V> const& X, int col){
+		const size_t* ptr = X.colPtr();
+		load_sparse(slot, i, X.rowInd() + ptr[col], X.values() + ptr[col], ptr[col + 1] - ptr[col]);
+	}
+	
+	template<class V>
+	void svm_predictor::clear_point(Slot& slot, int i, LaspSparseMatrix<V> const& X, int col){
+		const size_t* ptr = X.colPtr();
+		clear_sparse(slot, i, X.rowInd() + ptr[col], ptr[col + 1] - ptr[col]);
+	}
+	
+	//Decision value of one pair for one point, from its kernel values
+	//against the support vectors of the two classes
+	struct kernel_pair_decision {
+		const float* betas;
+		size_t betaRows;
+		const float* kernel;
+		const int* classStart;
+		const float* offsets;
+		
+		float operator()(int pair, int a, int b) const {
+			float decision = offsets[pair];
+			if (kernel == 0) {
+				return decision;
+			}
+			
+			for (int sv = classStart[a]; sv < classStart[a + 1]; ++sv) {
+				decision += betas[sv * betaRows + pair] * kernel[sv];
+			}
+			
+			for (int sv = classStart[b]; sv < classStart[b + 1]; ++sv) {
+				decision += betas[sv * betaRows + pair] * kernel[sv];
+			}
+			
+			return decision;
+		}
+	};
+	
+	template<class Decision>
+	int svm_predictor::vote_early(Slot& slot, Decision decision){
+		int* votes = &slot.votes[0];
+		int* left = &slot.left[0];
+		char* done = &slot.done[0];
+		vector<int> const& labels = model_.orderSeen;
+		
+		std::fill(votes, votes + numClasses_, 0);
+		std::fill(left, left + numClasses_, numClasses_ - 1);
+		std::fill(done, done + numPairs_, 0);
+		
+		while (true) {
+			//Ties go to the smallest label, as in vote
+			int leader = 0;
+			for (int c = 1; c < numClasses_; ++c) {
+				if (votes[c] > votes[leader] || (votes[c] == votes[leader] && labels[c] < labels[leader])) {
+					leader = c;
+				}
+			}
+			
+			//Settled once no other class can pass the leader, even if it
+			//wins every pair it has left
+			bool settled = true;
+			for (int c = 0; c < numClasses_ && settled; ++c) {
+				int best = votes[c] + left[c];
+				if (c != leader && (best > votes[leader] || (best == votes[leader] && labels[c] < labels[leader]))) {
+					settled = false;
+				}
+			}
+			
+			if (settled) {
+				return leader;
+			}
+			
+			//The two classes that can still reach the most votes play next,
+			//so the leader is found early and the others fall behind it
+			int a = -1;
+			for (int c = 0; c < numClasses_; ++c) {
+				if (left[c] > 0 && (a < 0 || votes[c] + left[c] > votes[a] + left[a])) {
+					a = c;
+				}
+			}
+			
+			int b = -1, pair = -1;
+			for (int c = 0; c < numClasses_; ++c) {
+				if (c == a) continue;
+				
+				int cur = class_pair_index(std::min(a, c), std::max(a, c), numClasses_);
+				if (!done[cur] && (b < 0 || votes[c] + left[c] > votes[b] + left[b])) {
+					b = c;
+					pair = cur;
+				}
+			}
+			
+			int c1 = std::min(a, b), c2 = std::max(a, b);
+			votes[decision(pair, c1, c2) > 0 ? c1 : c2]++;
+			left[a]--;
+			left[b]--;
+			done[pair] = 1;
+		}
+	}
+	
+	void svm_predictor::classify_block(Slot& slot, int points, int* labels){
+		float* x = &slot.x[0];
+		float* decisions = &slot.decisions[0];
+		
+		if (numPairs_ == 0) {
+			vote(slot, points, labels);
+			return;
+		}
+		
+		//Kernel models read only the pairs each point needs from its kernel
+		//values
+		if (model_.weights.cols() == 0) {
+			if (numSV_ > 0) {
+				kernel_block(slot, points);
+			}
+			
+			kernel_pair_decision decision;
+			decision.betas = model_.betas.data();
+			decision.betaRows = model_.betas.mRows();
+			decision.classStart = &model_.classStart[0];
+			decision.offsets = &offsets_[0];
+			
+			for (int i = 0; i < points; ++i) {
+				decision.kernel = numSV_ > 0 ? &slot.kernel[(size_t)i * numSV_] : 0;
+				labels[i] = model_.orderSeen[vote_early(slot, decision)];
+			}
+			
+			return;
+		}
+		
+		host_sgemm(false, false, numPairs_, points, modelRows_, 1, model_.weights.data(), model_.weights.mRows(), x, modelRows_, 0, decisions, numPairs_);
+		
+		for (int i = 0; i < points; ++i) {
+			float* out = decisions + (size_t)i * numPairs_;
+			for (int pair = 0; pair < numPairs_; ++pair) {
+				out[pair] += offsets_[pair];
+			}
+		}
+		
+		vote(slot, points, labels);
+	}
+	
+	void svm_predictor::kernel_block(Slot& slot, int points){
+		float* x = &slot.x[0];
+		float* kernel = &slot.kernel[0];
+		
+		if (model_.xSparse.cols() > 0) {
+			for (int i = 0; i < points; ++i) {
+				const float* point = x + (size_t)i * modelRows_;
+				float* out = kernel + (size_t)i * numSV_;
+				std::fill(out, out + numSV_, 0.0f);
+				
+				for (int f = 0; f < modelRows_; ++f) {
+					float value = point[f];
+					if (value == 0) continue;
+					
+					for (size_t t = featurePtr_[f]; t < featurePtr_[f + 1]; ++t) {
+						out[featureSV_[t]] += value * featureValue_[t];
+					}
+				}
+			}
+		} else {
+			host_sgemm(true, false, numSV_, points, modelRows_, 1, model_.xS.data(), std::max<int>(model_.xS.mRows(), 1), x, modelRows_, 0, kernel, numSV_);
+		}
+		
+		const float* norms = model_.xSNorm.data();
+		size_t normStride = model_.xSNorm.rows() == 1 ? model_.xSNorm.mRows() : 1;
+		for (int i = 0; i < points; ++i) {
+			host_kernel_column(model_.kernelType, kernel + (size_t)i * numSV_, numSV_, norms, normStride, slot.xNorm[i], gamma_, coef_, degree_);
+		}
+	}
+	
+	void svm_predictor::pair_block(Slot& slot, int points, int a, int b){
+		int pair = class_pair_index(a, b, numClasses_);
+		float* x = &slot.x[0];
+		float* decisions = &slot.decisions[0];
+		
+		if (model_.weights.cols() > 0) {
+			host_sgemm(false, false, 1, points, modelRows_, 1, model_.weights.data() + pair, model_.weights.mRows(), x, modelRows_, 0, decisions, 1);
+		} else {
+			//Only the two classes' support vectors have betas for this pair
+			float* kernel = &slot.kernel[0];
+			const float* norms = model_.xSNorm.data();
+			size_t normStride = model_.xSNorm.rows() == 1 ? model_.xSNorm.mRows() : 1;
+			size_t betaRows = model_.betas.mRows();
+			float accumulate = 0;
+			
+			int classes[2] = {a, b};
+			for (int c = 0; c < 2; ++c) {
+				int start = model_.classStart[classes[c]];
+				int count = model_.classStart[classes[c] + 1] - start;
+				if (count == 0) continue;
+				
+				if (model_.xSparse.cols() > 0) {
+					const size_t* ptr = model_.xSparse.colPtr();
+					const int* ind = model_.xSparse.rowInd();
+					const float* val = model_.xSparse.values();
+					
+					for (int i = 0; i < points; ++i) {
+						const float* point = x + (size_t)i * modelRows_;
+						float* out = kernel + (size_t)i * count;
+						for (int sv = 0; sv < count; ++sv) {
+							float dot = 0;
+							for (size_t e = ptr[start + sv]; e < ptr[start + sv + 1]; ++e) {
+								dot += val[e] * point[ind[e]];
+							}
+							out[sv] = dot;
+						}
+					}
+				} else {
+					int svRows = std::max<int>(model_.xS.mRows(), 1);
+					host_sgemm(true, false, count, points, modelRows_, 1, model_.xS.data() + (size_t)start * svRows, svRows, x, modelRows_, 0, kernel, count);
+				}
+				
+				for (int i = 0; i < points; ++i) {
+					host_kernel_column(model_.kernelType, kernel + (size_t)i * count, count, norms + start * normStride, normStride, slot.xNorm[i], gamma_, coef_, degree_);
+				}
+				
+				host_sgemm(false, false, 1, points, count, 1, model_.betas.data() + start * betaRows + pair, betaRows, kernel, count, accumulate, decisions, 1);
+				accumulate = 1;
+			}
+			
+			if (accumulate == 0) {
+				std::fill(decisions, decisions + points, 0.0f);
+			}
+		}
+		
+		for (int i = 0; i < points; ++i) {
+			decisions[i] += offsets_[pair];
+		}
+	}
+	
+	void svm_predictor::vote(Slot& slot, int points, int* labels){
+		for (int i = 0; i < points; ++i) {
+			const float* decisions = &slot.decisions[(size_t)i * numPairs_];
+			std::fill(slot.votes.begin(), slot.votes.end(), 0);
+			
+			int pair = 0;
+			for (int c1 = 0; c1 < numClasses_; ++c1) {
+				for (int c2 = c1 + 1; c2 < numClasses_; ++c2, ++pair) {
+					slot.votes[decisions[pair] > 0 ? c1 : c2]++;
+				}
+			}
+			
+			//Ties go to the smallest label, as in classify_host
+			int popCount = -1;
+			int popClass = numClasses_ > 0 ? model_.orderSeen[0] : 0;
+			for (int j = 0; j < numClasses_; ++j) {
+				int curClass = model_.orderSeen[j];
+				if (slot.votes[j] > popCount || (slot.votes[j] == popCount && curClass < popClass)) {
+					popCount = slot.votes[j];
+					popClass = curClass;
+				}
+			}
+			
+			labels[i] = popClass;
+		}
+	}
+	
+	//All pairs in one pass over the weights of the nonzero features, on top
+	//of the decisions for base_
+	template<class V>
+	void svm_predictor::linear_sparse(Slot& slot, const int* indices, const V* values, size_t nnz, int* label){
+		float* decisions = &slot.decisions[0];
+		std::copy(baseDecisions_.begin(), baseDecisions_.end(), decisions);
+		
+		const float* weights = model_.weights.data();
+		size_t weightStride = model_.weights.mRows();
+		int scaled = scaleMean_.size();
+		for (size_t e = 0; e < nnz; ++e) {
+			int f = indices[e];
+			if (f >= features_) continue;
+			
+			float value = f < scaled ? (values[e] - scaleMean_[f]) * scaleInv_[f] : values[e];
+			float delta = value - base_[f];
+			const float* w = weights + (size_t)f * weightStride;
+			for (int pair = 0; pair < numPairs_; ++pair) {
+				decisions[pair] += delta * w[pair];
+			}
+		}
+		
+		vote(slot, 1, label);
+	}
+	
+	int svm_predictor::predict(const double* x, int features, int points, int* labels){
+		if (features < 0 || points < 0 || (points > 0 && (x == 0 || labels == 0))) {
+			return INVALID_INPUT;
+		}
+		
+		int numBlocks = (points + blockSize_ - 1) / blockSize_;
+		int numThreads = std::max(1, std::min(threads(), numBlocks));
+		
+#pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads) if(numBlocks > 1)
+		for (int block = 0; block < numBlocks; ++block) {
+			Slot& slot = acquire();
+			int start = block * blockSize_;
+			int count = std::min(blockSize_, points - start);
+			
+			for (int i = 0; i < count; ++i) {
+				load_dense(slot, i, x + (size_t)(start + i) * features, features);
+			}
+			
+			classify_block(slot, count, labels + start);
+			
+			for (int i = 0; i < count; ++i) {
+				clear_dense(slot, i, features);
+			}
+			
+			release(slot);
+		}
+		
+		return CORRECT;
+	}
+	
+	int svm_predictor::predict_sparse(const int* indices, const double* values, int nnz, int* label){
+		if (nnz < 0 || label == 0 || (nnz > 0 && (indices == 0 || values == 0))) {
+			return INVALID_INPUT;
+		}
+		
+		for (int e = 0; e < nnz; ++e) {
+			if (indices[e] < 0) {
+				return INVALID_INPUT;
+			}
+		}
+		
+		Slot& slot = acquire();
+		
+		//Linear models only need the weights of the nonzero features
+		if (model_.weights.cols() > 0 && numPairs_ > 0) {
+			linear_sparse(slot, indices, values, nnz, label);
+			release(slot);
+			return CORRECT;
+		}
+		
+		load_sparse(slot, 0, indices, values, nnz);
+		classify_block(slot, 1, label);
+		clear_sparse(slot, 0, indices, nnz);
+		
+		release(slot);
+		return CORRECT;
+	}
+	
+	int svm_predictor::predict_dag(LaspSparseMatrix<float> const& X, int* labels){
+		return dag(X, labels);
+	}
+	
+	int svm_predictor::predict_dag(LaspSparseMatrix<double> const& X, int* labels){
+		return dag(X, labels);
+	}
+	
+	int svm_predictor::predict_dag(const double* x, int features, int points, int* labels){
+		if (features < 0 || points < 0 || (points > 0 && x == 0)) {
+			return INVALID_INPUT;
+		}
+		
+		dense_points X = { x, features, points };
+		return dag(X, labels);
+	}
+	
+	template<class Points>
+	int svm_predictor::dag(Points const& X, int* labels){
+		int points = X.cols();
+		if (points > 0 && labels == 0) {
+			return INVALID_INPUT;
+		}
+		
+		if (numClasses_ < 2) {
+			std::fill(labels, labels + points, numClasses_ > 0 ? model_.orderSeen[0] : 0);
+			return CORRECT;
+		}
+		
+		//Points are kept grouped by the node they reached: node j of the
+		//current level holds order[nodeStart[j]] to order[nodeStart[j+1]-1]
+		vector<int> order(points), nextOrder(points);
+		for (int i = 0; i < points; ++i) {
+			order[i] = i;
+		}
+		
+		vector<int> nodeStart(2), nextStart;
+		nodeStart[0] = 0;
+		nodeStart[1] = points;
+		
+		vector<float> decisions(points);
+		vector<pair<int, int> > work;
+		
+		for (int level = 1; level < numClasses_; ++level) {
+			//Blocks of points from every node of the level, run together
+			work.clear();
+			for (int node = 0; node < level; ++node) {
+				for (int start = nodeStart[node]; start < nodeStart[node + 1]; start += blockSize_) {
+					work.push_back(std::make_pair(node, start));
+				}
+			}
+			
+			int numWork = work.size();
+			int numThreads = std::max(1, std::min(threads(), numWork));
+			
+#pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads) if(numWork > 1)
+			for (int item = 0; item < numWork; ++item) {
+				int node = work[item].first;
+				int start = work[item].second;
+				int count = std::min(blockSize_, nodeStart[node + 1] - start);
+				Slot& slot = acquire();
+				
+				for (int i = 0; i < count; ++i) {
+					load_point(slot, i, X, order[start + i]);
+				}
+				
+				pair_block(slot, count, node, numClasses_ - level + node);
+				std::copy(slot.decisions.begin(), slot.decisions.begin() + count, decisions.begin() + start);
+				
+				for (int i = 0; i < count; ++i) {
+					clear_point(slot, i, X, order[start + i]);
+				}
+				
+				release(slot);
+			}
+			
+			//A point that wins at node j stays at node j of the next level,
+			//otherwise it moves on to node j+1
+			nextStart.assign(level + 2, 0);
+			for (int node = 0; node < level; ++node) {
+				for (int k = nodeStart[node]; k < nodeStart[node + 1]; ++k) {
+					nextStart[(decisions[k] > 0 ? node : node + 1) + 1]++;
+				}
+			}
+			
+			for (int node = 0; node <= level; ++node) {
+				nextStart[node + 1] += nextStart[node];
+			}
+			
+			vector<int> cursor(nextStart.begin(), nextStart.end() - 1);
+			for (int node = 0; node < level; ++node) {
+				for (int k = nodeStart[node]; k < nodeStart[node + 1]; ++k) {
+					nextOrder[cursor[decisions[k] > 0 ? node : node + 1]++] = order[k];
+				}
+			}
+			
+			order.swap(nextOrder);
+			nodeStart.swap(nextStart);
+		}
+		
+		for (int node = 0; node < numClasses_; ++node) {
+			for (int k = nodeStart[node]; k < nodeStart[node + 1]; ++k) {
+				labels[order[k]] = model_.orderSeen[node];
+			}
+		}
+		
+		return CORRECT;
+	}
+	
+	int svm_predictor::predict_votes(LaspSparseMatrix<float> const& X, int* labels){
+		return votes(X, labels);
+	}
+	
+	int svm_predictor::predict_votes(LaspSparseMatrix<double> const& X, int* labels){
+		return votes(X, labels);
+	}
+	
+	template<class V>
+	int svm_predictor::votes(LaspSparseMatrix<V> const& X, int* labels){
+		int points = X.cols();
+		if (points > 0 && labels == 0) {
+			return INVALID_INPUT;
+		}
+		
+		if (numClasses_ < 2) {
+			std::fill(labels, labels + points, numClasses_ > 0 ? model_.orderSeen[0] : 0);
+			return CORRECT;
+		}
+		
+		const size_t* ptr = X.colPtr();
+		const int* ind = X.rowInd();
+		const V* val = X.values();
+		
+		int numBlocks = (points + blockSize_ - 1) / blockSize_;
+		int numThreads = std::max(1, std::min(threads(), numBlocks));
+		bool linear = model_.weights.cols() > 0;
+		
+		//Kernel values are computed a block at a time, and each point reads
+		//only the pairs it needs from them. A linear model's pairs cost a
+		//pass over the point's nonzero weights, so they are all computed.
+#pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads) if(numBlocks > 1)
+		for (int block = 0; block < numBlocks; ++block) {
+			Slot& slot = acquire();
+			int start = block * blockSize_;
+			int count = std::min(blockSize_, points - start);
+			
+			if (linear) {
+				for (int col = start; col < start + count; ++col) {
+					linear_sparse(slot, ind + ptr[col], val + ptr[col], ptr[col + 1] - ptr[col], labels + col);
+				}
+			} else {
+				for (int i = 0; i < count; ++i) {
+					load_point(slot, i, X, start + i);
+				}
+				
+				classify_block(slot, count, labels + start);
+				
+				for (int i = 0; i < count; ++i) {
+					clear_point(slot, i, X, start + i);
+				}
+			}
+			
+			release(slot);
+		}
+		
+		return CORRECT;
+	}
+}
@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2014, Washington University in St. Louis
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Washington University in St. Louis nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. IN NO EVENT SHALL WASHINGTON UNIVERSITY BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LASP_PREDICTOR_H
+#define LASP_PREDICTOR_H
+
+#include "svm.h"
+
+namespace lasp {
+	
+	//Classifies single points and small batches with a one-vs-one model,
+	//for online scoring, and runs the DAG over larger test sets. Everything
+	//a call needs is set up when the predictor is built: the model's
+	//matrices are shared, not copied, and each of the threads callers that
+	//may run at once gets a scratch slot sized for one block of points. A
+	//call takes a free slot and works in it, so predict and predict_sparse
+	//do not allocate memory. Voting is the same as classify_host.
+	class svm_predictor {
+		struct Slot {
+			//Test points over the model's features (equal to base_ between
+			//calls), their squared norms, kernel values and pair decisions
+			vector<float> x, xNorm, kernel, decisions;
+			
+			//Votes and pairs left per class, and pairs done, of one point
+			vector<int> votes, left;
+			vector<char> done;
+			bool busy;
+		};
+		
+		svm_model model_;
+		int numClasses_, numPairs_, numSV_;
+		
+		//Rows of the support vectors (or weights), and how many of them test
+		//points fill, one less than modelRows_ for the pegasos bias feature
+		int modelRows_, features_;
+		int blockSize_;
+		float gamma_, coef_, degree_;
+		vector<float> offsets_;
+		
+		//What a point with no nonzero features looks like to the model: zero,
+		//or -mean/deviation when scaling, then the pegasos bias. Linear
+		//models keep its decision values.
+		vector<float> base_, scaleMean_, scaleInv_;
+		float baseNorm_;
+		vector<float> baseDecisions_;
+		
+		//Sparse support vectors by feature, so a test point only visits
+		//the entries of its nonzero features
+		vector<size_t> featurePtr_;
+		vector<int> featureSV_;
+		vector<float> featureValue_;
+		
+		vector<Slot> slots_;
+		
+		Slot& acquire();
+		void release(Slot& slot);
+		
+		//Fill column i of slot.x with a test point, and put it back to base_
+		template<class V>
+		void load_dense(Slot& slot, int i, const V* x, int features);
+		template<class V>
+		void load_sparse(Slot& slot, int i, const int* indices, const V* values, size_t nnz);
+		void clear_dense(Slot& slot, int i, int features);
+		void clear_sparse(Slot& slot, int i, const int* indices, size_t nnz);
+		
+		//Dense test points, one after another, for the routines that also
+		//take the columns of a LaspSparseMatrix
+		struct dense_points {
+			const double* x;
+			int features, points;
+			int cols() const { return points; }
+		};
+		
+		void load_point(Slot& slot, int i, dense_points const& X, int col);
+		void clear_point(Slot& slot, int i, dense_points const& X, int col);
+		template<class V>
+		void load_point(Slot& slot, int i, LaspSparseMatrix<V> const& X, int col);
+		template<class V>
+		void clear_point(Slot& slot, int i, LaspSparseMatrix<V> const& X, int col);
+		
+		template<class Points>
+		int dag(Points const& X, int* labels);
+		template<class V>
+		int votes(LaspSparseMatrix<V> const& X, int* labels);
+		
+		//Labels of the first points columns of slot.x
+		void classify_block(Slot& slot, int points, int* labels);
+		void vote(Slot& slot, int points, int* labels);
+		
+		//Labels of one sparse point of a linear model
+		template<class V>
+		void linear_sparse(Slot& slot, const int* indices, const V* values, size_t nnz, int* label);
+		
+		//Kernel values of the first points columns of slot.x against all
+		//support vectors
+		void kernel_block(Slot& slot, int points);
+		
+		//Votes one point, asking decision(pair, a, b) for one pair at a
+		//time until the winner is settled. Returns its index in orderSeen.
+		template<class Decision>
+		int vote_early(Slot& slot, Decision decision);
+		
+		//Decision values of class pair (a, b), a < b in orderSeen, for the
+		//first points columns of slot.x, from the support vectors of the
+		//two classes only
+		void pair_block(Slot& slot, int points, int a, int b);
+		
+	public:
+		//threads < 1 uses one slot per OpenMP thread. With scale, test
+		//points are standardized with the model's means and deviations
+		//before they are classified, as the DAG does. scratchBytes bounds
+		//the memory of all slots together, 0 for 4MB per slot.
+		svm_predictor(svm_model const& model, int threads, bool scale = false, size_t scratchBytes = 0);
+		
+		//Points per block in predict, and the number of slots
+		int blockSize() const { return blockSize_; }
+		int threads() const { return slots_.size(); }
+		
+		//Dense points, features per point laid out contiguously as in
+		//svm_full_data. Features the model has not seen are ignored.
+		int predict(const double* x, int features, int points, int* labels);
+		
+		//One sparse point, zero based feature indices
+		int predict_sparse(const int* indices, const double* values, int nnz, int* label);
+		
+		//DAG classification of the test points in the columns of X. Each
+		//level routes index lists over X instead of copying points, and
+		//evaluates all of its nodes at once, in blocks spread over the slots.
+		int predict_dag(LaspSparseMatrix<float> const& X, int* labels);
+		int predict_dag(LaspSparseMatrix<double> const& X, int* labels);
+		int predict_dag(const double* x, int features, int points, int* labels);
+		
+		//One-vs-one voting over the columns of X, with the same labels as
+		//predict. With a kernel model, a point stops as soon as no pair
+		//left can change its winner.
+		int predict_votes(LaspSparseMatrix<float> const& X, int* labels);
+		int predict_votes(LaspSparseMatrix<double> const& X, int* labels);
+	};
+}
+
+#endif
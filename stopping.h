@@ -48,7 +48,8 @@ namespace lasp {
 		T get_integer_step(T upper_bound, T error_thresh, T error_prob);
 		
 #ifdef CPP11
-		T get_cost_sensitive_step(T upper_bound, T error_thresh, T error_prob);
+		//seed drives the sampling of guessed errors
+		T get_cost_sensitive_step(T upper_bound, T error_thresh, T error_prob, unsigned int seed);
 #endif
 		
 		T stopping_value_gp();
@@ -210,14 +211,13 @@ T FStop<T>::get_step(LaspMatrix<T> upper_bound, bool cost, int num_cand){
 	
 #ifdef CPP11
 	template<class T>
-	T FStop<T>::get_cost_sensitive_step(T upper_bound, T error_thresh, T error_prob){
+	T FStop<T>::get_cost_sensitive_step(T upper_bound, T error_thresh, T error_prob, unsigned int seed){
 		//Hyperparameters
 		int samples = 100;
 		int num_steps = 25;
 		
 		//CPP11 random setup
-		random_device rd;
-		mt19937 gen(rd());
+		mt19937 gen(seed);
 		
 		//Get min step that meets our stopping criteria
 		int M_best = get_integer_step(upper_bound, error_thresh, error_prob);
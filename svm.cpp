@@ -28,6 +28,7 @@
 #include "svm.h"
 #include "parsing.h"
 #include "kernels.h"
+#include "kernel_cache.h"
 #include "fileIO.h"
 #include <algorithm>
 #include "lasp_matrix.h"
@@ -54,20 +55,93 @@
 #endif
 
 namespace lasp{
+	//Double precision type of the training data, for update_hess
+	template<class M> struct double_data;
+	template<class T> struct double_data<LaspMatrix<T> > { typedef LaspMatrix<double> type; };
+	template<class T> struct double_data<LaspSparseMatrix<T> > { typedef LaspSparseMatrix<double> type; };
+	
+	template<class T>
+	void load_training_data(svm_problem& p, LaspMatrix<T>& x){
+		x = training_points(p).convert<T>();
+	}
+	
+	template<class T>
+	void load_training_data(svm_problem& p, LaspSparseMatrix<T>& x){
+		x = p.xSparse.template convert<T>();
+	}
+	
+	//Support vectors for the model, dense in xS or sparse in xSparse
 	template<class T>
+	void store_support_vectors(svm_problem& p, LaspMatrix<T>& x, vector<int>& S){
+		LaspMatrix<T> xS;
+		x.gather(xS, S);
+		p.xS = xS.template getRawArrayCopy<double>();
+		p.xOwner.reset();
+	}
+	
+	template<class T>
+	void store_support_vectors(svm_problem& p, LaspSparseMatrix<T>& x, vector<int>& S){
+		LaspSparseMatrix<T> xS;
+		x.gather(xS, S);
+		p.xSparse = xS.template convert<double>();
+		p.xS = 0;
+	}
+	
+	//Backs K with an unlinked file in opt::scratchDir, which train_subset_host
+	//then streams through in panels instead of holding it all in RAM
+	template<class T>
+	bool map_kernel(svm_problem& p, LaspMatrix<T>& K){
+		size_t rows = p.options.set_size + 1;
+		size_t bytes = (size_t)p.n * rows * sizeof(T);
+		shared_ptr<void> mapping = map_scratch_file(bytes, p.options.scratchDir);
+		
+		if (!mapping) {
+			if (p.options.verb > 1) {
+				cerr << "Could not map a scratch file in " << p.options.scratchDir << ", keeping kernel in memory" << endl;
+			}
+			return false;
+		}
+		
+		K = LaspMatrix<T>::borrow(p.n, rows, static_cast<T*>(mapping.get()), mapping);
+		
+		//Panels of about 64MB, so the next one can be read in while one is used
+		p.solver.kernelPanel = max<size_t>(1, (size_t(64) << 20) / (rows * sizeof(T)));
+		
+		if (p.options.verb > 1) {
+			cout << "Kernel matrix (" << (bytes >> 20) << " MB) backed by a scratch file in " << p.options.scratchDir << endl;
+		}
+		return true;
+	}
+	
+	//Largest basis size s whose Newton matrices, plus the full kernel if it
+	//is kept in memory, fit in bytes. The Hessian, its Cholesky factor and
+	//the working copy of a Newton step are (s+1)^2 each, the kernel n(s+1).
+	template<class T>
+	int budget_set_size(svm_problem& p, size_t bytes, bool withKernel){
+		double a = 3.0 * sizeof(double);
+		double b = withKernel ? (double)p.n * sizeof(T) : 0.0;
+		double rows = (-b + std::sqrt(b * b + 4 * a * bytes)) / (2 * a);
+		return std::max(1, std::min(p.options.set_size, static_cast<int>(rows) - 1));
+	}
+	
+	//M is the type of the training data, LaspMatrix<T> or LaspSparseMatrix<T>
+	template<class T, class M>
 	int lasp_svm_host(svm_problem& p) {
 		int stopIters = 0;
 		
-		ofstream output_file("GP_TEST.csv");
-		output_file << "iteration" << "," << "SVs" << "," << "time" << "," << "error" << "," << "iter mean" << "," << "iter sd" << "," << "SV mean" << "," << "SV sd" << endl;
 		FStop<T> sv_stop_model;
 		FStop<T> iter_stop_model;
 		vector<T> iteration_costs;
 		
-		srand (time(0));
+		//Newton state starts fresh for every problem
+		p.solver.old_obj = 0;
+		p.solver.hessChol = LaspMatrix<double>();
+		p.solver.kernelPanel = 0;
+		p.solver.kernelPasses = 0;
+		p.solver.kernelPassTime = 0;
 		bool gpu = p.options.usegpu;
         
-		//Might want to move this check elsewhere (i.e. to parsing.cpp)
+		//Devices are set up by configure_devices, only read them here
 		if (gpu && DeviceContext::instance()->getNumDevices() < 1) {
 			if (p.options.verb > 1) {
 				cerr << "No CUDA device found, reverting to CPU-only version" << endl;
@@ -75,14 +149,6 @@ namespace lasp{
 			
 			p.options.usegpu = false;
 			gpu = false;
-		} else if(!gpu){
-			DeviceContext::instance()->setNumDevices(0);
-		} else if (p.options.maxGPUs > -1){
-			DeviceContext::instance()->setNumDevices(p.options.maxGPUs);
-		}
-		
-		if (p.options.unified) {
-			DeviceContext::instance()->setUseUnified(true);
 		}
         
 		//Timing Variables
@@ -101,12 +167,29 @@ namespace lasp{
 		kernelOptions.coef = p.options.coef;
 		
 		//Training examples
-		LaspMatrix<T> x = LaspMatrix<double>(p.n, p.features, p.xS).convert<T>();
+		M x;
+		load_training_data(p, x);
 		
 		//Training labels
 		LaspMatrix<T> y = LaspMatrix<double>(p.n,1,p.y).convert<T>();
         
 		LaspMatrix<T> K;
+		bool useScratch = !p.options.scratchDir.empty() && !gpu;
+		
+		//The full kernel may take half of the memory budget, or of what is free without one
+		size_t kernelLimit = p.options.memBudget > 0 ? p.options.memBudget / 2 : available_memory() / 2;
+		HostPool::instance().beginPhase("setup");
+		
+		//Under a budget, plan the basis size up front rather than wait for bad_alloc
+		if (p.options.memBudget > 0) {
+			int planned = budget_set_size<T>(p, kernelLimit, !p.options.smallKernel && !useScratch);
+			if (planned < p.options.set_size) {
+				p.options.set_size = planned;
+				if (p.options.verb > 1) {
+					cerr << "Kernel and Hessian do not fit the memory budget, reducing max training set to: " << p.options.set_size << endl;
+				}
+			}
+		}
 		
 		//Kernel is generally the largest allocation, if its allocation fails, we may need to reduce our set size
         while (p.options.set_size > 0 && !p.options.smallKernel) {
@@ -115,8 +198,18 @@ namespace lasp{
 					p.options.start_size = p.options.set_size;
 				}
 				
+				//A kernel that would crowd out everything else goes to the scratch file
+				size_t kernelBytes = (size_t)p.n * (p.options.set_size + 1) * sizeof(T);
+				if (useScratch && kernelLimit > 0 && kernelBytes > kernelLimit && map_kernel(p, K)) {
+					break;
+				}
+				
 				K.resize(p.n, p.options.set_size + 1, false, false);
 			} catch (bad_alloc) {
+				if (useScratch && map_kernel(p, K)) {
+					break;
+				}
+				
 				p.options.set_size /= 2;
 				if (p.options.verb > 1) {
 					cerr << "Kernel failed to allocate, reducing max training set to: " << p.options.set_size << endl;
@@ -176,9 +269,7 @@ namespace lasp{
 		
 		//INITIALIZE TRACE VARIABLES: tre, time, obj, betas and bs
 		LaspMatrix<T> xNorm (p.n,1, 0.0);
-		LaspMatrix<T> xS(0,0,0.0,p.options.set_size,p.features);
-		LaspMatrix<T> xnormS(0,0,0.0,p.options.set_size, 1);
-		LaspMatrix<T> xerv;
+		M xerv;
 		LaspMatrix<T> yerv;
 		LaspMatrix<T> xnormerv;
 		LaspMatrix<T> out_minus1(1,p.n);
@@ -189,19 +280,15 @@ namespace lasp{
 			error += x.transferToDevice();
 			error += y.transferToDevice();
 			error += xNorm.transferToDevice();
-			error += xS.transferToDevice();
 			error += w.transferToDevice();
 			error += out_minus1.transferToDevice();
-			error += xnormS.transferToDevice();
 			
 			if(error != MATRIX_SUCCESS){
 				x.transferToHost();
 				y.transferToHost();
 				xNorm.transferToHost();
-				xS.transferToHost();
 				w.transferToHost();
 				out_minus1.transferToHost();
-				xnormS.transferToHost();
 				
 				if (p.options.verb > 1) {
 					cerr << "Device memory insufficient for data, switching to host computation" << endl;
@@ -209,7 +296,6 @@ namespace lasp{
 				
 				gpu = false;
 				p.options.usegpu = false;
-				DeviceContext::instance()->setNumDevices(0);
                 
 			} else {
 				error = K.transferToDevice();
@@ -229,10 +315,8 @@ namespace lasp{
 		x.colSqSum(xNorm);
 		//boolean array to track what's been selected already
 		//we will fix candidates to work better later. this is a terrible hack.
-		bool alreadySelected[p.n];
-		for(int i = 0; i < p.n; ++i){
-			alreadySelected[i] = false;
-		}
+		//(kept off the stack, solver threads may have small stacks)
+		vector<char> alreadySelected(p.n, false);
 		
 		//initialize with 100 random support vectors
 		for (vector<int>::iterator r = R.begin(); r!=R.end(); ++r){
@@ -249,8 +333,14 @@ namespace lasp{
 				cand_K2_norm.transferToDevice();
 			}
 			
-			//Candidate kernel is also typically a large allocation,
-			//make sure it succeeds, reducing batch size if needed
+			//Candidate kernel is also typically a large allocation, under a
+			//budget it gets a sixteenth of it, otherwise reduce the batch size if it fails
+			HostPool::instance().beginPhase("candidates");
+			if (p.options.memBudget > 0 && !p.options.randomize) {
+				size_t batchBytes = (size_t)p.options.nb_cand * (erv->size() + 1) * sizeof(T);
+				p.options.maxcandbatch = budget_items(p.options.memBudget / 16, batchBytes, p.options.maxcandbatch);
+			}
+			
 			while (!p.options.randomize) {
 				try {
 					int error = cand_K2.resize(p.options.nb_cand * p.options.maxcandbatch, erv->size(), false, false);
@@ -280,8 +370,6 @@ namespace lasp{
 						S.push_back(i);
 						alreadySelected[i] = true;
 					}
-					xS = x.copy();
-					xnormS = xNorm.copy();
 					break;
 					
 				}
@@ -289,16 +377,11 @@ namespace lasp{
 				//Begin by selecting a hundred random basis vectors
 				if (*r == p.options.start_size && p.options.start_size != 0){
 					int set = p.options.start_size;
-				 	xS.resize(set, p.features);
-					xnormS.resize(set, 1);
 					for(int i = 1; i < set + 1; ++i){
 						int randIndex = (i*10) % p.n;
 						S.push_back(randIndex);
 						alreadySelected[randIndex] = true;
 					}
-					//gather means to chose S cols from x into xS
-					x.gather(xS, S);
-					xNorm.gather(xnormS, S);
 					break;
 				}
                 
@@ -322,7 +405,7 @@ namespace lasp{
 					
 					if (!p.options.randomize) {
 						//rows of x determined by candidates
-						LaspMatrix<T> Xc;
+						M Xc;
 						if (gpu){
 							Xc.transferToDevice();
 						}
@@ -357,7 +440,7 @@ namespace lasp{
 					candidatesCCI.push_back(candidates[ccI[i]]);
 				}
 				
-				int select = rand() % ccI.size();
+				int select = p.solver(ccI.size());
 				
 				if (!p.options.randomize) {
 					
@@ -371,7 +454,7 @@ namespace lasp{
 					cand_K2_norm.gather(cand_K2normG, ccI);
                     
 					//heuristically choose next support vector
-					select = choose_next_point<T>(kernelOptions , candidatesCCI, S, xS, xnormS, x, xNorm, p.features, w, xInd, cand_K2G, ccI.size(), erv->size(), out_minus1, out_minus1Length, p.options.C, p.options.gamma, cand_K2normG, gpu);
+					select = choose_next_point<T>(kernelOptions , candidatesCCI, S, x, xNorm, p.features, w, xInd, cand_K2G, ccI.size(), erv->size(), out_minus1, out_minus1Length, p.options.C, p.options.gamma, cand_K2normG, gpu);
 				}
 				
 				int nonSelectIndex = select;
@@ -386,12 +469,6 @@ namespace lasp{
 				
 				alreadySelected[nonSelectIndex] = true;
 				S.push_back(nonSelectIndex);
-				
-				xS.resize(d+1, p.features);
-				xnormS.resize(d+1, 1);
-				
-				xS.setCol(S.size()-1,x,S.back());
-				xnormS.setCol(S.size()-1,xNorm,S.back());
                 
 				// Move to next subgroup
 				++cc;
@@ -402,31 +479,28 @@ namespace lasp{
             
 			LaspMatrix<T> dK;
 			if (d != d0){
-				//gathers the support vectors that are new into their own vector
-				vector<int> SG;
-				for(int i= S.size()-(d-d0);i < S.size();++i){
-					SG.push_back(i);
-				}
-                
 				if (!p.options.smallKernel) {
 					K.resize(K.cols(), d+1);
                     
 					{
+						//Rows of the new basis vectors, through the kernel cache
 						LaspMatrix<T> K_new = K(0, d0+1, p.n, d+1);
-						LaspMatrix<T> xSG, xnormSG;
-						
-						xS.gather(xSG, SG);
-						xnormS.gather(xnormSG, SG);
-						K_new.getKernel(kernelOptions, xSG, xnormSG, x, xNorm);
+						LaspMatrix<T> K_rows = compute_kernel<T>(kernelOptions, x, xNorm, S.data() + d0, d - d0, x, xNorm, 0, 0, gpu);
+						K_new.copy(K_rows);
 						K_new.rowWiseMult(y);
 					}
+					
+					//The new rows touched every page of a file backed K, let them go until the next pass
+					if (p.solver.kernelPanel > 0) {
+						release_scratch(K.data(), K.cols() * K.mRows() * sizeof(T));
+					}
 				}
                 
 				//calculating Ksum
 				LaspMatrix<T> Ksum_new = Ksum(0, d0+1, 1, d+1);
 				
 				if (p.options.smallKernel) {
-					LaspMatrix<T> Kerv = compute_kernel<T>(kernelOptions, x,xNorm, erv->data(), erv->size(), xS,xnormS,SG.data(), SG.size(), gpu);
+					LaspMatrix<T> Kerv = compute_kernel<T>(kernelOptions, x, xNorm, erv->data(), erv->size(), x, xNorm, S.data() + d0, d - d0, gpu);
 					
 					LaspMatrix<T> yerv_temp;
 					y.gather(yerv_temp, *erv);
@@ -448,15 +522,17 @@ namespace lasp{
 				LaspMatrix<double> HESS_in = HESS.template convert<double>(true);
 				LaspMatrix<double> K_in = K.template convert<double>();
 				LaspMatrix<double> y_in = y.template convert<double>();
-				LaspMatrix<double> x_in = x.template convert<double>();
+				typename double_data<M>::type x_in = x.template convert<double>();
 				LaspMatrix<double> xNorm_in = xNorm.template convert<double>();
 				
+				HostPool::instance().beginPhase("hessian");
 				update_hess(p, HESS_in, K_in, erv, y_in, S, x_in, xNorm_in);
 				HESS = HESS_in.convert<T>(true);
 				sizeHESS = HESS.rows();
 				ldHESS = HESS.mRows();
 			}
 			
+			HostPool::instance().beginPhase("newton");
 			double obj2 = train_subset_host<T>( p, S, w, HESS, erv, K, Ksum, out, old_out, x_old, x_old_size, x, y, xNorm, xerv, yerv, xnormerv);
 			xInd = sizeHESS;
             
@@ -531,6 +607,12 @@ namespace lasp{
             
 			//check stopping criterion
 			
+			//Small data sets are solved with every point as a basis vector,
+			//another pass would only add the same points to S again
+			if (smallDataSet && S.size() == p.n) {
+				break;
+			}
+			
 			//Keep track of the cost of each iteration
 			if (p.time.size() == 1) {
 				iteration_costs.push_back(p.time.back());
@@ -575,7 +657,7 @@ namespace lasp{
 					r--;
 					//*(r+1) = std::min(static_cast<int>(sv_stop_model.get_step()) + 1, p.n);
 					//*(r+1) = std::min(static_cast<int>(sv_stop_model.get_step()) + 1, p.options.set_size);
-					*(r+1) = std::min(static_cast<int>(sv_stop_model.get_cost_sensitive_step(static_cast<T>(p.n) + 1, error_thresh, error_prob)) + 1, p.options.set_size);
+					*(r+1) = std::min(static_cast<int>(sv_stop_model.get_cost_sensitive_step(static_cast<T>(p.n) + 1, error_thresh, error_prob, p.solver(RAND_MAX))) + 1, p.options.set_size);
 				}
 				
 				//cout << "EI per cost: " << sv_stop_model.get_step() << endl;
@@ -617,7 +699,7 @@ namespace lasp{
 		}
 		
 		p.y = y.template getRawArrayCopy<double>();
-		p.xS = xS.template getRawArrayCopy<double>();
+		store_support_vectors(p, x, S);
 		p.S=S;
         
         //(Yu)
@@ -725,8 +807,65 @@ namespace lasp{
 		if(p.options.verb > 0){
 			cout << endl << "Training Complete" << endl;
 		}
+		
+		if(p.options.verb > 0 && p.solver.kernelPanel > 0 && !p.time.empty()){
+			cout << "Out-of-core kernel: " << p.solver.kernelPasses << " passes, " << p.solver.kernelPassTime << "s (";
+			cout << 100.0 * p.solver.kernelPassTime / max(p.time.back(), 1e-9) << "% of training)" << endl;
+		}
+		
+		if(p.options.verb > 1){
+			HostPool::instance().report(cout, "training");
+			HostPool::instance().reportPhases(cout);
+			KernelCache<T>::instance().report(cout, "training");
+		}
 		return CORRECT;
 	}
+	
+	void configure_memory(const opt& options) {
+		HostPool::instance().setBudget(options.memBudget);
+		
+		//Free blocks and cached kernel rows each get an eighth of a budget
+		if (options.memBudget > 0) {
+			HostPool::instance().setCacheLimit(std::min((size_t)1 << 30, options.memBudget / 8));
+			KernelCache<float>::instance().setLimit(std::min((size_t)256 << 20, options.memBudget / 8));
+			KernelCache<double>::instance().setLimit(std::min((size_t)256 << 20, options.memBudget / 8));
+		}
+	}
+	
+	void configure_devices(opt& options) {
+		DeviceContext* context = DeviceContext::instance();
+		
+		if (options.usegpu && context->getNumDevices() < 1) {
+			if (options.verb > 1) {
+				cerr << "No CUDA device found, reverting to CPU-only version" << endl;
+			}
+			
+			options.usegpu = false;
+		} else if (!options.usegpu) {
+			context->setNumDevices(0);
+		} else if (options.maxGPUs > -1) {
+			context->setNumDevices(options.maxGPUs);
+		}
+		
+		if (options.unified) {
+			context->setUseUnified(true);
+		}
+	}
+	
+	template<class T>
+	int lasp_svm_host(svm_problem& p) {
+		//Sparse data sets train straight from the compressed matrix, on the host
+		if (p.xSparse.cols() > 0) {
+			if (p.options.usegpu && p.options.verb > 1) {
+				cerr << "Sparse training data is only supported on the host, reverting to CPU-only version" << endl;
+			}
+			
+			p.options.usegpu = false;
+			return lasp_svm_host<T, LaspSparseMatrix<T> >(p);
+		}
+		
+		return lasp_svm_host<T, LaspMatrix<T> >(p);
+	}
   /*
     template<class T>
     void moveSVWeight(T &loss, LaspMatrix<T>& gradient, LaspMatrix<T>& params, vector<int>& selectedSVs, LaspMatrix<T>& x, LaspMatrix<T>& y, int numOfALLSVs, int numOfCompressedSVs, svm_problem& p){
@@ -1058,8 +1197,53 @@ namespace lasp{
 }
 
 
+//Copies the first n points of allData into problem.xSparse when at most
+//SPARSE_DENSITY of their entries are nonzero and the solver can train on
+//them, returns false to keep the dense path.
+static bool sparse_training_data(lasp::svm_problem& problem,
+								 vector<pair<vector<lasp::svm_node>, double> >& allData,
+								 int n)
+{
+	if (problem.options.pegasos || n == 0 || problem.features == 0) {
+		return false;
+	}
+	
+	size_t nnz = 0;
+	for (int x = 0; x < n; ++x) {
+		nnz += allData[x].first.size();
+	}
+	
+	if (nnz > SPARSE_DENSITY * n * (double)problem.features) {
+		return false;
+	}
+	
+	problem.xSparse = lasp::LaspSparseMatrix<double>(0, problem.features);
+	problem.xSparse.reserve(n, nnz);
+	
+	vector<int> ind;
+	vector<double> val;
+	for (int x = 0; x < n; ++x) {
+		ind.clear();
+		val.clear();
+		
+		//svm_nodes are indexed from 1
+		vector<lasp::svm_node>& point = allData[x].first;
+		for (int i = 0; i < point.size(); ++i) {
+			if (point[i].index > 0 && point[i].value != 0) {
+				ind.push_back(point[i].index - 1);
+				val.push_back(point[i].value);
+			}
+		}
+		
+		problem.xSparse.appendCol(ind.data(), val.data(), ind.size());
+	}
+	
+	problem.xS = 0;
+	return true;
+}
+
 void lasp::setup_svm_problem_shuffled(svm_problem& problem,
-									  svm_sparse_data myData,
+									  svm_sparse_data& myData,
 									  svm_sparse_data& holdoutData,
 									  opt options,
 									  int posClass,
@@ -1072,9 +1256,8 @@ void lasp::setup_svm_problem_shuffled(svm_problem& problem,
 		exit_with_help();
 	}
 	
-	srand (time(0));
-	
 	problem.options = options;
+	problem.solver = solver_context(options.seed);
 	problem.features = myData.numFeatures;
 	//a vector of support vectors and their associated classification
 	//in sparse form.
@@ -1098,7 +1281,7 @@ void lasp::setup_svm_problem_shuffled(svm_problem& problem,
 	
 	//now, we need to shuffle allData
 	if (problem.options.shuffle){
-		random_shuffle(allData.begin(), allData.end());
+		random_shuffle(allData.begin(), allData.end(), problem.solver);
 	}
 	//here, we pop off 30% of the data as "holdout data" to be used to
 	//accomplish platt scaling later.
@@ -1128,28 +1311,42 @@ void lasp::setup_svm_problem_shuffled(svm_problem& problem,
 	//of the two classes is 1.
 	vector<double> classificationVector;
 	
+	//Sparse points are left unscaled, centering them would fill them in
+	bool sparse = sparse_training_data(problem, allData, problem.n);
+	
 	for(int x = 0; x < problem.n; ++x) {
-		vector<double> fullDataPoint;
-		sparse_vector_to_full(fullDataPoint, allData[x].first, myData.numFeatures);
-		for(int i = 0; i < myData.numFeatures; ++i) fullDataVector.push_back(fullDataPoint[i]);
+		if (!sparse) {
+			vector<double> fullDataPoint;
+			sparse_vector_to_full(fullDataPoint, allData[x].first, myData.numFeatures);
+			for(int i = 0; i < myData.numFeatures; ++i) fullDataVector.push_back(fullDataPoint[i]);
+		}
 		if(allData[x].second == negClass)
 			classificationVector.push_back(-1);
 		else //it must be the positive class
 			classificationVector.push_back(1);
 	}
-	double_vector_to_array(problem.xS, fullDataVector);
 	double_vector_to_array(problem.y, classificationVector);
     
+    if (sparse) {
+        problem.means.assign(problem.features, 0.0);
+        problem.standardDeviations.assign(problem.features, 1.0);
+        return;
+    }
+    
+	double_vector_to_array(problem.xS, fullDataVector);
+    
     problem.means = myData.means;
     problem.standardDeviations = myData.standardDeviations;
     
-    
-    featureScaling<double>(problem.xS, problem.features, problem.n, problem.means, problem.standardDeviations);
+    //Data made from arrays has no means to scale with
+    if (problem.means.size() >= problem.features && problem.standardDeviations.size() >= problem.features) {
+        featureScaling<double>(problem.xS, problem.features, problem.n, problem.means, problem.standardDeviations);
+    }
 }
 
 
 void lasp::setup_svm_problem_shuffled(svm_problem& problem,
-									  svm_sparse_data myData,
+									  svm_sparse_data& myData,
 									  opt options,
 									  int posClass,
 									  int negClass)
@@ -1159,9 +1356,8 @@ void lasp::setup_svm_problem_shuffled(svm_problem& problem,
 		exit_with_help();
 	}
 	
-	srand (time(0));
-	
 	problem.options = options;
+	problem.solver = solver_context(options.seed);
 	problem.features = myData.numFeatures;
 	//a vector of support vectors and their associated classification
 	//in sparse form.
@@ -1187,7 +1383,7 @@ void lasp::setup_svm_problem_shuffled(svm_problem& problem,
 	
 	//now, we need to shuffle allData
 	if(problem.options.shuffle){
-		random_shuffle(allData.begin(), allData.end());
+		random_shuffle(allData.begin(), allData.end(), problem.solver);
 	}
 	
 	//now that we've shuffled everything, lets put all the data into vectors.
@@ -1197,17 +1393,23 @@ void lasp::setup_svm_problem_shuffled(svm_problem& problem,
 	//of the two classes is 1.
 	vector<double> classificationVector;
 	
+	bool sparse = sparse_training_data(problem, allData, problem.n);
+	
 	for(int x = 0; x < problem.n; ++x) {
-		vector<double> fullDataPoint;
-		sparse_vector_to_full(fullDataPoint, allData[x].first, myData.numFeatures);
-		for(int i = 0; i < myData.numFeatures; ++i) fullDataVector.push_back(fullDataPoint[i]);
+		if (!sparse) {
+			vector<double> fullDataPoint;
+			sparse_vector_to_full(fullDataPoint, allData[x].first, myData.numFeatures);
+			for(int i = 0; i < myData.numFeatures; ++i) fullDataVector.push_back(fullDataPoint[i]);
+		}
 		if(allData[x].second == negClass)
 			classificationVector.push_back(-1);
 		else //it must be the positive class
 			classificationVector.push_back(1);
 	}
 	
-	double_vector_to_array(problem.xS, fullDataVector);
+	if (!sparse) {
+		double_vector_to_array(problem.xS, fullDataVector);
+	}
 	double_vector_to_array(problem.y, classificationVector);
     
     //(Yu)
@@ -1218,6 +1420,91 @@ void lasp::setup_svm_problem_shuffled(svm_problem& problem,
     //featureScaling<double>(problem.xS, problem.features, problem.n, problem.means, problem.standardDeviations);
 }
 
+
+void lasp::setup_svm_problem_view(svm_problem& problem,
+								  svm_sparse_data& myData,
+								  opt options,
+								  int posClass,
+								  int negClass)
+{
+	problem.options = options;
+	problem.solver = solver_context(options.seed);
+	problem.features = myData.numFeatures;
+	problem.classifications.push_back(posClass);
+	problem.classifications.push_back(negClass);
+	
+	svm_data_view& view = myData.view;
+	int features = problem.features;
+	
+	//Indexes of the points of both classes, in input order
+	vector<int> points;
+	points.reserve(myData.classSize(posClass) + myData.classSize(negClass));
+	for (int i = 0; i < myData.numPoints; ++i) {
+		int label = view.y[i];
+		if (label == posClass || label == negClass) {
+			points.push_back(i);
+		}
+	}
+	
+	if (problem.options.shuffle) {
+		random_shuffle(points.begin(), points.end(), problem.solver);
+	}
+	
+	problem.n = points.size();
+	problem.y = new double[problem.n];
+	for (int x = 0; x < problem.n; ++x) {
+		problem.y[x] = int(view.y[points[x]]) == negClass ? -1 : 1;
+	}
+	
+	//All points in input order can be trained on where they are
+	bool inPlace = problem.n == myData.numPoints;
+	for (int x = 0; inPlace && x < problem.n; ++x) {
+		inPlace = points[x] == x;
+	}
+	
+	if (view.indptr) {
+		size_t nnz = 0;
+		for (int x = 0; x < problem.n; ++x) {
+			nnz += view.indptr[points[x] + 1] - view.indptr[points[x]];
+		}
+		
+		//Same choice as sparse_training_data
+		if (!problem.options.pegasos && problem.n > 0 && features > 0 && nnz <= SPARSE_DENSITY * problem.n * (double)features) {
+			LaspSparseMatrix<double> x = LaspSparseMatrix<double>::borrow(myData.numPoints, features, view.indptr, view.indices, view.values, shared_ptr<void>());
+			if (inPlace) {
+				problem.xSparse = x;
+			} else {
+				x.gather(problem.xSparse, points);
+			}
+			
+			problem.xS = 0;
+			return;
+		}
+		
+		problem.xS = new double[(size_t)problem.n * features]();
+		for (int x = 0; x < problem.n; ++x) {
+			double* out = problem.xS + (size_t)x * features;
+			for (size_t k = view.indptr[points[x]]; k < view.indptr[points[x] + 1]; ++k) {
+				out[view.indices[k]] = view.values[k];
+			}
+		}
+		return;
+	}
+	
+	//The solver only reads its training points, except when compressing
+	if (inPlace && !problem.options.compressedSVM) {
+		problem.xS = const_cast<double*>(view.x);
+		problem.xOwner = shared_ptr<void>(problem.xS, no_delete());
+		return;
+	}
+	
+	problem.xS = new double[(size_t)problem.n * features];
+	for (int x = 0; x < problem.n; ++x) {
+		const double* point = view.x + (size_t)points[x] * features;
+		std::copy(point, point + features, problem.xS + (size_t)x * features);
+	}
+}
+
 //(Yu)
 template<class T>
 void lasp::featureScaling(T* data, int numFeatures, int numPoints, vector<double>& means, vector<double>& standardDeviations){
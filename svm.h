@@ -47,6 +47,8 @@
 
 
 #define CHUNKSIZE 1000
+//Data sets at or below this fraction of nonzeros are trained sparse
+#define SPARSE_DENSITY 0.1
 #define NUM_ASYNCS 10
 
 using namespace std;
@@ -86,6 +88,32 @@ namespace lasp{
         }
     };
     
+    //Per-problem state of the solvers, kept with the svm_problem so
+    //that several problems can be trained at once in one process.
+    struct solver_context {
+        //Objective of the last accepted Newton step
+        double old_obj;
+        //Cholesky factor (lower) of the Newton Hessian, see chol_append
+        LaspMatrix<double> hessChol;
+        
+        //Points per panel when K is backed by a scratch file, 0 when in RAM
+        size_t kernelPanel;
+        //Full passes made over a file backed K, and the seconds they took
+        int kernelPasses;
+        double kernelPassTime;
+        
+        //Random choices made while training, seeded from opt::seed
+        unsigned long long state;
+        
+        solver_context(unsigned int seed = 0): old_obj(0), kernelPanel(0), kernelPasses(0), kernelPassTime(0), state(seed) {}
+        
+        //Uniform integer in [0, max), usable with random_shuffle
+        int operator()(int max) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return static_cast<int>((state >> 33) % max);
+        }
+    };
+    
     //This struct represents a two-class svm_problem that we solve with
     //the lasp_svm function.
     struct svm_problem{
@@ -96,6 +124,14 @@ namespace lasp{
         double *y;
         double *xS;
         
+        //Set when xS is borrowed from the caller (see training_points),
+        //empty when the problem owns xS
+        shared_ptr<void> xOwner;
+        
+        //Training examples in compressed columns, used instead of xS when
+        //set. After training this holds the support vectors.
+        LaspSparseMatrix<double> xSparse;
+        
         //(Yu) mean of each feature
         vector<double> means;
         //(Yu) standard deviation of each feature
@@ -104,6 +140,9 @@ namespace lasp{
         //vector of length 2 that holds the names of the classes in this problem.
         vector<int> classifications;
         
+        //Solver state, the solvers keep nothing outside of the problem
+        solver_context solver;
+        
         
         //These are set while you solve the svm_problem
         vector<int> S;
@@ -115,6 +154,15 @@ namespace lasp{
     };
     
     
+    //The dense training points of a problem, read in place when borrowed
+    inline LaspMatrix<double> training_points(svm_problem& p) {
+        if (p.xOwner) {
+            return LaspMatrix<double>::borrow(p.n, p.features, p.xS, p.xOwner);
+        }
+        return LaspMatrix<double>(p.n, p.features, p.xS);
+    }
+    
+    
     //Struct used for storing model parameters when loading a model
     //from a file.
     struct svm_model {
@@ -141,20 +189,42 @@ namespace lasp{
         
         vector<int> orderSeen;
         
-        //vector containing the offset values.
-        //maps from {class1 -> {class2 -> offset}} where class1 was seen before class2
-        map<int, map<int, double> > offsets;
-        
-        //This data structure maps {class label -> {sparse support vector -> {class label -> beta}}}
-        map<int, map<vector<svm_node>, map<int, double>, CompareSparseVectors> > modelData;
+        //Class pairs (i, j), i < j in orderSeen, are numbered row by row,
+        //see class_pair_index. These hold the offset and the platt
+        //scaling A,B pair of each.
+        vector<double> offsets;
         
         //Does this model incorporate platt scaling?
         int plattScale;
-        //This struct keeps track of the A,B pairs for each trained sigmoid for platt scaling
-        map<int, map<int, pair<double, double> > > plattScaleCoefs;
+        vector<pair<double, double> > plattScaleCoefs;
+        
+        //Each support vector is stored once, grouped by class in orderSeen
+        //order: class i owns columns classStart[i] to classStart[i+1]-1.
+        vector<int> classStart;
         
+        //One column per support vector, in xSparse when the support
+        //vectors are sparse (see set_support_vectors) and in xS otherwise.
+        LaspMatrix<float> xS;
+        LaspSparseMatrix<float> xSparse;
+        LaspMatrix<float> xSNorm;
+        
+        //Row p holds the weight of every support vector in the model of
+        //class pair p, zero for support vectors of the other classes.
+        LaspMatrix<float> betas;
+        
+        //Linear models only (see set_linear_weights): row p is the weight
+        //vector of class pair p, betas times the support vectors, with
+        //one column per feature. Empty for other kernels.
+        LaspMatrix<float> weights;
+        
+        int numSupportVectors() const { return classStart.empty() ? 0 : classStart.back(); }
     };
     
+    //Row of class pair (i, j), i < j, among the pairs of numClasses classes
+    inline int class_pair_index(int i, int j, int numClasses) {
+        return i * (2 * numClasses - i - 1) / 2 + (j - i - 1);
+    }
+    
     //a binary svm model, meaning a 1 vs1 classification model.
     struct svm_binary_model {
         //The type of kernel used in this model
@@ -209,6 +279,25 @@ namespace lasp{
     };
     
     
+    //Points left in the caller's buffers, see create_data_view. Dense points
+    //lie one after another as in svm_full_data, sparse ones are compressed
+    //rows (indptr, indices, values) with zero based feature indices. y is
+    //null for test data.
+    struct svm_data_view {
+        const double* x;
+        const size_t* indptr;
+        const int* indices;
+        const double* values;
+        const double* y;
+        
+        //Number of points of each label in y
+        map<int, int> counts;
+        
+        svm_data_view(): x(0), indptr(0), indices(0), values(0), y(0) {}
+        
+        bool empty() const { return x == 0 && indptr == 0; }
+    };
+    
     //Struct that holds the sparse version of all the data.
     struct svm_sparse_data {
         //allData is a map that maps from
@@ -239,6 +328,13 @@ namespace lasp{
         bool multiClass;
         
         int numPoints;
+        
+        //Set when the points stay in the caller's buffers, allData is
+        //then empty
+        svm_data_view view;
+        
+        //Number of points of class label
+        int classSize(int label) { return view.empty() ? allData[label].size() : view.counts[label]; }
     };
     
     //struct used for keeping track of timing
@@ -256,6 +352,12 @@ namespace lasp{
     
     template<class T>
     int lasp_svm_host(svm_problem&);
+    
+    //Applies the GPU options to the process wide DeviceContext. Call it
+    //once before training, the solvers only read the context.
+    void configure_devices(opt& options);
+    //Sizes the host pool and kernel cache to opt::memBudget, also once before training
+    void configure_memory(const opt& options);
     //The timed version of the above function
     
     void tempOutputCheck(svm_node**,double*);
@@ -275,7 +377,7 @@ namespace lasp{
     //holdout data, which is NOT used for training the SVM,
     //but rather for training the sigmoid later.
     void setup_svm_problem_shuffled(svm_problem& problem,
-                                    svm_sparse_data myData,
+                                    svm_sparse_data& myData,
                                     svm_sparse_data& holdoutData,
                                     opt options,
                                     int negClass,
@@ -283,11 +385,21 @@ namespace lasp{
     
     //Non platt-scale version of the above method.
     void setup_svm_problem_shuffled(svm_problem& problem,
-                                    svm_sparse_data myData,
+                                    svm_sparse_data& myData,
                                     opt options,
                                     int negClass,
                                     int posClass);
     
+    //Sets up the problem of two classes of a data view, like the method
+    //above, with the points in input order before shuffling. The points are
+    //gathered straight from the caller's buffers, or used in place when the
+    //problem takes all of them in input order.
+    void setup_svm_problem_view(svm_problem& problem,
+                                svm_sparse_data& myData,
+                                opt options,
+                                int posClass,
+                                int negClass);
+    
     //(Yu)
     // This method normalizes the data's features
     template<class T>
@@ -140,6 +140,9 @@ int main(int argc, char* argv[]){
 	//tracks holdout data, which is used for platt scaling later.
 	vector<lasp::svm_sparse_data> holdouts;
 	
+	lasp::configure_devices(options);
+	lasp::configure_memory(options);
+	
 	for(int i = 0; i < myData.orderSeen.size(); ++i) {
 		for(int j = i+1; j < myData.orderSeen.size(); ++j) {
 			int firstClass = myData.orderSeen[i];
@@ -27,8 +27,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "train_subset.h"
 #include "kernels.h"
+#include "hessian.h"
 #include "svm.h"
 #include <iomanip>
+#include <algorithm>
+
+#ifdef CPP11
+#include <chrono>
+#endif
 
 namespace lasp {
   vector<int> mysetdiff(vector<int>& a, vector<int>& b){
@@ -57,10 +63,69 @@ namespace lasp {
     
     return d;
   }
+  
+  //Basis vectors per kernel chunk when K is not kept. Each chunk holds two
+  //p.n column blocks, under a budget they get an eighth of it.
+  template<class T>
+  int small_kernel_chunk(svm_problem& p, int numBasis){
+    if (p.options.memBudget > 0) {
+      return budget_items(p.options.memBudget / 8, 2 * (size_t)p.n * sizeof(T), numBasis);
+    }
+    
+    return 1 + (((2 * p.options.set_size * p.options.set_size) - 1) / p.n);
+  }
+  
+  //out = K' * x. A K backed by a scratch file (see map_kernel) is walked in
+  //panels of points: the next panel is read in while this one is multiplied,
+  //and finished panels are dropped so K never has to be resident at once.
+  template<class T>
+  void kernel_pass(svm_problem& p, LaspMatrix<T> out, LaspMatrix<T> K, LaspMatrix<T> x){
+    kernel_opt tempOpt;
+    size_t panel = p.solver.kernelPanel;
+    
+    if (panel == 0 || K.device()) {
+      out.getKernel(tempOpt, K, x, true);
+      return;
+    }
+    
+#ifdef CPP11
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+#else
+    time_t start = time(0);
+#endif
+    
+    size_t n = K.cols();
+    size_t colBytes = K.mRows() * sizeof(T);
+    prefetch_scratch(K.data(), std::min(panel, n) * colBytes);
+    
+    for (size_t c0 = 0; c0 < n; c0 += panel) {
+      size_t c1 = std::min(n, c0 + panel);
+      if (c1 < n) {
+        prefetch_scratch(K.data() + c1 * K.mRows(), (std::min(n, c1 + panel) - c1) * colBytes);
+      }
+      
+      LaspMatrix<T> K_panel = K(c0, 0, c1, K.rows());
+      LaspMatrix<T> out_panel;
+      out_panel.getKernel(tempOpt, K_panel, x, true);
+      
+      LaspMatrix<T> out_sub = out(0, c0, 1, c1);
+      out_sub.copy(out_panel);
+      
+      release_scratch(K.data() + c0 * K.mRows(), (c1 - c0) * colBytes);
+    }
+    
+#ifdef CPP11
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    p.solver.kernelPassTime += elapsed.count();
+#else
+    p.solver.kernelPassTime += difftime(time(0), start);
+#endif
+    p.solver.kernelPasses++;
+  }
 }
 
-template<class T>
-double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x, LaspMatrix<T> HESS, vector<int>* & erv, LaspMatrix<T> K, LaspMatrix<T> Ksum, LaspMatrix<T> out, LaspMatrix<T>& old_out, LaspMatrix<T> &x_old, int& x_old_size, LaspMatrix<T> dX, LaspMatrix<T> dY, LaspMatrix<T> dXnorm,  LaspMatrix<T>& dXerv, LaspMatrix<T>& dYerv, LaspMatrix<T>& dXnormerv){
+template<class T, class M>
+double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x, LaspMatrix<T> HESS, vector<int>* & erv, LaspMatrix<T> K, LaspMatrix<T> Ksum, LaspMatrix<T> out, LaspMatrix<T>& old_out, LaspMatrix<T> &x_old, int& x_old_size, M dX, LaspMatrix<T> dY, LaspMatrix<T> dXnorm,  M& dXerv, LaspMatrix<T>& dYerv, LaspMatrix<T>& dXnormerv){
 		
 	//kernel options struct for computing the kernel
 	kernel_opt kernelOptions;
@@ -76,7 +141,7 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 
 	double C = p.options.C;
 	double obj = std::numeric_limits<double>::max();
-	static double old_obj;
+	double& old_obj = p.solver.old_obj;
 	int iter = 0;
 	int d = HESS.rows();
 	
@@ -109,7 +174,7 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 			out2.getKernel(tempOpt_out2, dY, x, true);
 			
 		} else {
-			int maxElem = 1 + (((2 * p.options.set_size * p.options.set_size) - 1) / p.n);
+			int maxElem = small_kernel_chunk<T>(p, S.size());
 			int numChunks = 1 + ((S.size() - 1) / maxElem);
 			int chunkStart = 0;
 
@@ -144,8 +209,7 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 			}
 		}
 	} else {
-		kernel_opt tempOpt_out2;
-		out2.getKernel(tempOpt_out2, K, x, true);
+		kernel_pass(p, out2, K, x);
 	}
 	
 	vector<int> *erv2 = new vector<int>();
@@ -277,10 +341,29 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 			ksubs.multiply(ksubs,adds_and_subs,true,false,negC,1.0);
 		}
 
+		//Border the factor out to basis vectors added since the last step,
+		//unless the erv changed so much that refactoring is cheaper
+		LaspMatrix<double>& L = p.solver.hessChol;
+		bool incremental = !gpu && L.rows() > 0 && L.rows() <= d && (erv_adds.size() + erv_subs.size()) * 16 <= d;
+		
+		if (incremental && L.rows() < d) {
+			incremental = chol_append(L, HESS.template convert<double>(), d);
+		}
+		
 		{
 			LaspMatrix<T> add_and_subs_Generic = adds_and_subs.template convert<T>();
 			HESS.add(add_and_subs_Generic);
 		}
+		
+		//The diagonal jitter below is left out of the factor, it only
+		//matters on refactoring
+		if (incremental && erv_adds.size() > 0) {
+			incremental = chol_update(L, kadds, C);
+		}
+		
+		if (incremental && erv_subs.size() > 0) {
+			incremental = chol_update(L, ksubs, negC);
+		}
 
 		{
 			LaspMatrix<T> HESS_diag = HESS.diag();
@@ -300,30 +383,35 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 			x_d.copy(Ksum_d);
 		}
 
+		LaspMatrix<double> dx = x.template convert<double>();
+		bool solve_error = incremental ? L.cholSolve(dx) : true;
+		
 		LaspMatrix<T> HESS_CPY;
 		if (gpu) {
 			HESS_CPY.transferToDevice();
 		}
 		
-		HESS_CPY.copy(HESS);
-
-		LaspMatrix<double> dHESS_CPY = HESS_CPY.template convert<double>();
-		LaspMatrix<double> dx = x.template convert<double>();
-		
-		//Short circuting Cholesky solve
-		bool solve_error = dHESS_CPY.chol() || dHESS_CPY.cholSolve(dx);
+		//Short circuting Cholesky solve, the factor is kept for the next step
+		if (solve_error) {
+			HESS_CPY.copy(HESS);
+			
+			L = HESS_CPY.template convert<double>();
+			dx = x.template convert<double>();
+			
+			solve_error = L.chol() || L.cholSolve(dx);
+		}
 		
 		//Retry with LU decomposition on failure
 		if (solve_error) {
 			HESS_CPY.copy(HESS);
 			
-			dHESS_CPY = HESS_CPY.template convert<double>();
+			LaspMatrix<double> dHESS_CPY = HESS_CPY.template convert<double>();
 			dx = x.template convert<double>();
 			
 			dHESS_CPY.solve(dx);
+			L = LaspMatrix<double>();
 		}
 
-		HESS_CPY = dHESS_CPY.template convert<T>();
 		x = dx.template convert<T>();
 		
 		LaspMatrix<T> step = LaspMatrix<T>(1,d);
@@ -342,7 +430,7 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 				delta_out.getKernel(tempOpt_delta_out, dY, step, true);
 
 			} else {
-				int maxElem = 1 + (((2 * p.options.set_size * p.options.set_size) - 1) / p.n);
+				int maxElem = small_kernel_chunk<T>(p, S.size());
 				int numChunks = 1 + ((S.size() - 1) / maxElem);
 				int chunkStart = 0;
 
@@ -372,10 +460,7 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 				}
 			}
 		} else {
-
-			kernel_opt tempOpt_delta_out;
-			delta_out.getKernel(tempOpt_delta_out, K, step, true);
-
+			kernel_pass(p, delta_out, K, step);
 		}
 						
 		int iii;
@@ -429,7 +514,7 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 		}
 
 		if ((old_erv->size()==erv->size() && mysetdiff(*old_erv,*erv).empty()) || obj != obj || (iter > 5 && iii > p.options.maxiter)){
-			dXerv = LaspMatrix<T>(erv->size(), p.features);
+			dXerv = M(erv->size(), p.features);
 			dYerv = LaspMatrix<T>(1, erv->size());
 			dXnormerv = LaspMatrix<T>(1, erv->size());
 			
@@ -450,8 +535,8 @@ double lasp::train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x,
 }
 
 //calculates the value of the objective function we are trying to minimize
-template<class T>
-void lasp::calculate_obj(double& obj, vector<int> S, int d, LaspMatrix<T> x, LaspMatrix<T> K, LaspMatrix<T> out, vector<int>* erv, T C, LaspMatrix<T> dY, LaspMatrix<T> dX, LaspMatrix<T> dXnorm, svm_problem& p, LaspMatrix<T> K_S_in){
+template<class T, class M>
+void lasp::calculate_obj(double& obj, vector<int> S, int d, LaspMatrix<T> x, LaspMatrix<T> K, LaspMatrix<T> out, vector<int>* erv, T C, LaspMatrix<T> dY, M dX, LaspMatrix<T> dXnorm, svm_problem& p, LaspMatrix<T> K_S_in){
 	obj = 0.0;
 	LaspMatrix<T> xTemp(1, d-1, 0.0);
 
@@ -501,8 +586,12 @@ void lasp::calculate_obj(double& obj, vector<int> S, int d, LaspMatrix<T> x, Las
 	obj *= .5;
 }
 
-template double lasp::train_subset_host<float>(svm_problem& p, vector<int> S, LaspMatrix<float> & x, LaspMatrix<float> HESS, vector<int>* & erv, LaspMatrix<float> K, LaspMatrix<float> Ksum, LaspMatrix<float> out, LaspMatrix<float>& old_out, LaspMatrix<float> &x_old, int& x_old_size, LaspMatrix<float> dX, LaspMatrix<float> dY, LaspMatrix<float> dXnorm,  LaspMatrix<float>& dXerv, LaspMatrix<float>& dYerv, LaspMatrix<float>& dXnormerv);
-template double lasp::train_subset_host<double>(svm_problem& p, vector<int> S, LaspMatrix<double> & x, LaspMatrix<double> HESS, vector<int>* & erv, LaspMatrix<double> K, LaspMatrix<double> Ksum, LaspMatrix<double> out, LaspMatrix<double>& old_out, LaspMatrix<double> &x_old, int& x_old_size, LaspMatrix<double> dX, LaspMatrix<double> dY, LaspMatrix<double> dXnorm,  LaspMatrix<double>& dXerv, LaspMatrix<double>& dYerv, LaspMatrix<double>& dXnormerv);
+template double lasp::train_subset_host<float, lasp::LaspMatrix<float> >(svm_problem& p, vector<int> S, LaspMatrix<float> & x, LaspMatrix<float> HESS, vector<int>* & erv, LaspMatrix<float> K, LaspMatrix<float> Ksum, LaspMatrix<float> out, LaspMatrix<float>& old_out, LaspMatrix<float> &x_old, int& x_old_size, LaspMatrix<float> dX, LaspMatrix<float> dY, LaspMatrix<float> dXnorm,  LaspMatrix<float>& dXerv, LaspMatrix<float>& dYerv, LaspMatrix<float>& dXnormerv);
+template double lasp::train_subset_host<double, lasp::LaspMatrix<double> >(svm_problem& p, vector<int> S, LaspMatrix<double> & x, LaspMatrix<double> HESS, vector<int>* & erv, LaspMatrix<double> K, LaspMatrix<double> Ksum, LaspMatrix<double> out, LaspMatrix<double>& old_out, LaspMatrix<double> &x_old, int& x_old_size, LaspMatrix<double> dX, LaspMatrix<double> dY, LaspMatrix<double> dXnorm,  LaspMatrix<double>& dXerv, LaspMatrix<double>& dYerv, LaspMatrix<double>& dXnormerv);
+template double lasp::train_subset_host<float, lasp::LaspSparseMatrix<float> >(svm_problem& p, vector<int> S, LaspMatrix<float> & x, LaspMatrix<float> HESS, vector<int>* & erv, LaspMatrix<float> K, LaspMatrix<float> Ksum, LaspMatrix<float> out, LaspMatrix<float>& old_out, LaspMatrix<float> &x_old, int& x_old_size, LaspSparseMatrix<float> dX, LaspMatrix<float> dY, LaspMatrix<float> dXnorm,  LaspSparseMatrix<float>& dXerv, LaspMatrix<float>& dYerv, LaspMatrix<float>& dXnormerv);
+template double lasp::train_subset_host<double, lasp::LaspSparseMatrix<double> >(svm_problem& p, vector<int> S, LaspMatrix<double> & x, LaspMatrix<double> HESS, vector<int>* & erv, LaspMatrix<double> K, LaspMatrix<double> Ksum, LaspMatrix<double> out, LaspMatrix<double>& old_out, LaspMatrix<double> &x_old, int& x_old_size, LaspSparseMatrix<double> dX, LaspMatrix<double> dY, LaspMatrix<double> dXnorm,  LaspSparseMatrix<double>& dXerv, LaspMatrix<double>& dYerv, LaspMatrix<double>& dXnormerv);
 
-template void lasp::calculate_obj<float>(double& obj, vector<int> S, int d, LaspMatrix<float> x, LaspMatrix<float> K, LaspMatrix<float> out, vector<int>* erv, float C, LaspMatrix<float> dY, LaspMatrix<float> dX, LaspMatrix<float> dXnorm, svm_problem& p, LaspMatrix<float> K_S_in);
-template void lasp::calculate_obj<double>(double& obj, vector<int> S, int d, LaspMatrix<double> x, LaspMatrix<double> K, LaspMatrix<double> out, vector<int>* erv, double C, LaspMatrix<double> dY, LaspMatrix<double> dX, LaspMatrix<double> dXnorm, svm_problem& p, LaspMatrix<double> K_S_in);
+template void lasp::calculate_obj<float, lasp::LaspMatrix<float> >(double& obj, vector<int> S, int d, LaspMatrix<float> x, LaspMatrix<float> K, LaspMatrix<float> out, vector<int>* erv, float C, LaspMatrix<float> dY, LaspMatrix<float> dX, LaspMatrix<float> dXnorm, svm_problem& p, LaspMatrix<float> K_S_in);
+template void lasp::calculate_obj<double, lasp::LaspMatrix<double> >(double& obj, vector<int> S, int d, LaspMatrix<double> x, LaspMatrix<double> K, LaspMatrix<double> out, vector<int>* erv, double C, LaspMatrix<double> dY, LaspMatrix<double> dX, LaspMatrix<double> dXnorm, svm_problem& p, LaspMatrix<double> K_S_in);
+template void lasp::calculate_obj<float, lasp::LaspSparseMatrix<float> >(double& obj, vector<int> S, int d, LaspMatrix<float> x, LaspMatrix<float> K, LaspMatrix<float> out, vector<int>* erv, float C, LaspMatrix<float> dY, LaspSparseMatrix<float> dX, LaspMatrix<float> dXnorm, svm_problem& p, LaspMatrix<float> K_S_in);
+template void lasp::calculate_obj<double, lasp::LaspSparseMatrix<double> >(double& obj, vector<int> S, int d, LaspMatrix<double> x, LaspMatrix<double> K, LaspMatrix<double> out, vector<int>* erv, double C, LaspMatrix<double> dY, LaspSparseMatrix<double> dX, LaspMatrix<double> dXnorm, svm_problem& p, LaspMatrix<double> K_S_in);
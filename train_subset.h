@@ -34,10 +34,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace lasp
 {
 
-template<class T>
-double train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x, LaspMatrix<T> HESS, vector<int>* & erv, LaspMatrix<T> K, LaspMatrix<T> Ksum, LaspMatrix<T> out, LaspMatrix<T>& old_out, LaspMatrix<T> &x_old, int& x_old_size, LaspMatrix<T> dX, LaspMatrix<T> dY, LaspMatrix<T> dXnorm,  LaspMatrix<T>& dXerv, LaspMatrix<T>& dYerv, LaspMatrix<T>& dXnormerv );
+//M is the type of the training data, LaspMatrix<T> or LaspSparseMatrix<T>
+template<class T, class M>
+double train_subset_host(svm_problem& p, vector<int> S, LaspMatrix<T> & x, LaspMatrix<T> HESS, vector<int>* & erv, LaspMatrix<T> K, LaspMatrix<T> Ksum, LaspMatrix<T> out, LaspMatrix<T>& old_out, LaspMatrix<T> &x_old, int& x_old_size, M dX, LaspMatrix<T> dY, LaspMatrix<T> dXnorm,  M& dXerv, LaspMatrix<T>& dYerv, LaspMatrix<T>& dXnormerv );
  
-template<class T>
- void calculate_obj(double& obj, vector<int> S, int d, LaspMatrix<T> x, LaspMatrix<T> K, LaspMatrix<T> out, vector<int>* erv, T C, LaspMatrix<T> dY, LaspMatrix<T> dX, LaspMatrix<T> dXnorm, svm_problem& p, LaspMatrix<T> K_S_in);
+template<class T, class M>
+ void calculate_obj(double& obj, vector<int> S, int d, LaspMatrix<T> x, LaspMatrix<T> K, LaspMatrix<T> out, vector<int>* erv, T C, LaspMatrix<T> dY, M dX, LaspMatrix<T> dXnorm, svm_problem& p, LaspMatrix<T> K_S_in);
 }
 #endif
@@ -32,6 +32,8 @@
 #include "pegasos.h"
 #include "getopt.h"
 #include "predict.h"
+#include "multiclass.h"
+#include "predictor.h"
 #include <algorithm>
 
 #ifdef _OPENMP
@@ -40,6 +42,49 @@
 
 using namespace lasp;
 
+//What a wusvm_context holds: the settings of calls made through it and one
+//predictor per model and classification mode, which is their scratch memory.
+struct svm_context {
+	int threads;
+	size_t memBudget;
+	map<pair<void*, bool>, svm_predictor*> predictors;
+	
+	svm_context(int threadsIn, size_t memBudgetIn) : threads(threadsIn), memBudget(memBudgetIn) {}
+	
+	~svm_context() {
+		for (map<pair<void*, bool>, svm_predictor*>::iterator iter = predictors.begin(); iter != predictors.end(); ++iter) {
+			delete iter->second;
+		}
+	}
+	
+	//Models are told apart by the storage of their betas, which the predictor
+	//shares, so a key is never reused while its predictor is cached.
+	svm_predictor& predictor(svm_model const& model, bool dag) {
+		svm_predictor* result = 0;
+#pragma omp critical(lasp_context)
+		{
+			svm_predictor*& cached = predictors[make_pair(model.betas.key(), dag)];
+			if (cached == 0) {
+				try {
+					cached = new svm_predictor(model, threads, dag, memBudget);
+				} catch (std::bad_alloc) {
+					cached = 0;
+				}
+			}
+			result = cached;
+		}
+		
+		if (result == 0) {
+			throw std::bad_alloc();
+		}
+		return *result;
+	}
+	
+private:
+	svm_context(svm_context const&);
+	svm_context& operator=(svm_context const&);
+};
+
 int create_data_from_array(wusvm_data* svm_data, double* x, double* y, int features, int points){
 	svm_full_data full;
 	
@@ -93,6 +138,74 @@ int create_test_data_from_array(wusvm_data* svm_data, double* x, int features, i
 }
 
 
+//Labels of a view, which its classes are taken from
+static void view_labels(svm_sparse_data& data, const double* y){
+	data.view.y = y;
+	if (y) {
+		for (int i = 0; i < data.numPoints; ++i) {
+			data.view.counts[int(y[i])]++;
+		}
+	}
+	
+	for (map<int, int>::iterator iter = data.view.counts.begin(); iter != data.view.counts.end(); ++iter) {
+		data.orderSeen.push_back(iter->first);
+	}
+	
+	data.multiClass = data.orderSeen.size() > 2;
+}
+
+
+int create_data_view(wusvm_data* svm_data, const double* x, const double* y, int features, int points){
+	if (!svm_data || features < 0 || points < 0 || (points > 0 && features > 0 && !x)) {
+		return ARGUMENT_ERROR;
+	}
+	
+	svm_sparse_data* data = new svm_sparse_data;
+	data->numFeatures = features;
+	data->numPoints = points;
+	data->view.x = x;
+	view_labels(*data, y);
+	
+	*svm_data = reinterpret_cast<wusvm_data>(data);
+	return NO_ERROR;
+}
+
+
+int create_sparse_data_view(wusvm_data* svm_data, const size_t* indptr, const int* indices, const double* values, const double* y, int features, int points){
+	if (!svm_data || !indptr || features < 0 || points < 0 || indptr[0] != 0) {
+		return ARGUMENT_ERROR;
+	}
+	
+	if (indptr[points] > 0 && (!indices || !values)) {
+		return ARGUMENT_ERROR;
+	}
+	
+	//Everything downstream trusts the offsets and indices
+	for (int i = 0; i < points; ++i) {
+		if (indptr[i + 1] < indptr[i]) {
+			return ARGUMENT_ERROR;
+		}
+	}
+	
+	for (size_t k = 0; k < indptr[points]; ++k) {
+		if (indices[k] < 0 || indices[k] >= features) {
+			return ARGUMENT_ERROR;
+		}
+	}
+	
+	svm_sparse_data* data = new svm_sparse_data;
+	data->numFeatures = features;
+	data->numPoints = points;
+	data->view.indptr = indptr;
+	data->view.indices = indices;
+	data->view.values = values;
+	view_labels(*data, y);
+	
+	*svm_data = reinterpret_cast<wusvm_data>(data);
+	return NO_ERROR;
+}
+
+
 int create_data_from_file(wusvm_data* svm_data, const char* file){
 	svm_sparse_data* data = new svm_sparse_data;
 	
@@ -191,11 +304,15 @@ int set_options(wusvm_options svm_options, int optCount, char** optArgs){
 		{"no_cache", no_argument, 0, 'K'},
 		{"dag", no_argument, 0, 'D'},
 		{"contigify_kernel", no_argument, 0, 't'},
-		{"maxgpus", required_argument, 0, 'y'}
+		{"maxgpus", required_argument, 0, 'y'},
+		{"seed", required_argument, 0, 'R'},
+		{"scratch", required_argument, 0, 'Z'},
+		{"mem-budget", required_argument, 0, 'M'},
+		{0, 0, 0, 0}
 	};
 	
 	
-	while((c = getopt_long(optCount, optArgs, "n:s:i:y:b:v:t:m:x:a:pj:g:c:k:r:d:o:huqflw:eS:KT:ODI", long_options, 0)) != -1)
+	while((c = getopt_long(optCount, optArgs, "n:s:i:y:b:v:t:m:x:a:pj:g:c:k:r:d:o:huqflw:eS:KT:ODIR:Z:M:", long_options, 0)) != -1)
 		switch(c)
 	{
 		case 'n':
@@ -284,6 +401,21 @@ int set_options(wusvm_options svm_options, int optCount, char** optArgs){
 				return ARGUMENT_ERROR;
 			options.coef = floatVal;
 			break;
+		case 'R':
+			intVal = strtol(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || intVal < 0)
+				return ARGUMENT_ERROR;
+			options.seed = intVal;
+			break;
+		case 'Z':
+			options.scratchDir = optarg;
+			break;
+		case 'M':
+			intVal = strtol(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || intVal < 0)
+				return ARGUMENT_ERROR;
+			options.memBudget = (size_t)intVal << 20;
+			break;
 		case 'd':
 			floatVal = strtof(optarg, &end);
 			if(end == optarg || *end != '\0' || floatVal < 0)
@@ -416,6 +548,18 @@ int set_option_int(wusvm_options svm_options, char option, int value){
 				return ARGUMENT_ERROR;
 			options.maxnewbasis = intVal;
 			break;
+		case 'R':
+			intVal = value;
+			if(intVal < 0)
+				return ARGUMENT_ERROR;
+			options.seed = intVal;
+			break;
+		case 'M':
+			intVal = value;
+			if(intVal < 0)
+				return ARGUMENT_ERROR;
+			options.memBudget = (size_t)intVal << 20;
+			break;
 		case 'T':
 			intVal = value;
 			if(intVal <= 0)
@@ -560,8 +704,25 @@ int free_options(wusvm_options svm_options){
 
 int fit_model(wusvm_model* model, wusvm_data svm_data, wusvm_options svm_options){
 	opt* options_ptr = reinterpret_cast<opt*>(svm_options);
+	
+	if (!options_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	svm_context context(0, options_ptr->memBudget);
+	return fit_model_in_context(reinterpret_cast<wusvm_context>(&context), model, svm_data, svm_options);
+}
+
+
+int fit_model_in_context(wusvm_context context, wusvm_model* model, wusvm_data svm_data, wusvm_options svm_options){
+	svm_context* context_ptr = reinterpret_cast<svm_context*>(context);
+	opt* options_ptr = reinterpret_cast<opt*>(svm_options);
 	svm_sparse_data* data_ptr = reinterpret_cast<svm_sparse_data*>(svm_data);
 	
+	if (!context_ptr) {
+		return TYPE_ERROR;
+	}
+	
 	if (!options_ptr) {
 		return TYPE_ERROR;
 	}
@@ -570,9 +731,31 @@ int fit_model(wusvm_model* model, wusvm_data svm_data, wusvm_options svm_options
 		return TYPE_ERROR;
 	}
 	
-	opt& options = *options_ptr;
-	svm_sparse_data& myData = *data_ptr;
+	if (!model) {
+		return ARGUMENT_ERROR;
+	}
+	
+	//Parameter search writes its choices here, not in the caller's options
+	opt options = *options_ptr;
+	if (context_ptr->memBudget > 0) {
+		options.memBudget = context_ptr->memBudget;
+	}
+	
+	svm_sparse_data* train_ptr = data_ptr;
 	
+	if (!data_ptr->view.empty() && !data_ptr->view.y) {
+		return ARGUMENT_ERROR;
+	}
+	
+	//Parameter search and holdout sets only read allData
+	svm_sparse_data copied;
+	if (!data_ptr->view.empty() && (options.optimize || options.plattScale)) {
+		copied = *data_ptr;
+		view_to_sparse(copied);
+		train_ptr = &copied;
+	}
+	
+	svm_sparse_data& myData = *train_ptr;
 	
 	svm_time_recorder recorder;
 
@@ -584,63 +767,27 @@ int fit_model(wusvm_model* model, wusvm_data svm_data, wusvm_options svm_options
 	//tracks holdout data, which is used for platt scaling later.
 	vector<svm_sparse_data> holdouts;
 	
-	for(int i = 0; i < myData.orderSeen.size(); ++i) {
-		for(int j = i+1; j < myData.orderSeen.size(); ++j) {
-			int firstClass = myData.orderSeen[i];
-			int secondClass = myData.orderSeen[j];
-			
-			if(options.verb > 0) {
-				cout << "Training " << firstClass << " v. " << secondClass << " classifier" << endl;
-			}
-			
-			if(options.plattScale) {
-				svm_sparse_data holdoutData;
-				svm_problem curProblem = get_onevsone_subproblem(myData,
-																			 holdoutData,
-																			 firstClass,
-																			 secondClass,
-																			 options);
-				if (options.single) {
-					if (options.pegasos) {
-						pegasos_svm_host<float>(curProblem);
-					} else {
-						lasp_svm_host<float>(curProblem);
-					}
-					
-				} else {
-					if (options.pegasos) {
-						pegasos_svm_host<double>(curProblem);
-					} else {
-						lasp_svm_host<double>(curProblem);
-					}
-				}
-				
-				solvedProblems.push_back(curProblem);
-				holdouts.push_back(holdoutData);
-			}
-			else {
-				svm_problem curProblem = get_onevsone_subproblem(myData,
-																			 firstClass,
-																			 secondClass,
-																			 options);
-				if (options.single) {
-					if (options.pegasos) {
-						pegasos_svm_host<float>(curProblem);
-					} else {
-						lasp_svm_host<float>(curProblem);
-					}
-					
-				} else {
-					if (options.pegasos) {
-						pegasos_svm_host<double>(curProblem);
-					} else {
-						lasp_svm_host<double>(curProblem);
-					}
-				}
-				
-				solvedProblems.push_back(curProblem);
-			}
-		}
+#ifdef _OPENMP
+	//The thread count is per calling thread, so other callers keep theirs
+	int oldThreads = omp_get_max_threads();
+	if (context_ptr->threads > 0) {
+		omp_set_num_threads(context_ptr->threads);
+	}
+#endif
+	
+	int error = CORRECT;
+	if (options.single) {
+		error = train_onevsone<float>(myData, options, solvedProblems, options.plattScale ? &holdouts : 0);
+	} else {
+		error = train_onevsone<double>(myData, options, solvedProblems, options.plattScale ? &holdouts : 0);
+	}
+	
+#ifdef _OPENMP
+	omp_set_num_threads(oldThreads);
+#endif
+	
+	if (error != CORRECT) {
+		return ALLOCATION_ERROR;
 	}
 	
 	//This could be better
@@ -697,9 +844,26 @@ int free_model(wusvm_model model){
 
 int classify_data(wusvm_data test_data, wusvm_model model, wusvm_options svm_options){
 	opt* options_ptr = reinterpret_cast<opt*>(svm_options);
+	
+	if (!options_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	svm_context context(0, options_ptr->memBudget);
+	return classify_data_in_context(reinterpret_cast<wusvm_context>(&context), test_data, model, svm_options);
+}
+
+
+int classify_data_in_context(wusvm_context context, wusvm_data test_data, wusvm_model model, wusvm_options svm_options){
+	svm_context* context_ptr = reinterpret_cast<svm_context*>(context);
+	opt* options_ptr = reinterpret_cast<opt*>(svm_options);
 	svm_sparse_data* data_ptr = reinterpret_cast<svm_sparse_data*>(test_data);
 	svm_model* model_ptr = reinterpret_cast<svm_model*>(model);
 	
+	if (!context_ptr) {
+		return TYPE_ERROR;
+	}
+	
 	if (!model_ptr) {
 		return TYPE_ERROR;
 	}
@@ -712,17 +876,14 @@ int classify_data(wusvm_data test_data, wusvm_model model, wusvm_options svm_opt
 		return TYPE_ERROR;
 	}
 	
-	opt& options = *options_ptr;
+	opt const& options = *options_ptr;
 	svm_sparse_data& sparseData = *data_ptr;
-	svm_model& myModel = *model_ptr;
-	
-	myModel.options = options;
 	
 	int correct;
-	if (options.dag) {
-		dagclassify_host(myModel, sparseData, correct, 0);
-	} else {
-		classify_host(myModel, sparseData, correct, 0);
+	try {
+		classify_points(context_ptr->predictor(*model_ptr, options.dag), options.dag, sparseData, correct);
+	} catch (std::bad_alloc) {
+		return ALLOCATION_ERROR;
 	}
 	
 	if(options.verb > 2){
@@ -733,3 +894,96 @@ int classify_data(wusvm_data test_data, wusvm_model model, wusvm_options svm_opt
 	
 	return NO_ERROR;
 }
+
+
+int create_context(wusvm_context* context, int threads, int mem_budget){
+	if (!context || threads < 0 || mem_budget < 0) {
+		return ARGUMENT_ERROR;
+	}
+	
+	try {
+		*context = reinterpret_cast<wusvm_context>(new svm_context(threads, (size_t)mem_budget << 20));
+	} catch (std::bad_alloc) {
+		return ALLOCATION_ERROR;
+	}
+	
+	return NO_ERROR;
+}
+
+
+int free_context(wusvm_context context){
+	svm_context* context_ptr = reinterpret_cast<svm_context*>(context);
+	
+	if (!context_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	delete context_ptr;
+	return NO_ERROR;
+}
+
+
+int create_predictor(wusvm_predictor* predictor, wusvm_model model, int threads){
+	svm_model* model_ptr = reinterpret_cast<svm_model*>(model);
+	
+	if (!model_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	if (!predictor) {
+		return ARGUMENT_ERROR;
+	}
+	
+	try {
+		*predictor = reinterpret_cast<wusvm_predictor>(new svm_predictor(*model_ptr, threads));
+	} catch (std::bad_alloc) {
+		return ALLOCATION_ERROR;
+	}
+	
+	return NO_ERROR;
+}
+
+
+int predict_one(wusvm_predictor predictor, const double* x, int features, int* label){
+	svm_predictor* predictor_ptr = reinterpret_cast<svm_predictor*>(predictor);
+	
+	if (!predictor_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	return predictor_ptr->predict(x, features, 1, label) == CORRECT ? NO_ERROR : ARGUMENT_ERROR;
+}
+
+
+int predict_one_sparse(wusvm_predictor predictor, const int* indices, const double* values, int nnz, int* label){
+	svm_predictor* predictor_ptr = reinterpret_cast<svm_predictor*>(predictor);
+	
+	if (!predictor_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	return predictor_ptr->predict_sparse(indices, values, nnz, label) == CORRECT ? NO_ERROR : ARGUMENT_ERROR;
+}
+
+
+int predict_batch(wusvm_predictor predictor, const double* x, int features, int points, int* labels){
+	svm_predictor* predictor_ptr = reinterpret_cast<svm_predictor*>(predictor);
+	
+	if (!predictor_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	return predictor_ptr->predict(x, features, points, labels) == CORRECT ? NO_ERROR : ARGUMENT_ERROR;
+}
+
+
+int free_predictor(wusvm_predictor predictor){
+	svm_predictor* predictor_ptr = reinterpret_cast<svm_predictor*>(predictor);
+	
+	if (!predictor_ptr) {
+		return TYPE_ERROR;
+	}
+	
+	delete predictor_ptr;
+	return NO_ERROR;
+}
@@ -28,6 +28,8 @@
 #ifndef LASP_WUSVM_H
 #define LASP_WUSVM_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -65,6 +67,15 @@ extern "C" {
 			 free_model(model);
 			 free_options(options);
 			 ...
+	 
+		Threads:
+	 
+			Models are not changed after fit_model or load_model, so any number of threads may
+			classify against one model at the same time. Labels are written into the test data
+			object, so each thread needs its own. Options objects are only read. Calls made
+			through a wusvm_context (see create_context) use its thread count, memory budget
+			and scratch memory; with one context per thread, classification throughput grows
+			with the number of threads. benchmark_predict measures this.
 	*/
 	
 	
@@ -73,6 +84,8 @@ extern "C" {
 	typedef void* wusvm_model;
 	typedef void* wusvm_data;
 	typedef void* wusvm_options;
+	typedef void* wusvm_predictor;
+	typedef void* wusvm_context;
 	
 	//Type of kernel function to use in training and testing
 	enum wusvm_kernel { RBF, LINEAR, POLYNOMIAL, SIGMOID };
@@ -131,6 +144,66 @@ extern "C" {
 	 */
 	int create_test_data_from_array(wusvm_data* svm_data, double* x, int features, int points);
 	
+	/*
+		 create_data_view
+		 
+		 Arguments:
+			 svm_data (output): Pointer to an unallocated wusvm_data object. After this function
+			 is executed, svm_data will point to a wusvm_data object.
+			 
+			 x (input): Pointer to tightly packed data array, laid out as in create_data_from_array.
+			 x is NOT copied (see description).
+			 
+			 y (input): Pointer to label array, also not copied. May be NULL for data that will
+			 only be classified.
+			 
+			 features (input): Number of feaures in each 'x' example.
+			 
+			 points (input): Number of examples in x (and y).
+		 
+		 Returns:
+			 Error code
+		 
+		 Description:
+			 Creates a data object that reads the caller's arrays in place instead of copying them.
+			 x and y must stay allocated and unchanged until the data object is freed with free_data.
+			 fit_model trains on x directly when a classifier uses every example in order (two
+			 classes, without shuffling), and otherwise copies just the examples of each classifier,
+			 once. Parameter optimization and platt scaling still work on a full copy. classify_data
+			 reads x in place, and the labels come back in the order of x.
+	 */
+	int create_data_view(wusvm_data* svm_data, const double* x, const double* y, int features, int points);
+	
+	/*
+		 create_sparse_data_view
+		 
+		 Arguments:
+			 svm_data (output): Pointer to an unallocated wusvm_data object. After this function
+			 is executed, svm_data will point to a wusvm_data object.
+			 
+			 indptr (input): points + 1 offsets into indices and values, starting at 0. The
+			 nonzero features of example i are entries indptr[i] to indptr[i+1]-1.
+			 
+			 indices (input): Zero based feature index of each entry, less than features.
+			 
+			 values (input): Value of each entry.
+			 
+			 y (input): Pointer to label array, may be NULL as in create_data_view.
+			 
+			 features (input): Number of feaures in each example.
+			 
+			 points (input): Number of examples.
+		 
+		 Returns:
+			 Error code
+		 
+		 Description:
+			 Same as create_data_view for examples in compressed sparse row format (as in
+			 scipy.sparse.csr_matrix). None of the arrays are copied, and all of them must outlive
+			 the data object. Sparse enough examples are also trained on sparse.
+	 */
+	int create_sparse_data_view(wusvm_data* svm_data, const size_t* indptr, const int* indices, const double* values, const double* y, int features, int points);
+	
 	/*
 		 create_data_from_file
 		 
@@ -378,6 +451,177 @@ extern "C" {
 	 */
 	int classify_data(wusvm_data test_data, wusvm_model model, wusvm_options svm_options);
 	
+	/*
+		 create_context
+		 
+		 Arguments:
+			 context (output): Pointer to an unallocated wusvm_context object. After this function
+			 is executed, context will point to a wusvm_context object.
+	 
+			 threads (input): The number of threads each call through the context may use, 0 for
+			 one per OpenMP thread.
+	 
+			 mem_budget (input): Megabytes of memory a call may use, as the --mem-budget option,
+			 0 for no budget. Classification keeps its scratch memory within the budget.
+		 
+		 Returns:
+			 Error code
+		 
+		 Description:
+			 Creates an execution context for fit_model_in_context and classify_data_in_context.
+			 The context keeps the scratch memory of each model it has classified with, so later
+			 calls on the same model allocate nothing. That memory is held, along with the model's
+			 support vectors, until the context is freed. One context may be used from several
+			 threads, but their calls share its scratch memory and wait for each other when it is
+			 all in use.
+	 */
+	int create_context(wusvm_context* context, int threads, int mem_budget);
+	
+	/*
+		 fit_model_in_context
+		 
+		 Arguments:
+			 context (input): A previously created wusvm_context.
+	 
+			 model, svm_data, svm_options: As in fit_model.
+		 
+		 Returns:
+			 Error code
+		 
+		 Description:
+			 fit_model with the thread count and memory budget of the context. The budget also
+			 sizes caches shared by the whole process, so concurrent fits share the latest budget.
+	 */
+	int fit_model_in_context(wusvm_context context, wusvm_model* model, wusvm_data svm_data, wusvm_options svm_options);
+	
+	/*
+		 classify_data_in_context
+		 
+		 Arguments:
+			 context (input): A previously created wusvm_context.
+	 
+			 test_data, model, svm_options: As in classify_data.
+		 
+		 Returns:
+			 Error code
+		 
+		 Description:
+			 classify_data with the thread count, memory budget and scratch memory of the context.
+	 */
+	int classify_data_in_context(wusvm_context context, wusvm_data test_data, wusvm_model model, wusvm_options svm_options);
+	
+	/*
+		 free_context
+		 
+		 Arguments:
+			context (input): Previously created wusvm_context object.
+		 
+		 Returns:
+			Error code
+		 
+		 Description:
+			Safely de-allocates a previously created wusvm_context object and its scratch memory.
+	 */
+	int free_context(wusvm_context context);
+	
+	/*
+		 create_predictor
+		 
+		 Arguments:
+			 predictor (output): Pointer to an unallocated wusvm_predictor object. After this function
+			 is executed, predictor will point to a wusvm_predictor object.
+	 
+			 model (input): A previously fit or loaded wusvm_model. The predictor shares the model's
+			 support vectors, so the model may be freed afterwards.
+	 
+			 threads (input): The number of calls that may run on the predictor at once without
+			 waiting for each other, 0 for one per OpenMP thread.
+		 
+		 Returns:
+			 Error code
+		 
+		 Description:
+			 Creates a predictor for online scoring. All memory that predict_one, predict_one_sparse
+			 and predict_batch need is allocated here, the calls themselves do not allocate. Calls
+			 may be made from several threads at once. Points are classified by one-vs-one voting,
+			 the same as classify_data without the DAG option.
+	 */
+	int create_predictor(wusvm_predictor* predictor, wusvm_model model, int threads);
+	
+	/*
+		 predict_one
+		 
+		 Arguments:
+			 predictor (input): A previously created wusvm_predictor.
+	 
+			 x (input): The features of one example.
+	 
+			 features (input): Number of features in x. Features the model was not trained on
+			 are ignored.
+	 
+			 label (output): The predicted label.
+		 
+		 Returns:
+			 Error code
+	 */
+	int predict_one(wusvm_predictor predictor, const double* x, int features, int* label);
+	
+	/*
+		 predict_one_sparse
+		 
+		 Arguments:
+			 predictor (input): A previously created wusvm_predictor.
+	 
+			 indices (input): Zero based indices of the nonzero features of one example.
+	 
+			 values (input): The values of those features.
+	 
+			 nnz (input): Number of entries in indices and values.
+	 
+			 label (output): The predicted label.
+		 
+		 Returns:
+			 Error code
+	 */
+	int predict_one_sparse(wusvm_predictor predictor, const int* indices, const double* values, int nnz, int* label);
+	
+	/*
+		 predict_batch
+		 
+		 Arguments:
+			 predictor (input): A previously created wusvm_predictor.
+	 
+			 x (input): Tightly packed examples, features by points in column major order as in
+			 create_test_data_from_array.
+	 
+			 features (input): Number of features in each example.
+	 
+			 points (input): Number of examples in x.
+	 
+			 labels (output): An (allocated!) array of at least points labels.
+		 
+		 Returns:
+			 Error code
+		 
+		 Description:
+			 Classifies the examples in blocks, spread over the predictor's threads.
+	 */
+	int predict_batch(wusvm_predictor predictor, const double* x, int features, int points, int* labels);
+	
+	/*
+		 free_predictor
+		 
+		 Arguments:
+			predictor (input): Previously created wusvm_predictor object.
+		 
+		 Returns:
+			Error code
+		 
+		 Description:
+			Safely de-allocates a previously created wusvm_predictor object.
+	 */
+	int free_predictor(wusvm_predictor predictor);
+	
 #ifdef __cplusplus
 }
 #endif